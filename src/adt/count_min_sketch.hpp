@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+namespace wa {
+
+/// Count-Min sketch over 64-bit hashes. estimate() never under-estimates, and over-estimates by at most
+/// epsilon * (total count) with probability 1 - delta. sketches with the same shape can be merged.
+class CountMinSketch {
+  size_t m_width = 0U;
+  size_t m_depth = 0U;
+  std::vector<uint64_t> m_counters{}; // m_depth rows of m_width counters
+
+public:
+  CountMinSketch() = default;
+  CountMinSketch(double epsilon, double delta) {
+    if (!(epsilon > 0.0 && epsilon < 1.0) || !(delta > 0.0 && delta < 1.0)) {
+      throw std::invalid_argument("count-min sketch: epsilon and delta must be in (0, 1)");
+    }
+    m_width = static_cast<size_t>(std::ceil(std::numbers::e / epsilon));
+    m_depth = static_cast<size_t>(std::ceil(std::log(1.0 / delta)));
+    m_counters.assign(m_width * m_depth, 0U);
+  }
+
+  size_t get_width() const { return m_width; }
+  size_t get_depth() const { return m_depth; }
+
+  /// returns the estimate after adding
+  uint64_t add(uint64_t hash, uint64_t count) {
+    uint64_t result = UINT64_MAX;
+    for (size_t row = 0; row < m_depth; row++) {
+      uint64_t &counter = m_counters[row * m_width + get_column(hash, row)];
+      counter += count;
+      result = std::min(result, counter);
+    }
+    return m_depth == 0U ? 0U : result;
+  }
+  uint64_t estimate(uint64_t hash) const {
+    uint64_t result = UINT64_MAX;
+    for (size_t row = 0; row < m_depth; row++) {
+      result = std::min(result, m_counters[row * m_width + get_column(hash, row)]);
+    }
+    return m_depth == 0U ? 0U : result;
+  }
+
+  void merge(CountMinSketch const &o) {
+    if (m_width != o.m_width || m_depth != o.m_depth) {
+      throw std::invalid_argument("count-min sketch: merge of different shapes");
+    }
+    for (size_t i = 0; i < m_counters.size(); i++) {
+      m_counters[i] += o.m_counters[i];
+    }
+  }
+
+private:
+  size_t get_column(uint64_t hash, size_t row) const {
+    // independent row hashes from splitmix64 of a per-row seed, reduced by multiply-shift instead of modulo
+    uint64_t x = hash + (row + 1U) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31U;
+    return static_cast<size_t>((static_cast<unsigned __int128>(x) * m_width) >> 64U);
+  }
+};
+
+} // namespace wa
@@ -1,101 +1,206 @@
 #pragma once
 
-#include "string.hpp"
-#include <bitset>
+#include "../concept.hpp"
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
-#include <string_view>
 #include <vector>
 
 namespace wa {
 
 class DynBitSet {
+  using Word = uint64_t;
+  static constexpr size_t word_bit_size = sizeof(Word) * 8U;
+  // sets up to 128 bits (most function CFGs and local sets) never touch the heap.
+  static constexpr size_t inline_word_size = 2U;
+
   size_t m_bit_size = 0U;
-  std::vector<std::bitset<64U>> m_raw{};
+  size_t m_word_size = 0U;
+  Word m_inline[inline_word_size]{};
+  std::vector<Word> m_heap{};
 
-  static constexpr size_t block_bit_size = sizeof(decltype(m_raw)::value_type) * 8U;
+  static size_t get_word_size(size_t bit_size) { return (bit_size + word_bit_size - 1U) / word_bit_size; }
+  static size_t get_word_index(size_t index) { return index / word_bit_size; }
+  static Word get_bit_mask(size_t index) { return Word{1U} << (index % word_bit_size); }
 
-  struct InnerIndex {
-    size_t m_raw_index;
-    size_t m_bit_index;
-  };
+  bool is_inline() const { return m_word_size <= inline_word_size; }
+  Word *words() { return is_inline() ? m_inline : m_heap.data(); }
+  Word const *words() const { return is_inline() ? m_inline : m_heap.data(); }
 
-  static InnerIndex convert_index(size_t index) {
-    size_t raw_index = index / block_bit_size;
-    size_t left = index - raw_index * block_bit_size;
-    return {.m_raw_index = raw_index, .m_bit_index = left};
+  // unused bits in the last word must stay zero, otherwise count / equality / iteration see garbage.
+  void clear_tail() {
+    size_t const tail = m_bit_size % word_bit_size;
+    if (tail != 0U) {
+      words()[m_word_size - 1U] &= (Word{1U} << tail) - 1U;
+    }
+  }
+
+  // kernels are written as plain loops over restrict pointers so the compiler can vectorize them.
+  static void or_kernel(Word *__restrict dst, Word const *__restrict src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      dst[i] |= src[i];
+  }
+  static void and_kernel(Word *__restrict dst, Word const *__restrict src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      dst[i] &= src[i];
+  }
+  static void and_not_kernel(Word *__restrict dst, Word const *__restrict src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      dst[i] &= ~src[i];
+  }
+  static bool equal_kernel(Word const *__restrict a, Word const *__restrict b, size_t n) {
+    Word diff = 0U;
+    for (size_t i = 0; i < n; i++)
+      diff |= a[i] ^ b[i];
+    return diff == 0U;
+  }
+  static bool and_changed_kernel(Word *__restrict dst, Word const *__restrict src, size_t n) {
+    Word diff = 0U;
+    for (size_t i = 0; i < n; i++) {
+      Word const next = dst[i] & src[i];
+      diff |= next ^ dst[i];
+      dst[i] = next;
+    }
+    return diff != 0U;
+  }
+  static bool or_changed_kernel(Word *__restrict dst, Word const *__restrict src, size_t n) {
+    Word diff = 0U;
+    for (size_t i = 0; i < n; i++) {
+      Word const next = dst[i] | src[i];
+      diff |= next ^ dst[i];
+      dst[i] = next;
+    }
+    return diff != 0U;
   }
 
 public:
   DynBitSet() = default;
-  explicit DynBitSet(size_t bit_size) : m_bit_size(bit_size), m_raw((bit_size + block_bit_size - 1) / block_bit_size) {}
+  explicit DynBitSet(size_t bit_size) : m_bit_size(bit_size), m_word_size(get_word_size(bit_size)) {
+    if (!is_inline()) {
+      m_heap.resize(m_word_size, 0U);
+    }
+  }
+  explicit DynBitSet(size_t bit_size, bool value) : DynBitSet(bit_size) {
+    if (value) {
+      set_all();
+    }
+  }
+
+  size_t size() const { return m_bit_size; }
 
   void mask(size_t index) {
-    assert(index <= m_bit_size);
-    InnerIndex inner_index = convert_index(index);
-    m_raw[inner_index.m_raw_index].set(inner_index.m_bit_index, true);
+    assert(index < m_bit_size);
+    words()[get_word_index(index)] |= get_bit_mask(index);
   }
   void unmask(size_t index) {
-    assert(index <= m_bit_size);
-    InnerIndex inner_index = convert_index(index);
-    m_raw[inner_index.m_raw_index].set(inner_index.m_bit_index, false);
+    assert(index < m_bit_size);
+    words()[get_word_index(index)] &= ~get_bit_mask(index);
   }
   void set(size_t index, bool value) {
-    assert(index <= m_bit_size);
-    InnerIndex inner_index = convert_index(index);
-    m_raw[inner_index.m_raw_index].set(inner_index.m_bit_index, value);
+    if (value) {
+      mask(index);
+    } else {
+      unmask(index);
+    }
+  }
+  bool test(size_t index) const {
+    assert(index < m_bit_size);
+    return (words()[get_word_index(index)] & get_bit_mask(index)) != 0U;
+  }
+
+  void set_all() {
+    std::fill_n(words(), m_word_size, ~Word{0U});
+    clear_tail();
+  }
+  void reset_all() { std::fill_n(words(), m_word_size, Word{0U}); }
+
+  size_t count() const {
+    Word const *w = words();
+    size_t cnt = 0U;
+    for (size_t i = 0; i < m_word_size; i++)
+      cnt += static_cast<size_t>(std::popcount(w[i]));
+    return cnt;
+  }
+  bool none() const {
+    Word const *w = words();
+    Word acc = 0U;
+    for (size_t i = 0; i < m_word_size; i++)
+      acc |= w[i];
+    return acc == 0U;
+  }
+  bool any() const { return !none(); }
+
+  template <Callable<void, size_t> Fn> void for_each_set_bit(Fn const &fn) const {
+    Word const *w = words();
+    for (size_t i = 0; i < m_word_size; i++) {
+      Word word = w[i];
+      while (word != 0U) {
+        fn(i * word_bit_size + static_cast<size_t>(std::countr_zero(word)));
+        word &= word - 1U;
+      }
+    }
   }
 
   DynBitSet operator~() const {
-    DynBitSet new_bit_set{m_bit_size};
-    for (size_t i = 0; i < m_raw.size(); i++)
-      new_bit_set.m_raw[i] = ~m_raw[i];
+    DynBitSet new_bit_set{*this};
+    Word *w = new_bit_set.words();
+    for (size_t i = 0; i < m_word_size; i++)
+      w[i] = ~w[i];
+    new_bit_set.clear_tail();
     return new_bit_set;
   }
   DynBitSet operator|(DynBitSet const &o) const {
-    assert(m_bit_size == o.m_bit_size);
-    DynBitSet new_bit_set{m_bit_size};
-    for (size_t i = 0; i < m_raw.size(); i++)
-      new_bit_set.m_raw[i] = m_raw[i] | o.m_raw[i];
+    DynBitSet new_bit_set{*this};
+    new_bit_set |= o;
     return new_bit_set;
   }
   DynBitSet operator&(DynBitSet const &o) const {
-    assert(m_bit_size == o.m_bit_size);
-    DynBitSet new_bit_set{m_bit_size};
-    for (size_t i = 0; i < m_raw.size(); i++)
-      new_bit_set.m_raw[i] = m_raw[i] & o.m_raw[i];
+    DynBitSet new_bit_set{*this};
+    new_bit_set &= o;
     return new_bit_set;
   }
 
   DynBitSet &operator|=(DynBitSet const &o) {
     assert(m_bit_size == o.m_bit_size);
-    for (size_t i = 0; i < m_raw.size(); i++)
-      m_raw[i] |= o.m_raw[i];
+    or_kernel(words(), o.words(), m_word_size);
     return *this;
   }
   DynBitSet &operator&=(DynBitSet const &o) {
     assert(m_bit_size == o.m_bit_size);
-    for (size_t i = 0; i < m_raw.size(); i++)
-      m_raw[i] &= o.m_raw[i];
+    and_kernel(words(), o.words(), m_word_size);
     return *this;
   }
+  /// this = this & ~o
+  DynBitSet &and_not(DynBitSet const &o) {
+    assert(m_bit_size == o.m_bit_size);
+    and_not_kernel(words(), o.words(), m_word_size);
+    return *this;
+  }
+  /// this = this & o, returns whether any bit was cleared
+  bool and_assign_changed(DynBitSet const &o) {
+    assert(m_bit_size == o.m_bit_size);
+    return and_changed_kernel(words(), o.words(), m_word_size);
+  }
+  /// this = this | o, returns whether any bit was set
+  bool or_assign_changed(DynBitSet const &o) {
+    assert(m_bit_size == o.m_bit_size);
+    return or_changed_kernel(words(), o.words(), m_word_size);
+  }
 
   bool operator==(DynBitSet const &o) const {
     assert(m_bit_size == o.m_bit_size);
-    for (size_t i = 0; i < m_raw.size(); i++) {
-      if (m_raw[i] != o.m_raw[i]) {
-        return false;
-      }
-    }
-    return true;
+    return equal_kernel(words(), o.words(), m_word_size);
   }
   bool operator!=(DynBitSet const &o) const { return !operator==(o); }
 
   friend std::ostream &operator<<(std::ostream &os, DynBitSet const &bit_set) {
-    std::string str = StringOperator::join(bit_set.m_raw, "");
-    size_t drop_bit = bit_set.m_raw.size() * block_bit_size - bit_set.m_bit_size;
-    return os << std::string_view{&str[drop_bit], str.size() - drop_bit};
+    for (size_t i = bit_set.m_bit_size; i > 0; i--) {
+      os << (bit_set.test(i - 1U) ? '1' : '0');
+    }
+    return os;
   }
 };
 
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "../concept.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace wa {
+
+/// trie whose nodes live in one contiguous vector and refer to each other by 32-bit index.
+/// children are kept outside the nodes, so a leaf is only its value, parent and key. a small sorted list of children
+/// lives in a shared arena and doubles on demand, nodes with a high fan-out are promoted to an open addressing hash
+/// table. looking up or inserting a child is a single probe.
+template <class K, class V, class Hash = std::hash<K>> class FlatTrie {
+public:
+  using NodeIndex = uint32_t;
+  static constexpr NodeIndex root = 0U;
+  static constexpr NodeIndex invalid_node = std::numeric_limits<NodeIndex>::max();
+
+private:
+  static constexpr uint32_t max_list_capacity = 8U; // power of 2
+  static constexpr uint32_t min_table_capacity = 16U;
+
+  struct Child {
+    K m_key{};
+    NodeIndex m_node = invalid_node; // invalid_node marks an empty slot in a table
+  };
+  struct Table {
+    std::vector<Child> m_slots{}; // capacity is a power of 2, load factor is kept below 1/2
+    uint32_t m_size = 0U;
+  };
+  struct Node {
+    std::optional<V> m_value = std::nullopt;
+    NodeIndex m_parent = invalid_node;
+    K m_key{}; // key of the edge from m_parent
+    uint32_t m_child_num = 0U;
+    // up to max_list_capacity children: start of the sorted list in m_lists, its capacity is bit_ceil(m_child_num).
+    // above: index in m_tables.
+    uint32_t m_children = 0U;
+
+    bool has_table() const { return m_child_num > max_list_capacity; }
+  };
+
+  std::vector<Node> m_nodes{};
+  std::vector<Child> m_lists{};
+  std::array<std::vector<uint32_t>, std::countr_zero(max_list_capacity) + 1U> m_free_lists{}; // by log2 capacity
+  std::vector<Table> m_tables{};
+
+public:
+  FlatTrie() { m_nodes.emplace_back(); }
+
+  size_t size() const { return m_nodes.size(); }
+
+  std::optional<V> &value(NodeIndex node) { return m_nodes[node].m_value; }
+  std::optional<V> const &value(NodeIndex node) const { return m_nodes[node].m_value; }
+  NodeIndex get_parent(NodeIndex node) const { return m_nodes[node].m_parent; }
+  K const &get_key(NodeIndex node) const { return m_nodes[node].m_key; }
+  /// keys from the root to `node`
+  std::vector<K> get_path(NodeIndex node) const {
+    std::vector<K> path{};
+    for (; node != root; node = m_nodes[node].m_parent) {
+      path.push_back(m_nodes[node].m_key);
+    }
+    std::ranges::reverse(path);
+    return path;
+  }
+
+  NodeIndex find_child(NodeIndex parent, K const &key) const {
+    Node const &node = m_nodes[parent];
+    if (node.has_table()) {
+      Table const &table = m_tables[node.m_children];
+      size_t const mask = table.m_slots.size() - 1U;
+      for (size_t slot = get_slot(key, table.m_slots.size());; slot = (slot + 1U) & mask) {
+        Child const &child = table.m_slots[slot];
+        if (child.m_node == invalid_node || child.m_key == key) {
+          return child.m_node;
+        }
+      }
+    }
+    for (Child const &child : get_list(node)) {
+      if (child.m_key == key) {
+        return child.m_node;
+      }
+    }
+    return invalid_node;
+  }
+
+  NodeIndex get_or_insert_child(NodeIndex parent, K const &key) {
+    Node const &node = m_nodes[parent];
+    if (node.has_table()) {
+      return get_or_insert_table_child(parent, key);
+    }
+    std::span<Child const> const list = get_list(node);
+    uint32_t position = 0U;
+    for (; position < list.size(); position++) {
+      if (list[position].m_key == key) {
+        return list[position].m_node;
+      }
+      if (key < list[position].m_key) {
+        break;
+      }
+    }
+    if (node.m_child_num == max_list_capacity) {
+      promote(parent);
+      return get_or_insert_table_child(parent, key);
+    }
+    if (node.m_child_num == 0U || std::has_single_bit(node.m_child_num)) {
+      grow_list(parent);
+    }
+    NodeIndex const child = add_node(parent, key);
+    // add_node may reallocate m_nodes
+    Node &current = m_nodes[parent];
+    auto const begin = m_lists.begin() + current.m_children;
+    std::move_backward(begin + position, begin + current.m_child_num, begin + current.m_child_num + 1U);
+    begin[position] = Child{.m_key = key, .m_node = child};
+    current.m_child_num++;
+    return child;
+  }
+
+  /// children of `parent` without allocating: in ascending key order for small nodes, in hash table order otherwise
+  template <Callable<void, K const &, NodeIndex> Fn> void for_each_child(NodeIndex parent, Fn const &fn) const {
+    Node const &node = m_nodes[parent];
+    std::span<Child const> const children =
+        node.has_table() ? std::span<Child const>{m_tables[node.m_children].m_slots} : get_list(node);
+    for (Child const &child : children) {
+      if (child.m_node != invalid_node) {
+        fn(child.m_key, child.m_node);
+      }
+    }
+  }
+
+  /// children of `parent` in ascending key order. hash table children are sorted at the end of `buffer`, which is
+  /// restored before returning, so one buffer serves a whole (even recursive) traversal.
+  template <Callable<void, K const &, NodeIndex> Fn>
+  void for_each_sorted_child(NodeIndex parent, std::vector<NodeIndex> &buffer, Fn const &fn) const {
+    Node const &node = m_nodes[parent];
+    if (!node.has_table()) {
+      for (Child const &child : get_list(node)) {
+        fn(child.m_key, child.m_node);
+      }
+      return;
+    }
+    size_t const begin = buffer.size();
+    for (Child const &child : m_tables[node.m_children].m_slots) {
+      if (child.m_node != invalid_node) {
+        buffer.push_back(child.m_node);
+      }
+    }
+    std::sort(buffer.begin() + static_cast<std::ptrdiff_t>(begin), buffer.end(),
+              [this](NodeIndex l, NodeIndex r) { return m_nodes[l].m_key < m_nodes[r].m_key; });
+    size_t const end = buffer.size();
+    for (size_t i = begin; i < end; i++) {
+      NodeIndex const child = buffer[i];
+      fn(m_nodes[child].m_key, child);
+    }
+    buffer.resize(begin);
+  }
+
+  void insert_or_assign(std::span<K> k, V v) { value(force_at(k)) = std::move(v); }
+
+  template <Callable<void, std::optional<V> &> Fn> void update(std::span<K> k, Fn const &func) {
+    func(value(force_at(k)));
+  }
+  bool contains(std::span<K> k) const { return find(k) != invalid_node; }
+  std::optional<V> &at(std::span<K> k) {
+    NodeIndex const node = find(k);
+    if (node == invalid_node) {
+      throw std::out_of_range("trie");
+    }
+    return value(node);
+  }
+  std::optional<V> const &at(std::span<K> k) const { return const_cast<FlatTrie *>(this)->at(k); }
+
+  /// add every node of `other` into this trie, `combine(to, from)` merges values of nodes existing in both
+  template <Callable<void, std::optional<V> &, V const &> Fn> void merge(FlatTrie const &other, Fn const &combine) {
+    struct Pair {
+      NodeIndex m_from;
+      NodeIndex m_to;
+    };
+    std::vector<Pair> work_list{Pair{.m_from = root, .m_to = root}};
+    while (!work_list.empty()) {
+      Pair const current = work_list.back();
+      work_list.pop_back();
+      if (other.m_nodes[current.m_from].m_value.has_value()) {
+        combine(value(current.m_to), other.m_nodes[current.m_from].m_value.value());
+      }
+      other.for_each_child(current.m_from, [&](K const &key, NodeIndex child) {
+        work_list.push_back(Pair{.m_from = child, .m_to = get_or_insert_child(current.m_to, key)});
+      });
+    }
+  }
+
+  /// visit every node with a value depth first, children in ascending key order
+  template <Callable<void, std::vector<K>, V const &> Fn> void for_each(Fn const &fn) const {
+    std::vector<K> path{};
+    std::vector<NodeIndex> buffer{};
+    for_each_impl(fn, path, buffer, root);
+  }
+
+private:
+  NodeIndex add_node(NodeIndex parent, K const &key) {
+    if (m_nodes.size() >= invalid_node) {
+      throw std::length_error("trie");
+    }
+    m_nodes.push_back(Node{.m_parent = parent, .m_key = key});
+    return static_cast<NodeIndex>(m_nodes.size() - 1U);
+  }
+
+  std::span<Child const> get_list(Node const &node) const {
+    return {m_lists.data() + node.m_children, node.m_child_num};
+  }
+
+  /// move the full list of `parent` into one of twice the capacity
+  void grow_list(NodeIndex parent) {
+    Node &node = m_nodes[parent];
+    uint32_t const capacity = node.m_child_num == 0U ? 1U : node.m_child_num * 2U;
+    std::vector<uint32_t> &free_list = m_free_lists[std::countr_zero(capacity)];
+    uint32_t start = 0U;
+    if (free_list.empty()) {
+      if (m_lists.size() + capacity > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("trie");
+      }
+      start = static_cast<uint32_t>(m_lists.size());
+      m_lists.resize(m_lists.size() + capacity);
+    } else {
+      start = free_list.back();
+      free_list.pop_back();
+    }
+    if (node.m_child_num != 0U) {
+      std::copy_n(m_lists.begin() + node.m_children, node.m_child_num, m_lists.begin() + start);
+      m_free_lists[std::countr_zero(node.m_child_num)].push_back(node.m_children);
+    }
+    node.m_children = start;
+  }
+
+  static size_t get_slot(K const &key, size_t capacity) {
+    // fibonacci hashing, std::hash of integers and enums is usually the identity
+    uint64_t const hash = static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash >> (64U - std::countr_zero(capacity)));
+  }
+
+  static void insert_slot(Table &table, Child const &child) {
+    size_t const mask = table.m_slots.size() - 1U;
+    size_t slot = get_slot(child.m_key, table.m_slots.size());
+    while (table.m_slots[slot].m_node != invalid_node) {
+      slot = (slot + 1U) & mask;
+    }
+    table.m_slots[slot] = child;
+    table.m_size++;
+  }
+
+  void promote(NodeIndex parent) {
+    Node &node = m_nodes[parent];
+    Table table{.m_slots = std::vector<Child>(min_table_capacity)};
+    for (Child const &child : get_list(node)) {
+      insert_slot(table, child);
+    }
+    m_free_lists.back().push_back(node.m_children);
+    node.m_children = static_cast<uint32_t>(m_tables.size());
+    m_tables.push_back(std::move(table));
+  }
+
+  void grow(Table &table) {
+    Table grown{.m_slots = std::vector<Child>(table.m_slots.size() * 2U)};
+    for (Child const &child : table.m_slots) {
+      if (child.m_node != invalid_node) {
+        insert_slot(grown, child);
+      }
+    }
+    table = std::move(grown);
+  }
+
+  NodeIndex get_or_insert_table_child(NodeIndex parent, K const &key) {
+    Table &table = m_tables[m_nodes[parent].m_children];
+    if ((table.m_size + 1U) * 2U > table.m_slots.size()) {
+      grow(table);
+    }
+    size_t const mask = table.m_slots.size() - 1U;
+    size_t slot = get_slot(key, table.m_slots.size());
+    for (;; slot = (slot + 1U) & mask) {
+      Child const &child = table.m_slots[slot];
+      if (child.m_node == invalid_node) {
+        break;
+      }
+      if (child.m_key == key) {
+        return child.m_node;
+      }
+    }
+    NodeIndex const child = add_node(parent, key);
+    table.m_slots[slot] = Child{.m_key = key, .m_node = child};
+    table.m_size++;
+    m_nodes[parent].m_child_num++;
+    return child;
+  }
+
+  NodeIndex find(std::span<K> k) const {
+    NodeIndex current = root;
+    for (K const &ke : k) {
+      current = find_child(current, ke);
+      if (current == invalid_node) {
+        return invalid_node;
+      }
+    }
+    return current;
+  }
+
+  NodeIndex force_at(std::span<K> k) {
+    NodeIndex current = root;
+    for (K const &ke : k) {
+      current = get_or_insert_child(current, ke);
+    }
+    return current;
+  }
+
+  template <Callable<void, std::vector<K>, V const &> Fn>
+  void for_each_impl(Fn const &fn, std::vector<K> &path, std::vector<NodeIndex> &buffer, NodeIndex current) const {
+    if (m_nodes[current].m_value.has_value()) {
+      fn(path, m_nodes[current].m_value.value());
+    }
+    for_each_sorted_child(current, buffer, [&](K const &key, NodeIndex child) {
+      path.push_back(key);
+      for_each_impl(fn, path, buffer, child);
+      path.pop_back();
+    });
+  }
+};
+
+} // namespace wa
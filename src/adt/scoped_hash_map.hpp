@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+/// hash map with nested scopes, pop_scope reverts every assignment done since the matching push_scope.
+template <class K, class V, class Hash = std::hash<K>> class ScopedHashMap {
+  struct UndoEntry {
+    K m_key;
+    std::optional<V> m_old_value;
+  };
+  std::unordered_map<K, V, Hash> m_map{};
+  std::vector<UndoEntry> m_undo_log{};
+  std::vector<size_t> m_scopes{};
+
+public:
+  void push_scope() { m_scopes.push_back(m_undo_log.size()); }
+  void pop_scope() {
+    assert(!m_scopes.empty());
+    size_t const begin = m_scopes.back();
+    m_scopes.pop_back();
+    while (m_undo_log.size() > begin) {
+      UndoEntry &entry = m_undo_log.back();
+      if (entry.m_old_value.has_value()) {
+        m_map.insert_or_assign(entry.m_key, std::move(entry.m_old_value.value()));
+      } else {
+        m_map.erase(entry.m_key);
+      }
+      m_undo_log.pop_back();
+    }
+  }
+
+  V const *find(K const &key) const {
+    auto it = m_map.find(key);
+    return it == m_map.end() ? nullptr : &it->second;
+  }
+  void insert_or_assign(K const &key, V value) {
+    auto [it, is_inserted] = m_map.try_emplace(key, value);
+    if (is_inserted) {
+      m_undo_log.push_back(UndoEntry{.m_key = key, .m_old_value = std::nullopt});
+    } else {
+      m_undo_log.push_back(UndoEntry{.m_key = key, .m_old_value = std::move(it->second)});
+      it->second = std::move(value);
+    }
+  }
+  /// insert into the outermost scope, the entry survives every pop_scope. `key` must not exist.
+  void insert_outermost(K const &key, V value) {
+    [[maybe_unused]] auto [_, is_inserted] = m_map.try_emplace(key, std::move(value));
+    assert(is_inserted);
+  }
+
+  void clear() {
+    m_map.clear();
+    m_undo_log.clear();
+    m_scopes.clear();
+  }
+};
+
+} // namespace wa
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../concept.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+/// Space-Saving heavy hitters with a fixed number of counters.
+/// every key occurring more than (total count) / capacity times is tracked, and for a tracked key
+/// `m_count - m_error <= real count <= m_count`. `T` is user data attached to the tracked key.
+template <class K, class T, class Hash = std::hash<K>> class SpaceSaving {
+public:
+  struct Entry {
+    K m_key;
+    uint64_t m_count;
+    uint64_t m_error;
+    T m_data;
+  };
+
+private:
+  size_t m_capacity = 0U;
+  std::vector<Entry> m_entries{}; // binary min-heap on m_count
+  std::unordered_map<K, size_t, Hash> m_positions{};
+
+public:
+  SpaceSaving() = default;
+  explicit SpaceSaving(size_t capacity) : m_capacity(capacity) {
+    m_entries.reserve(capacity);
+    m_positions.reserve(capacity);
+  }
+
+  std::vector<Entry> const &get_entries() const { return m_entries; }
+  bool contains(K const &key) const { return m_positions.contains(key); }
+  /// upper bound of the true count of any key which is not tracked
+  uint64_t get_min_count() const { return m_entries.size() < m_capacity ? 0U : m_entries.front().m_count; }
+
+  /// `create_data()` is only called when `key` starts being tracked
+  template <Callable<T> Fn> void add(K const &key, uint64_t count, Fn const &create_data) {
+    if (m_capacity == 0U) {
+      return;
+    }
+    if (auto it = m_positions.find(key); it != m_positions.end()) {
+      m_entries[it->second].m_count += count;
+      sift_down(it->second);
+      return;
+    }
+    if (m_entries.size() < m_capacity) {
+      m_entries.push_back(Entry{.m_key = key, .m_count = count, .m_error = 0U, .m_data = create_data()});
+      m_positions.emplace(key, m_entries.size() - 1U);
+      sift_up(m_entries.size() - 1U);
+      return;
+    }
+    // replace the minimum, the new key may have occurred up to that many times before
+    Entry &min = m_entries.front();
+    m_positions.erase(min.m_key);
+    uint64_t const min_count = min.m_count;
+    min = Entry{.m_key = key, .m_count = min_count + count, .m_error = min_count, .m_data = create_data()};
+    m_positions.emplace(key, 0U);
+    sift_down(0U);
+  }
+
+  /// combine two summaries of disjoint streams, keeping the `capacity` largest counts
+  void merge(SpaceSaving const &o) {
+    uint64_t const min_count = get_min_count();
+    uint64_t const other_min_count = o.get_min_count();
+    std::vector<Entry> merged{};
+    merged.reserve(m_entries.size() + o.m_entries.size());
+    for (Entry &entry : m_entries) {
+      auto it = o.m_positions.find(entry.m_key);
+      Entry const *other = it == o.m_positions.end() ? nullptr : &o.m_entries[it->second];
+      entry.m_count += other != nullptr ? other->m_count : other_min_count;
+      entry.m_error += other != nullptr ? other->m_error : other_min_count;
+      merged.push_back(std::move(entry));
+    }
+    for (Entry const &entry : o.m_entries) {
+      if (!m_positions.contains(entry.m_key)) {
+        merged.push_back(Entry{.m_key = entry.m_key,
+                               .m_count = entry.m_count + min_count,
+                               .m_error = entry.m_error + min_count,
+                               .m_data = entry.m_data});
+      }
+    }
+    if (merged.size() > m_capacity) {
+      std::ranges::nth_element(merged, merged.begin() + static_cast<std::ptrdiff_t>(m_capacity),
+                               std::greater<>{}, &Entry::m_count);
+      merged.resize(m_capacity);
+    }
+    m_entries = std::move(merged);
+    std::ranges::make_heap(m_entries, std::greater<>{}, &Entry::m_count);
+    m_positions.clear();
+    for (size_t i = 0; i < m_entries.size(); i++) {
+      m_positions.emplace(m_entries[i].m_key, i);
+    }
+  }
+
+private:
+  void swap_entries(size_t a, size_t b) {
+    std::swap(m_entries[a], m_entries[b]);
+    m_positions[m_entries[a].m_key] = a;
+    m_positions[m_entries[b].m_key] = b;
+  }
+  void sift_up(size_t i) {
+    while (i > 0U) {
+      size_t const parent = (i - 1U) / 2U;
+      if (m_entries[parent].m_count <= m_entries[i].m_count) {
+        return;
+      }
+      swap_entries(parent, i);
+      i = parent;
+    }
+  }
+  void sift_down(size_t i) {
+    while (true) {
+      size_t smallest = i;
+      for (size_t child = 2U * i + 1U; child <= 2U * i + 2U && child < m_entries.size(); child++) {
+        if (m_entries[child].m_count < m_entries[smallest].m_count) {
+          smallest = child;
+        }
+      }
+      if (smallest == i) {
+        return;
+      }
+      swap_entries(smallest, i);
+      i = smallest;
+    }
+  }
+};
+
+} // namespace wa
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace wa {
+
+/// suffix array by SA-IS (induced sorting) and LCP array by Kasai, both in linear time.
+class SuffixArray {
+public:
+  /// `text` symbols are in [0, upper]. result[i] is the start of the i-th smallest suffix.
+  static std::vector<int32_t> build(std::span<int32_t const> text, int32_t upper) {
+    if (text.size() >= static_cast<size_t>(INT32_MAX)) {
+      throw std::length_error("suffix array");
+    }
+    return sa_is(text, upper);
+  }
+
+  /// result[i] is the length of the longest common prefix of the suffixes sa[i - 1] and sa[i], result[0] is 0.
+  static std::vector<int32_t> build_lcp(std::span<int32_t const> text, std::span<int32_t const> sa) {
+    int32_t const n = static_cast<int32_t>(text.size());
+    std::vector<int32_t> rank(text.size());
+    for (int32_t i = 0; i < n; i++) {
+      rank[sa[i]] = i;
+    }
+    std::vector<int32_t> lcp(text.size(), 0);
+    int32_t h = 0;
+    for (int32_t i = 0; i < n; i++) {
+      if (rank[i] == 0) {
+        h = 0;
+        continue;
+      }
+      int32_t const j = sa[rank[i] - 1];
+      while (i + h < n && j + h < n && text[i + h] == text[j + h]) {
+        h++;
+      }
+      lcp[rank[i]] = h;
+      if (h > 0) {
+        h--;
+      }
+    }
+    return lcp;
+  }
+
+private:
+  static std::vector<int32_t> sa_naive(std::span<int32_t const> text) {
+    std::vector<int32_t> sa(text.size());
+    for (size_t i = 0; i < sa.size(); i++) {
+      sa[i] = static_cast<int32_t>(i);
+    }
+    std::ranges::sort(sa, [text](int32_t l, int32_t r) {
+      return std::ranges::lexicographical_compare(text.subspan(l), text.subspan(r));
+    });
+    return sa;
+  }
+
+  static std::vector<int32_t> sa_is(std::span<int32_t const> s, int32_t upper) {
+    int32_t const n = static_cast<int32_t>(s.size());
+    if (n < 16) {
+      return sa_naive(s);
+    }
+
+    std::vector<int32_t> sa(s.size());
+    // true for S-type suffixes, which are smaller than the suffix starting one symbol later
+    std::vector<bool> ls(s.size(), false);
+    for (int32_t i = n - 2; i >= 0; i--) {
+      ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
+    }
+    // bucket starts of L-type (sum_l) and S-type (sum_s) suffixes per symbol
+    std::vector<int32_t> sum_l(upper + 1, 0);
+    std::vector<int32_t> sum_s(upper + 1, 0);
+    for (int32_t i = 0; i < n; i++) {
+      if (!ls[i]) {
+        sum_s[s[i]]++;
+      } else {
+        sum_l[s[i] + 1]++;
+      }
+    }
+    for (int32_t i = 0; i <= upper; i++) {
+      sum_s[i] += sum_l[i];
+      if (i < upper) {
+        sum_l[i + 1] += sum_s[i];
+      }
+    }
+
+    std::vector<int32_t> buf(upper + 1);
+    auto const induce = [&](std::vector<int32_t> const &lms) {
+      std::ranges::fill(sa, -1);
+      std::ranges::copy(sum_s, buf.begin());
+      for (int32_t d : lms) {
+        if (d != n) {
+          sa[buf[s[d]]++] = d;
+        }
+      }
+      std::ranges::copy(sum_l, buf.begin());
+      sa[buf[s[n - 1]]++] = n - 1;
+      for (int32_t i = 0; i < n; i++) {
+        int32_t const v = sa[i];
+        if (v >= 1 && !ls[v - 1]) {
+          sa[buf[s[v - 1]]++] = v - 1;
+        }
+      }
+      std::ranges::copy(sum_l, buf.begin());
+      for (int32_t i = n - 1; i >= 0; i--) {
+        int32_t const v = sa[i];
+        if (v >= 1 && ls[v - 1]) {
+          sa[--buf[s[v - 1] + 1]] = v - 1;
+        }
+      }
+    };
+
+    // leftmost S-type positions
+    std::vector<int32_t> lms_map(s.size() + 1U, -1);
+    std::vector<int32_t> lms{};
+    for (int32_t i = 1; i < n; i++) {
+      if (!ls[i - 1] && ls[i]) {
+        lms_map[i] = static_cast<int32_t>(lms.size());
+        lms.push_back(i);
+      }
+    }
+    int32_t const m = static_cast<int32_t>(lms.size());
+
+    induce(lms);
+
+    if (m == 0) {
+      return sa;
+    }
+    // name the sorted LMS substrings and sort the reduced string recursively
+    std::vector<int32_t> sorted_lms{};
+    sorted_lms.reserve(lms.size());
+    for (int32_t v : sa) {
+      if (lms_map[v] != -1) {
+        sorted_lms.push_back(v);
+      }
+    }
+    std::vector<int32_t> rec_s(lms.size());
+    int32_t rec_upper = 0;
+    rec_s[lms_map[sorted_lms[0]]] = 0;
+    for (int32_t i = 1; i < m; i++) {
+      int32_t l = sorted_lms[i - 1];
+      int32_t r = sorted_lms[i];
+      int32_t const end_l = (lms_map[l] + 1 < m) ? lms[lms_map[l] + 1] : n;
+      int32_t const end_r = (lms_map[r] + 1 < m) ? lms[lms_map[r] + 1] : n;
+      bool is_same = true;
+      if (end_l - l != end_r - r) {
+        is_same = false;
+      } else {
+        while (l < end_l && s[l] == s[r]) {
+          l++;
+          r++;
+        }
+        if (l == n || s[l] != s[r]) {
+          is_same = false;
+        }
+      }
+      if (!is_same) {
+        rec_upper++;
+      }
+      rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+    }
+    std::vector<int32_t> const rec_sa = sa_is(rec_s, rec_upper);
+    for (int32_t i = 0; i < m; i++) {
+      sorted_lms[i] = lms[rec_sa[i]];
+    }
+    induce(sorted_lms);
+    return sa;
+  }
+};
+
+} // namespace wa
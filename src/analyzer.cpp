@@ -1,15 +1,33 @@
 #include "analyzer.hpp"
 #include "args.hpp"
+#include <memory>
+#include <set>
+#include <utility>
 
 namespace wa {
 
 #define ANALYZER(name) static Arg<bool> name##_active{"--" #name, false};
 #include "analyzer_name.inc"
 
+#define TRANSFORM(name) static Arg<bool> name##_active{"--" #name, false};
+#include "transform_name.inc"
+
 void IAnalyzer::analyze(Module &module) {
   if (!m_is_finished) {
     analyze_impl(module);
     m_is_finished = true;
+    m_invalid_functions.clear();
+  } else if (!m_invalid_functions.empty()) {
+    // cleared first, dependencies analyzed by update_impl must not see a stale set
+    std::set<size_t> const function_indexes = std::move(m_invalid_functions);
+    m_invalid_functions.clear();
+    update_impl(module, function_indexes);
+  }
+}
+
+void IAnalyzer::invalidate(std::set<size_t> const &function_indexes) {
+  if (m_is_finished) {
+    m_invalid_functions.insert(function_indexes.begin(), function_indexes.end());
   }
 }
 
@@ -19,6 +37,25 @@ void AnalyzerManager::analyze() {
   }
 }
 
+void AnalyzerManager::transform() {
+  for (std::shared_ptr<ITransform> const &transform : m_active_transforms) {
+    run_transform(*transform);
+  }
+}
+
+void AnalyzerManager::run_transform(ITransform &transform) {
+  std::set<size_t> changed_functions{};
+  PreservedAnalyses const preserved = transform.run(m_module, changed_functions);
+  if (changed_functions.empty()) {
+    return;
+  }
+  for (auto const &[hash, analyzer] : m_analyzers) {
+    if (!preserved.is_preserved(hash)) {
+      analyzer->invalidate(changed_functions);
+    }
+  }
+}
+
 AnalyzerManager::AnalyzerManager(Module const &module)
     : m_module(module), m_analyzers{}, m_context{new AnalyzerContext(*this)} {
   auto register_analyzer = [this](std::shared_ptr<IAnalyzer> analyzer) {
@@ -37,10 +74,19 @@ AnalyzerManager::AnalyzerManager(Module const &module)
     }                                                                                                                  \
   }
 #include "analyzer_name.inc"
+
+#define TRANSFORM(name)                                                                                                \
+  if (name##_active) {                                                                                                 \
+    m_active_transforms.push_back(create##name##Transform(m_context));                                                 \
+  }
+#include "transform_name.inc"
 }
 
 #define ANALYZER(name)                                                                                                 \
   bool AnalyzerManager::is_##name##_active() { return name##_active; }
 #include "analyzer_name.inc"
+#define TRANSFORM(name)                                                                                                \
+  bool AnalyzerManager::is_##name##_active() { return name##_active; }
+#include "transform_name.inc"
 
 } // namespace wa
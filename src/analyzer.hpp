@@ -6,6 +6,8 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <typeinfo>
+#include <vector>
 
 namespace wa {
 
@@ -18,6 +20,7 @@ struct AnalyzerContext {
 
 class IAnalyzer {
   bool m_is_finished = false;
+  std::set<size_t> m_invalid_functions{}; // index in Module::m_functions
   std::shared_ptr<AnalyzerContext> m_context;
 
 public:
@@ -25,12 +28,18 @@ public:
 
   virtual ~IAnalyzer() = default;
 
+  /// analyze the module, or only the functions invalidated since the last analyze
   void analyze(Module &module);
+  /// results of `function_indexes` are out of date and recomputed by the next analyze
+  void invalidate(std::set<size_t> const &function_indexes);
 
   size_t get_type_hash() { return typeid(*this).hash_code(); }
 
 protected:
   virtual void analyze_impl(Module &module) = 0;
+  /// recompute the results of `function_indexes`. analyzers without per function results analyze the whole module
+  /// again, so analyze_impl must reset its results first.
+  virtual void update_impl(Module &module, std::set<size_t> const &) { analyze_impl(module); }
 
   AnalyzerContext const *get_context() const { return m_context.get(); }
   bool is_finished() const { return m_is_finished; }
@@ -39,10 +48,50 @@ protected:
 #define ANALYZER(name) std::shared_ptr<IAnalyzer> create##name##Analyzer(std::shared_ptr<AnalyzerContext> context);
 #include "analyzer_name.inc"
 
+/// analyzers whose results stay valid in the functions changed by a transform
+class PreservedAnalyses {
+  std::set<size_t> m_analyzers{};
+  bool m_is_all = false;
+
+public:
+  static PreservedAnalyses all() {
+    PreservedAnalyses preserved{};
+    preserved.m_is_all = true;
+    return preserved;
+  }
+  static PreservedAnalyses none() { return PreservedAnalyses{}; }
+
+  template <Derived<IAnalyzer> T> PreservedAnalyses &preserve() {
+    m_analyzers.insert(typeid(T).hash_code());
+    return *this;
+  }
+  bool is_preserved(size_t analyzer_hash) const { return m_is_all || m_analyzers.contains(analyzer_hash); }
+};
+
+/// pass which changes the module. analyzers it needs are taken from the manager like in IAnalyzer.
+class ITransform {
+  std::shared_ptr<AnalyzerContext> m_context;
+
+public:
+  explicit ITransform(std::shared_ptr<AnalyzerContext> const &context) : m_context(context) {}
+
+  virtual ~ITransform() = default;
+
+  /// transform the module and collect the indexes of the changed functions in `changed_functions`
+  virtual PreservedAnalyses run(Module &module, std::set<size_t> &changed_functions) = 0;
+
+protected:
+  AnalyzerContext const *get_context() const { return m_context.get(); }
+};
+
+#define TRANSFORM(name) std::shared_ptr<ITransform> create##name##Transform(std::shared_ptr<AnalyzerContext> context);
+#include "transform_name.inc"
+
 class AnalyzerManager {
   std::set<size_t> m_active_analyzers{};
   Module m_module;
   std::map<size_t, std::shared_ptr<IAnalyzer>> m_analyzers;
+  std::vector<std::shared_ptr<ITransform>> m_active_transforms{}; // in the order of transform_name.inc
   std::shared_ptr<AnalyzerContext> m_context;
 
 public:
@@ -52,10 +101,26 @@ public:
     return std::dynamic_pointer_cast<T>(m_analyzers.at(typeid(T).hash_code()));
   }
 
+  template <Derived<ITransform> T> std::shared_ptr<T> get_transform() const {
+    for (std::shared_ptr<ITransform> const &transform : m_active_transforms) {
+      if (std::shared_ptr<T> t = std::dynamic_pointer_cast<T>(transform)) {
+        return t;
+      }
+    }
+    return nullptr;
+  }
+
   void analyze();
+  /// run the active transforms, each one invalidates what it does not preserve in the functions it changed
+  void transform();
+  void run_transform(ITransform &transform);
+
+  Module const &get_module() const { return m_module; }
 
 #define ANALYZER(name) static bool is_##name##_active();
 #include "analyzer_name.inc"
+#define TRANSFORM(name) static bool is_##name##_active();
+#include "transform_name.inc"
 };
 
 } // namespace wa
@@ -11,6 +11,7 @@
 #include <memory>
 #include <ranges>
 #include <set>
+#include <stdexcept>
 #include <vector>
 
 namespace wa {
@@ -55,6 +56,7 @@ class BasicBlockBuilderImpl {
   std::map<size_t, BasicBlock> m_blocks{};
   size_t m_current_block_index = 0U;
   std::vector<std::unique_ptr<IWasmBlock>> m_wasm_block_stack{};
+  size_t m_loop_depth = 0U;
 
 public:
   explicit BasicBlockBuilderImpl(AnalyzerContext const *context, std::shared_ptr<Function> const &fn)
@@ -69,8 +71,17 @@ public:
 private:
   void build();
   size_t append_block();
-  void push_instr(size_t block_index, Instr *instr) { m_blocks[block_index].m_instr.push_back(instr); }
+  void push_instr(size_t block_index, Instr *instr) {
+    BasicBlock &block = m_blocks[block_index];
+    block.m_instr.push_back(instr);
+    block.m_loop_depth = m_loop_depth;
+  }
   void connect_block(size_t front, size_t back) { m_blocks.at(front).m_backs.insert(back); }
+  void connect_condition_block(size_t front, size_t back, bool condition) {
+    connect_block(front, back);
+    BasicBlock &block = m_blocks.at(front);
+    (condition ? block.m_true_target : block.m_false_target) = back;
+  }
   size_t get_br_target_block(size_t label_index) const {
     return m_wasm_block_stack.at(m_wasm_block_stack.size() - 1 - label_index)->get_br_target_block_index();
   }
@@ -106,13 +117,14 @@ void BasicBlockBuilderImpl::build() {
 
       m_current_block_index = this_block_index;
       m_wasm_block_stack.push_back(std::make_unique<WasmLoopBlock>(m_current_block_index, next_block_index));
+      m_loop_depth++;
       break;
     }
     case InstrCode::IF: {
       size_t const last_block_index = m_current_block_index;
       size_t const then_block_index = append_block();
       size_t const next_block_index = append_block();
-      connect_block(m_current_block_index, then_block_index);
+      connect_condition_block(m_current_block_index, then_block_index, true);
 
       push_instr(m_current_block_index, &instr);
       m_current_block_index = then_block_index;
@@ -125,8 +137,8 @@ void BasicBlockBuilderImpl::build() {
       size_t const else_block_index = append_block();
       size_t const last_block_index = if_block->get_last_block_index();
       size_t const next_block_index = if_block->get_end_target_block_index();
-      connect_block(m_current_block_index, next_block_index); // then to next
-      connect_block(last_block_index, else_block_index);      // last to else
+      connect_block(m_current_block_index, next_block_index);             // then to next
+      connect_condition_block(last_block_index, else_block_index, false); // last to else
 
       m_current_block_index = else_block_index;
       break;
@@ -139,8 +151,16 @@ void BasicBlockBuilderImpl::build() {
       if (if_block != nullptr) {
         size_t const last_block_index = if_block->get_last_block_index();
         connect_block(last_block_index, target_block_index);
+        BasicBlock &last_block = m_blocks.at(last_block_index);
+        if (last_block.m_false_target == BasicBlock::no_target) {
+          // if without else
+          last_block.m_false_target = target_block_index;
+        }
       }
 
+      if (dynamic_cast<WasmLoopBlock *>(m_wasm_block_stack.back().get()) != nullptr) {
+        m_loop_depth--;
+      }
       m_current_block_index = target_block_index;
       m_wasm_block_stack.pop_back();
       break;
@@ -167,8 +187,8 @@ void BasicBlockBuilderImpl::build() {
     case InstrCode::BR_IF: {
       size_t const next_block_index = append_block();
       size_t const target_block_index = get_br_target_block(instr.get_index());
-      connect_block(m_current_block_index, next_block_index);
-      connect_block(m_current_block_index, target_block_index);
+      connect_condition_block(m_current_block_index, next_block_index, false);
+      connect_condition_block(m_current_block_index, target_block_index, true);
 
       push_instr(m_current_block_index, &instr);
       m_current_block_index = next_block_index;
@@ -182,6 +202,7 @@ void BasicBlockBuilderImpl::build() {
       }
       push_instr(m_current_block_index, &instr);
       m_current_block_index = next_block_index;
+      break;
     }
     default: {
       push_instr(m_current_block_index, &instr);
@@ -194,6 +215,10 @@ void BasicBlockBuilderImpl::build() {
 bool BasicBlockBuilderImpl::clean_block_no_instr_one_target() {
   std::map<size_t, size_t> replaced_blocks{};
   for (auto &[block_index, block] : m_blocks) {
+    // entry block is the root of every dataflow analysis and cannot be merged into its successor
+    if (block_index == EnterBlockIndex) {
+      continue;
+    }
     if (block.m_instr.empty() && block.m_backs.size() == 1) {
       replaced_blocks.insert_or_assign(block_index, *block.m_backs.begin());
     }
@@ -210,8 +235,15 @@ bool BasicBlockBuilderImpl::clean_block_no_instr_one_target() {
     }
     return target_block_index;
   });
+  auto const replace = [&replaced_blocks](size_t &target_block_index) {
+    if (replaced_blocks.contains(target_block_index)) {
+      target_block_index = replaced_blocks[target_block_index];
+    }
+  };
   for (auto &[_, block] : m_blocks) {
     block.m_backs = block.m_backs | replacer | std::ranges::to<std::set>();
+    replace(block.m_true_target);
+    replace(block.m_false_target);
   }
   for (auto &[old_block, _] : replaced_blocks) {
     m_blocks.erase(old_block);
@@ -238,11 +270,31 @@ void BasicBlockBuilderImpl::simplify() {
 } // namespace
 
 void BasicBlockBuilder::analyze_impl(Module &module) {
-  m_cfg = module.m_functions |
-          std::views::filter([](std::shared_ptr<Function> const &fn) { return !fn->is_import(); }) |
-          std::views::transform(
-              [this](std::shared_ptr<Function> const &fn) { return BasicBlockBuilderImpl{get_context(), fn}.get(); }) |
-          std::ranges::to<std::vector>();
+  m_cfg.clear();
+  for (size_t function_index = 0; function_index < module.m_functions.size(); function_index++) {
+    std::shared_ptr<Function> const &fn = module.m_functions[function_index];
+    if (fn->is_import()) {
+      continue;
+    }
+    m_cfg.push_back(BasicBlockBuilderImpl{get_context(), fn}.get());
+    m_cfg.back().m_function_index = function_index;
+  }
+}
+
+void BasicBlockBuilder::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  for (size_t const function_index : function_indexes) {
+    Cfg &cfg = m_cfg.at(get_cfg_index(function_index));
+    cfg = BasicBlockBuilderImpl{get_context(), module.m_functions[function_index]}.get();
+    cfg.m_function_index = function_index;
+  }
+}
+
+size_t BasicBlockBuilder::get_cfg_index(size_t function_index) const {
+  auto it = std::ranges::lower_bound(m_cfg, function_index, {}, &Cfg::m_function_index);
+  if (it == m_cfg.end() || it->m_function_index != function_index) {
+    throw std::out_of_range("function has no cfg");
+  }
+  return static_cast<size_t>(it - m_cfg.begin());
 }
 
 std::shared_ptr<IAnalyzer> createBasicBlockBuilderAnalyzer(std::shared_ptr<AnalyzerContext> context) {
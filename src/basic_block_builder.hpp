@@ -2,8 +2,12 @@
 
 #include "analyzer.hpp"
 #include "cfg.hpp"
+#include "concept.hpp"
 #include "module.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
 #include <memory>
+#include <set>
 #include <vector>
 
 namespace wa {
@@ -17,6 +21,17 @@ class BasicBlockBuilder : public IAnalyzer {
 public:
   explicit BasicBlockBuilder(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
   std::vector<Cfg> const &get_cfgs() const { return m_cfg; };
+  /// position of the cfg of `function_index` in get_cfgs
+  size_t get_cfg_index(size_t function_index) const;
+  /// run `fn(cfg_index, cfg)` in parallel for the cfg of every function in `function_indexes`
+  template <Callable<void, size_t, Cfg const &> Fn>
+  void for_each_cfg(std::set<size_t> const &function_indexes, Fn const &fn) const {
+    std::vector<size_t> cfg_indexes{};
+    for (size_t const function_index : function_indexes) {
+      cfg_indexes.push_back(get_cfg_index(function_index));
+    }
+    ThreadPool::for_each(cfg_indexes.size(), [&](size_t i) { fn(cfg_indexes[i], m_cfg[cfg_indexes[i]]); });
+  }
 
   BlockRange get_all_blocks() const {
     return BlockRange{.m_begin = BlockIterator::create_begin(m_cfg), .m_end = BlockIterator::create_end(m_cfg)};
@@ -24,6 +39,7 @@ public:
 
 private:
   void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
 };
 
 } // namespace wa
@@ -0,0 +1,95 @@
+#include "benchmark.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "tree_height_balancing.hpp"
+#include "writer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+constexpr uint8_t TypeSection = 1U;
+constexpr uint8_t FunctionSection = 3U;
+constexpr uint8_t ExportSection = 7U;
+constexpr uint8_t CodeSection = 10U;
+
+Instr create_local_get(uint32_t local_index) {
+  Instr instr{InstrCode::LOCAL_GET};
+  instr.set_index(local_index);
+  return instr;
+}
+
+} // namespace
+
+Module create_add_chain_module(size_t depth) {
+  Module module{};
+  module.m_function_types.push_back(
+      std::make_shared<FunctionType>(std::vector<WasmType>{WasmType::I32}, std::vector<WasmType>{WasmType::I32}));
+
+  std::vector<Instr> instr{};
+  instr.reserve(2U * depth + 2U);
+  instr.push_back(create_local_get(0U));
+  for (size_t i = 0; i < depth; i++) {
+    instr.push_back(create_local_get(0U));
+    instr.emplace_back(InstrCode::I32_ADD);
+  }
+  instr.emplace_back(InstrCode::END);
+
+  auto function = std::make_shared<Function>();
+  function->set_type(module.m_function_types.front());
+  function->set_is_export();
+  function->set_instr(std::move(instr));
+  module.m_functions.push_back(function);
+
+  // export "chain" of function 0, the other sections are encoded by the writer
+  std::vector<uint8_t> exports{1U, 5U, 'c', 'h', 'a', 'i', 'n', 0U, 0U};
+  module.m_sections = {Section{.m_id = TypeSection},
+                       Section{.m_id = FunctionSection},
+                       Section{.m_id = ExportSection, .m_content = std::move(exports)},
+                       Section{.m_id = CodeSection}};
+  return module;
+}
+
+void run_tree_height_benchmark(std::vector<size_t> const &depths, size_t repeat, std::string const &output) {
+  using Clock = std::chrono::steady_clock;
+  size_t const run_num = std::max<size_t>(repeat, 1U);
+  for (size_t depth : depths) {
+    Module module = create_add_chain_module(depth);
+    double best_ms = std::numeric_limits<double>::infinity();
+    double total_ms = 0.0;
+    BlockCriticalPath critical_path{};
+    for (size_t i = 0; i < run_num; i++) {
+      // a fresh manager per run, analyzers keep their results once finished
+      AnalyzerManager analyzer_manager{module};
+      analyzer_manager.get_analyzer<BasicBlockBuilder>()->analyze(module);
+      auto balancing = analyzer_manager.get_analyzer<TreeHeightBalancing>();
+      Clock::time_point const begin = Clock::now();
+      balancing->analyze(module);
+      double const ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+      best_ms = std::min(best_ms, ms);
+      total_ms += ms;
+      critical_path = *std::ranges::max_element(balancing->get_results(), {}, &BlockCriticalPath::m_before);
+    }
+    std::cout << "depth=" << depth << " critical_path=" << critical_path.m_before << " -> " << critical_path.m_after
+              << " best=" << best_ms << "ms mean=" << total_ms / static_cast<double>(run_num) << "ms\n";
+  }
+
+  if (!output.empty() && !depths.empty()) {
+    std::ofstream os{output, std::ios::binary};
+    Writer{create_add_chain_module(*std::ranges::max_element(depths))}.write(os);
+  }
+}
+
+} // namespace wa
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "module.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wa {
+
+/// module exporting `chain (param i32) (result i32)`, a single block with a left-deep chain of `depth` i32.add
+Module create_add_chain_module(size_t depth);
+
+/// balances add chains of every depth `repeat` times and prints the critical path and the fastest run.
+/// the cfg is built before timing, so only TreeHeightBalancing is measured. the deepest module is written to
+/// `output` unless it is empty.
+void run_tree_height_benchmark(std::vector<size_t> const &depths, size_t repeat, std::string const &output);
+
+} // namespace wa
@@ -0,0 +1,238 @@
+#include "call_graph.hpp"
+#include "analyzer.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+constexpr uint32_t unvisited = std::numeric_limits<uint32_t>::max();
+
+/// iterative tarjan, an scc is completed only after all sccs reachable from it, so they come out bottom-up
+class TarjanImpl {
+  std::vector<std::vector<uint32_t>> const &m_callees;
+  std::vector<uint32_t> m_indexes;
+  std::vector<uint32_t> m_low_links;
+  std::vector<bool> m_is_on_stack;
+  std::vector<uint32_t> m_stack{};
+  uint32_t m_next_index = 0U;
+
+  struct Frame {
+    uint32_t m_function;
+    size_t m_next_callee;
+  };
+
+public:
+  std::vector<uint32_t> m_scc_indexes;
+  std::vector<std::vector<uint32_t>> m_sccs{};
+
+  explicit TarjanImpl(std::vector<std::vector<uint32_t>> const &callees)
+      : m_callees(callees), m_indexes(callees.size(), unvisited), m_low_links(callees.size(), 0U),
+        m_is_on_stack(callees.size(), false), m_scc_indexes(callees.size(), unvisited) {}
+
+  void run() {
+    for (uint32_t function_index = 0; function_index < m_callees.size(); function_index++) {
+      if (m_indexes[function_index] == unvisited) {
+        visit(function_index);
+      }
+    }
+  }
+
+private:
+  void enter(uint32_t function_index, std::vector<Frame> &frames) {
+    m_indexes[function_index] = m_next_index;
+    m_low_links[function_index] = m_next_index;
+    m_next_index++;
+    m_stack.push_back(function_index);
+    m_is_on_stack[function_index] = true;
+    frames.push_back(Frame{.m_function = function_index, .m_next_callee = 0U});
+  }
+
+  void visit(uint32_t root) {
+    std::vector<Frame> frames{};
+    enter(root, frames);
+    while (!frames.empty()) {
+      Frame &frame = frames.back();
+      uint32_t const function_index = frame.m_function;
+      std::vector<uint32_t> const &callees = m_callees[function_index];
+      if (frame.m_next_callee < callees.size()) {
+        uint32_t const callee = callees[frame.m_next_callee];
+        frame.m_next_callee++;
+        if (m_indexes[callee] == unvisited) {
+          enter(callee, frames);
+        } else if (m_is_on_stack[callee]) {
+          m_low_links[function_index] = std::min(m_low_links[function_index], m_indexes[callee]);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        uint32_t const caller = frames.back().m_function;
+        m_low_links[caller] = std::min(m_low_links[caller], m_low_links[function_index]);
+      }
+      if (m_low_links[function_index] == m_indexes[function_index]) {
+        pop_scc(function_index);
+      }
+    }
+  }
+
+  void pop_scc(uint32_t function_index) {
+    uint32_t const scc_index = static_cast<uint32_t>(m_sccs.size());
+    std::vector<uint32_t> &scc = m_sccs.emplace_back();
+    uint32_t member = unvisited;
+    while (member != function_index) {
+      member = m_stack.back();
+      m_stack.pop_back();
+      m_is_on_stack[member] = false;
+      m_scc_indexes[member] = scc_index;
+      scc.push_back(member);
+    }
+    std::sort(scc.begin(), scc.end());
+  }
+};
+
+} // namespace
+
+void CallGraph::analyze_impl(Module &module) {
+  size_t const function_num = module.m_functions.size();
+  m_callees.assign(function_num, {});
+  m_callers.assign(function_num, {});
+  m_is_import.assign(function_num, false);
+  m_is_self_recursive.assign(function_num, false);
+
+  ThreadPool::for_each(function_num, [&](size_t function_index) {
+    Function &function = *module.m_functions[function_index];
+    if (function.is_import()) {
+      return;
+    }
+    std::vector<uint32_t> &callees = m_callees[function_index];
+    for (Instr const &instr : function.get_instr()) {
+      if (instr.get_code() == InstrCode::CALL) {
+        callees.push_back(instr.get_index());
+      }
+    }
+    std::sort(callees.begin(), callees.end());
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+  });
+  // std::vector<bool> packs bits, so the flags are not written from the workers
+  for (uint32_t function_index = 0; function_index < function_num; function_index++) {
+    m_is_import[function_index] = module.m_functions[function_index]->is_import();
+    for (uint32_t callee : m_callees[function_index]) {
+      if (callee >= function_num) {
+        throw std::runtime_error("invalid call target");
+      }
+      m_callers[callee].push_back(function_index);
+      if (callee == function_index) {
+        m_is_self_recursive[function_index] = true;
+      }
+    }
+  }
+
+  TarjanImpl tarjan{m_callees};
+  tarjan.run();
+  m_scc_indexes = std::move(tarjan.m_scc_indexes);
+  m_sccs = std::move(tarjan.m_sccs);
+
+  // callees come first, so the wave of every callee scc is known when its caller is reached
+  std::vector<size_t> scc_waves(m_sccs.size(), 0U);
+  m_waves.clear();
+  for (size_t scc_index = 0; scc_index < m_sccs.size(); scc_index++) {
+    size_t wave = 0U;
+    for (uint32_t function_index : m_sccs[scc_index]) {
+      for (uint32_t callee : m_callees[function_index]) {
+        size_t const callee_scc = m_scc_indexes[callee];
+        if (callee_scc != scc_index) {
+          wave = std::max(wave, scc_waves[callee_scc] + 1U);
+        }
+      }
+    }
+    scc_waves[scc_index] = wave;
+    if (wave >= m_waves.size()) {
+      m_waves.resize(wave + 1U);
+    }
+    m_waves[wave].push_back(static_cast<uint32_t>(scc_index));
+  }
+
+  m_roots.clear();
+  for (uint32_t function_index = 0; function_index < function_num; function_index++) {
+    if (module.m_functions[function_index]->is_export() || module.m_start_function == function_index) {
+      m_roots.push_back(function_index);
+    }
+  }
+  m_is_reachable_from_roots.assign(function_num, false);
+  std::vector<uint32_t> worklist{m_roots};
+  for (uint32_t root : m_roots) {
+    m_is_reachable_from_roots[root] = true;
+  }
+  while (!worklist.empty()) {
+    uint32_t const function_index = worklist.back();
+    worklist.pop_back();
+    for (uint32_t callee : m_callees[function_index]) {
+      if (!m_is_reachable_from_roots[callee]) {
+        m_is_reachable_from_roots[callee] = true;
+        worklist.push_back(callee);
+      }
+    }
+  }
+}
+
+void CallGraph::dump_result() const {
+  size_t const import_num = static_cast<size_t>(std::count(m_is_import.begin(), m_is_import.end(), true));
+  size_t edge_num = 0U;
+  for (std::vector<uint32_t> const &callees : m_callees) {
+    edge_num += callees.size();
+  }
+  size_t recursive_scc_num = 0U;
+  for (size_t scc_index = 0; scc_index < m_sccs.size(); scc_index++) {
+    recursive_scc_num += is_recursive(scc_index) ? 1U : 0U;
+  }
+  size_t max_wave_width = 0U;
+  for (std::vector<uint32_t> const &wave : m_waves) {
+    max_wave_width = std::max(max_wave_width, wave.size());
+  }
+  std::cout << "functions=" << m_callees.size() << " imports=" << import_num << " calls=" << edge_num
+            << " sccs=" << m_sccs.size() << " recursive=" << recursive_scc_num << " waves=" << m_waves.size()
+            << " max_wave_width=" << max_wave_width << " roots=" << m_roots.size();
+  if (!m_roots.empty()) {
+    size_t const unreachable_num = static_cast<size_t>(
+        std::count(m_is_reachable_from_roots.begin(), m_is_reachable_from_roots.end(), false));
+    std::cout << " unreachable_from_roots=" << unreachable_num;
+  }
+  std::cout << "\n";
+
+  for (size_t wave_index = 0; wave_index < m_waves.size(); wave_index++) {
+    size_t function_num = 0U;
+    for (uint32_t scc_index : m_waves[wave_index]) {
+      function_num += m_sccs[scc_index].size();
+    }
+    std::cout << "wave[" << wave_index << "] sccs=" << m_waves[wave_index].size() << " functions=" << function_num
+              << "\n";
+  }
+  for (size_t scc_index = 0; scc_index < m_sccs.size(); scc_index++) {
+    if (!is_recursive(scc_index)) {
+      continue;
+    }
+    std::cout << "recursive scc[" << scc_index << "]:";
+    for (uint32_t function_index : m_sccs[scc_index]) {
+      std::cout << " " << function_index;
+    }
+    std::cout << "\n";
+  }
+}
+
+std::shared_ptr<IAnalyzer> createCallGraphAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<CallGraph>(new CallGraph(context));
+}
+
+} // namespace wa
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace wa {
+
+/// direct calls between functions. imports have no body and are external leaves. call_indirect targets are not
+/// known without the table, so such calls have no edge.
+/// strongly connected components are numbered bottom-up, callees before callers. wave 0 holds the components which
+/// only call into themselves, wave n the components whose callees are in earlier waves, so the components of one
+/// wave are independent of each other.
+class CallGraph : public IAnalyzer {
+  std::vector<std::vector<uint32_t>> m_callees{}; // indexed by function index, sorted
+  std::vector<std::vector<uint32_t>> m_callers{}; // indexed by function index, sorted
+  std::vector<bool> m_is_import{};
+  std::vector<bool> m_is_self_recursive{};
+  std::vector<uint32_t> m_scc_indexes{};         // function index -> scc index
+  std::vector<std::vector<uint32_t>> m_sccs{};   // function indexes of each scc
+  std::vector<std::vector<uint32_t>> m_waves{};  // scc indexes of each wave
+  std::vector<uint32_t> m_roots{};               // exported functions and the start function
+  std::vector<bool> m_is_reachable_from_roots{}; // indexed by function index
+
+public:
+  explicit CallGraph(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<uint32_t> const &get_callees(size_t function_index) const { return m_callees.at(function_index); }
+  std::vector<uint32_t> const &get_callers(size_t function_index) const { return m_callers.at(function_index); }
+  size_t get_scc_index(size_t function_index) const { return m_scc_indexes.at(function_index); }
+  std::vector<std::vector<uint32_t>> const &get_sccs() const { return m_sccs; }
+  std::vector<std::vector<uint32_t>> const &get_waves() const { return m_waves; }
+  std::vector<uint32_t> const &get_roots() const { return m_roots; }
+  /// scc with a cycle of calls
+  bool is_recursive(size_t scc_index) const {
+    return m_sccs.at(scc_index).size() > 1U || m_is_self_recursive[m_sccs[scc_index].front()];
+  }
+
+  /// calls `fn(scc)` for every scc, bottom-up. the sccs of one wave run in parallel on the thread pool.
+  template <Callable<void, std::span<uint32_t const>> Fn> void for_each_scc_bottom_up(Fn const &fn) const {
+    for (std::vector<uint32_t> const &wave : m_waves) {
+      ThreadPool::for_each(wave.size(), [&](size_t i) { fn(std::span<uint32_t const>{m_sccs[wave[i]]}); });
+    }
+  }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+};
+
+} // namespace wa
@@ -1,4 +1,5 @@
 #include "cfg.hpp"
+#include "instruction.hpp"
 #include <cstddef>
 #include <iostream>
 
@@ -23,16 +24,37 @@ void Cfg::dump(std::map<size_t, BasicBlock> const &blocks) {
     for (size_t target : block.m_backs)
       std::cout << "BB[" << target << "] ";
     std::cout << "\n";
+    if (block.m_loop_depth != 0U)
+      std::cout << "    loop depth: " << block.m_loop_depth << "\n";
     for (Instr *instr : block.m_instr)
       std::cout << "    " << *instr << "\n";
   }
 }
 
+bool BasicBlock::is_fall_through(size_t back) const {
+  if (m_instr.empty()) {
+    return true;
+  }
+  switch (m_instr.back()->get_code()) {
+  case InstrCode::BR_IF:
+    return back == m_false_target && back != m_true_target;
+  case InstrCode::BR:
+  case InstrCode::BR_TABLE:
+  case InstrCode::RETURN:
+  case InstrCode::UNREACHABLE:
+    return false;
+  default:
+    return true;
+  }
+}
+
 void BasicBlock::dump() const {
   std::cout << "target: ";
   for (size_t target : m_backs)
     std::cout << "BB[" << target << "] ";
   std::cout << "\n";
+  if (m_loop_depth != 0U)
+    std::cout << "loop depth: " << m_loop_depth << "\n";
   for (Instr *instr : m_instr)
     std::cout << "  " << *instr << "\n";
 }
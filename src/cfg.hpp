@@ -9,13 +9,23 @@
 namespace wa {
 
 struct BasicBlock {
+  static constexpr size_t no_target = static_cast<size_t>(-1);
+
   std::vector<Instr *> m_instr{};
   std::set<size_t> m_backs{};
-
+  size_t m_loop_depth = 0U; // number of wasm loops enclosing the instructions
+  // successors of a trailing `if` / `br_if` when the condition is non zero / zero
+  size_t m_true_target = no_target;
+  size_t m_false_target = no_target;
+
+  /// the operand stack at the end of this block reaches `back` unchanged. a branch only carries the values of its
+  /// label, the rest of the stack at the target is not known from this block.
+  bool is_fall_through(size_t back) const;
   void dump() const;
 };
 
 struct Cfg {
+  size_t m_function_index = 0U; // index in Module::m_functions
   std::map<size_t, BasicBlock> m_blocks{};
   mutable std::map<size_t, std::set<size_t>> m_pred_map_cache{};
 
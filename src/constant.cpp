@@ -0,0 +1,520 @@
+#include "constant.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace wa {
+
+std::ostream &operator<<(std::ostream &os, Constant const &constant) {
+  switch (constant.m_type) {
+  case WasmType::I32:
+    return os << "i32 " << static_cast<int32_t>(constant.get_i32());
+  case WasmType::I64:
+    return os << "i64 " << static_cast<int64_t>(constant.get_i64());
+  case WasmType::F32:
+    return os << "f32 " << constant.get_f32();
+  case WasmType::F64:
+    return os << "f64 " << constant.get_f64();
+  default:
+    return os << constant.m_type << " " << constant.m_bits;
+  }
+}
+
+std::optional<Constant> get_constant(Instr const &instr) {
+  switch (instr.get_code()) {
+  case InstrCode::I32_CONST:
+    return Constant::from_i32(static_cast<uint32_t>(instr.get_value<int32_t>()));
+  case InstrCode::I64_CONST:
+    return Constant::from_i64(static_cast<uint64_t>(instr.get_value<int64_t>()));
+  case InstrCode::F32_CONST:
+    return Constant::from_f32(instr.get_value<float>());
+  case InstrCode::F64_CONST:
+    return Constant::from_f64(instr.get_value<double>());
+  default:
+    return std::nullopt;
+  }
+}
+
+Instr create_constant_instr(Constant const &constant) {
+  switch (constant.m_type) {
+  case WasmType::I32: {
+    Instr instr{InstrCode::I32_CONST};
+    instr.set_value(static_cast<int32_t>(constant.get_i32()));
+    return instr;
+  }
+  case WasmType::I64: {
+    Instr instr{InstrCode::I64_CONST};
+    instr.set_value(static_cast<int64_t>(constant.get_i64()));
+    return instr;
+  }
+  case WasmType::F32: {
+    Instr instr{InstrCode::F32_CONST};
+    instr.set_value(constant.get_f32());
+    return instr;
+  }
+  case WasmType::F64: {
+    Instr instr{InstrCode::F64_CONST};
+    instr.set_value(constant.get_f64());
+    return instr;
+  }
+  default:
+    throw std::invalid_argument("no constant instruction for this type");
+  }
+}
+
+namespace {
+
+constexpr uint32_t f32_sign = 0x80000000U;
+constexpr uint64_t f64_sign = 0x8000000000000000ULL;
+
+Constant from_bool(bool v) { return Constant::from_i32(v ? 1U : 0U); }
+
+Constant from_float(float v) {
+  return std::isnan(v) ? Constant{.m_type = WasmType::F32, .m_bits = 0x7FC00000U} : Constant::from_f32(v);
+}
+Constant from_float(double v) {
+  return std::isnan(v) ? Constant{.m_type = WasmType::F64, .m_bits = 0x7FF8000000000000ULL} : Constant::from_f64(v);
+}
+
+/// min / max order -0 below +0 and propagate NaN, unlike std::fmin / std::fmax
+template <class F> F get_min(F a, F b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::numeric_limits<F>::quiet_NaN();
+  }
+  if (a == b) {
+    return std::signbit(a) ? a : b;
+  }
+  return a < b ? a : b;
+}
+template <class F> F get_max(F a, F b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::numeric_limits<F>::quiet_NaN();
+  }
+  if (a == b) {
+    return std::signbit(a) ? b : a;
+  }
+  return a > b ? a : b;
+}
+
+/// truncation towards zero, nullopt when the result is not representable and the instruction traps
+template <class I, class F> std::optional<I> truncate(F v) {
+  if (std::isnan(v)) {
+    return std::nullopt;
+  }
+  F const t = std::trunc(v);
+  // every bound is a power of 2 and exact in F
+  F const upper = std::ldexp(F{1}, std::numeric_limits<I>::digits);
+  bool const is_in_range = std::is_signed_v<I> ? (t >= -upper && t < upper) : (t > F{-1} && t < upper);
+  if (!is_in_range) {
+    return std::nullopt;
+  }
+  return static_cast<I>(t);
+}
+
+template <class I, class F> I truncate_saturating(F v) {
+  if (std::isnan(v)) {
+    return I{0};
+  }
+  std::optional<I> const result = truncate<I>(v);
+  if (result.has_value()) {
+    return result.value();
+  }
+  return v < F{0} ? std::numeric_limits<I>::min() : std::numeric_limits<I>::max();
+}
+
+std::optional<Constant> evaluate_unary(InstrCode code, Constant const &a) {
+  uint32_t const i32 = a.get_i32();
+  uint64_t const i64 = a.get_i64();
+  float const f32 = a.get_f32();
+  double const f64 = a.get_f64();
+  switch (code) {
+  case InstrCode::I32_EQZ:
+    return from_bool(i32 == 0U);
+  case InstrCode::I64_EQZ:
+    return from_bool(i64 == 0U);
+  case InstrCode::I32_CLZ:
+    return Constant::from_i32(static_cast<uint32_t>(std::countl_zero(i32)));
+  case InstrCode::I32_CTZ:
+    return Constant::from_i32(static_cast<uint32_t>(std::countr_zero(i32)));
+  case InstrCode::I32_POPCNT:
+    return Constant::from_i32(static_cast<uint32_t>(std::popcount(i32)));
+  case InstrCode::I64_CLZ:
+    return Constant::from_i64(static_cast<uint64_t>(std::countl_zero(i64)));
+  case InstrCode::I64_CTZ:
+    return Constant::from_i64(static_cast<uint64_t>(std::countr_zero(i64)));
+  case InstrCode::I64_POPCNT:
+    return Constant::from_i64(static_cast<uint64_t>(std::popcount(i64)));
+
+  // sign bit operations are exact on the bits, NaN payloads included
+  case InstrCode::F32_ABS:
+    return Constant{.m_type = WasmType::F32, .m_bits = i32 & ~f32_sign};
+  case InstrCode::F32_NEG:
+    return Constant{.m_type = WasmType::F32, .m_bits = i32 ^ f32_sign};
+  case InstrCode::F64_ABS:
+    return Constant{.m_type = WasmType::F64, .m_bits = i64 & ~f64_sign};
+  case InstrCode::F64_NEG:
+    return Constant{.m_type = WasmType::F64, .m_bits = i64 ^ f64_sign};
+  case InstrCode::F32_CEIL:
+    return from_float(std::ceil(f32));
+  case InstrCode::F32_FLOOR:
+    return from_float(std::floor(f32));
+  case InstrCode::F32_TRUNC:
+    return from_float(std::trunc(f32));
+  case InstrCode::F32_NEAREST:
+    return from_float(std::nearbyint(f32));
+  case InstrCode::F32_SQRT:
+    return from_float(std::sqrt(f32));
+  case InstrCode::F64_CEIL:
+    return from_float(std::ceil(f64));
+  case InstrCode::F64_FLOOR:
+    return from_float(std::floor(f64));
+  case InstrCode::F64_TRUNC:
+    return from_float(std::trunc(f64));
+  case InstrCode::F64_NEAREST:
+    return from_float(std::nearbyint(f64));
+  case InstrCode::F64_SQRT:
+    return from_float(std::sqrt(f64));
+
+  case InstrCode::I32_WRAP_I64:
+    return Constant::from_i32(static_cast<uint32_t>(i64));
+  case InstrCode::I64_EXTEND_S_I32:
+    return Constant::from_i64(static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(i32))));
+  case InstrCode::I64_EXTEND_U_I32:
+    return Constant::from_i64(i32);
+  case InstrCode::I32_EXTEND8_S:
+    return Constant::from_i32(static_cast<uint32_t>(static_cast<int32_t>(static_cast<int8_t>(i32))));
+  case InstrCode::I32_EXTEND16_S:
+    return Constant::from_i32(static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(i32))));
+  case InstrCode::I64_EXTEND8_S:
+    return Constant::from_i64(static_cast<uint64_t>(static_cast<int64_t>(static_cast<int8_t>(i64))));
+  case InstrCode::I64_EXTEND16_S:
+    return Constant::from_i64(static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(i64))));
+  case InstrCode::I64_EXTEND32_S:
+    return Constant::from_i64(static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(i64))));
+
+  case InstrCode::I32_TRUNC_S_F32:
+    if (std::optional<int32_t> const v = truncate<int32_t>(f32)) {
+      return Constant::from_i32(static_cast<uint32_t>(*v));
+    }
+    return std::nullopt;
+  case InstrCode::I32_TRUNC_U_F32:
+    if (std::optional<uint32_t> const v = truncate<uint32_t>(f32)) {
+      return Constant::from_i32(*v);
+    }
+    return std::nullopt;
+  case InstrCode::I32_TRUNC_S_F64:
+    if (std::optional<int32_t> const v = truncate<int32_t>(f64)) {
+      return Constant::from_i32(static_cast<uint32_t>(*v));
+    }
+    return std::nullopt;
+  case InstrCode::I32_TRUNC_U_F64:
+    if (std::optional<uint32_t> const v = truncate<uint32_t>(f64)) {
+      return Constant::from_i32(*v);
+    }
+    return std::nullopt;
+  case InstrCode::I64_TRUNC_S_F32:
+    if (std::optional<int64_t> const v = truncate<int64_t>(f32)) {
+      return Constant::from_i64(static_cast<uint64_t>(*v));
+    }
+    return std::nullopt;
+  case InstrCode::I64_TRUNC_U_F32:
+    if (std::optional<uint64_t> const v = truncate<uint64_t>(f32)) {
+      return Constant::from_i64(*v);
+    }
+    return std::nullopt;
+  case InstrCode::I64_TRUNC_S_F64:
+    if (std::optional<int64_t> const v = truncate<int64_t>(f64)) {
+      return Constant::from_i64(static_cast<uint64_t>(*v));
+    }
+    return std::nullopt;
+  case InstrCode::I64_TRUNC_U_F64:
+    if (std::optional<uint64_t> const v = truncate<uint64_t>(f64)) {
+      return Constant::from_i64(*v);
+    }
+    return std::nullopt;
+  case InstrCode::I32_TRUNC_SAT_F32_S:
+    return Constant::from_i32(static_cast<uint32_t>(truncate_saturating<int32_t>(f32)));
+  case InstrCode::I32_TRUNC_SAT_F32_U:
+    return Constant::from_i32(truncate_saturating<uint32_t>(f32));
+  case InstrCode::I32_TRUNC_SAT_F64_S:
+    return Constant::from_i32(static_cast<uint32_t>(truncate_saturating<int32_t>(f64)));
+  case InstrCode::I32_TRUNC_SAT_F64_U:
+    return Constant::from_i32(truncate_saturating<uint32_t>(f64));
+  case InstrCode::I64_TRUNC_SAT_F32_S:
+    return Constant::from_i64(static_cast<uint64_t>(truncate_saturating<int64_t>(f32)));
+  case InstrCode::I64_TRUNC_SAT_F32_U:
+    return Constant::from_i64(truncate_saturating<uint64_t>(f32));
+  case InstrCode::I64_TRUNC_SAT_F64_S:
+    return Constant::from_i64(static_cast<uint64_t>(truncate_saturating<int64_t>(f64)));
+  case InstrCode::I64_TRUNC_SAT_F64_U:
+    return Constant::from_i64(truncate_saturating<uint64_t>(f64));
+
+  // integer to float conversions round to nearest, as the host conversions do
+  case InstrCode::F32_CONVERT_S_I32:
+    return Constant::from_f32(static_cast<float>(static_cast<int32_t>(i32)));
+  case InstrCode::F32_CONVERT_U_I32:
+    return Constant::from_f32(static_cast<float>(i32));
+  case InstrCode::F32_CONVERT_S_I64:
+    return Constant::from_f32(static_cast<float>(static_cast<int64_t>(i64)));
+  case InstrCode::F32_CONVERT_U_I64:
+    return Constant::from_f32(static_cast<float>(i64));
+  case InstrCode::F64_CONVERT_S_I32:
+    return Constant::from_f64(static_cast<double>(static_cast<int32_t>(i32)));
+  case InstrCode::F64_CONVERT_U_I32:
+    return Constant::from_f64(static_cast<double>(i32));
+  case InstrCode::F64_CONVERT_S_I64:
+    return Constant::from_f64(static_cast<double>(static_cast<int64_t>(i64)));
+  case InstrCode::F64_CONVERT_U_I64:
+    return Constant::from_f64(static_cast<double>(i64));
+  case InstrCode::F32_DEMOTE_F64:
+    return from_float(static_cast<float>(f64));
+  case InstrCode::F64_PROMOTE_F32:
+    return from_float(static_cast<double>(f32));
+
+  case InstrCode::I32_REINTERPRET_F32:
+    return Constant::from_i32(i32);
+  case InstrCode::I64_REINTERPRET_F64:
+    return Constant::from_i64(i64);
+  case InstrCode::F32_REINTERPRET_I32:
+    return Constant{.m_type = WasmType::F32, .m_bits = i32};
+  case InstrCode::F64_REINTERPRET_I64:
+    return Constant{.m_type = WasmType::F64, .m_bits = i64};
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<Constant> evaluate_i32_binary(InstrCode code, uint32_t a, uint32_t b) {
+  int32_t const sa = static_cast<int32_t>(a);
+  int32_t const sb = static_cast<int32_t>(b);
+  switch (code) {
+  case InstrCode::I32_EQ:
+    return from_bool(a == b);
+  case InstrCode::I32_NE:
+    return from_bool(a != b);
+  case InstrCode::I32_LT_S:
+    return from_bool(sa < sb);
+  case InstrCode::I32_LT_U:
+    return from_bool(a < b);
+  case InstrCode::I32_GT_S:
+    return from_bool(sa > sb);
+  case InstrCode::I32_GT_U:
+    return from_bool(a > b);
+  case InstrCode::I32_LE_S:
+    return from_bool(sa <= sb);
+  case InstrCode::I32_LE_U:
+    return from_bool(a <= b);
+  case InstrCode::I32_GE_S:
+    return from_bool(sa >= sb);
+  case InstrCode::I32_GE_U:
+    return from_bool(a >= b);
+  case InstrCode::I32_ADD:
+    return Constant::from_i32(a + b);
+  case InstrCode::I32_SUB:
+    return Constant::from_i32(a - b);
+  case InstrCode::I32_MUL:
+    return Constant::from_i32(a * b);
+  case InstrCode::I32_DIV_S:
+    if (b == 0U || (sa == std::numeric_limits<int32_t>::min() && sb == -1)) {
+      return std::nullopt;
+    }
+    return Constant::from_i32(static_cast<uint32_t>(sa / sb));
+  case InstrCode::I32_DIV_U:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    return Constant::from_i32(a / b);
+  case InstrCode::I32_REM_S:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    // INT_MIN % -1 overflows in C++ but is 0 in wasm
+    return Constant::from_i32(sb == -1 ? 0U : static_cast<uint32_t>(sa % sb));
+  case InstrCode::I32_REM_U:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    return Constant::from_i32(a % b);
+  case InstrCode::I32_AND:
+    return Constant::from_i32(a & b);
+  case InstrCode::I32_OR:
+    return Constant::from_i32(a | b);
+  case InstrCode::I32_XOR:
+    return Constant::from_i32(a ^ b);
+  case InstrCode::I32_SHL:
+    return Constant::from_i32(a << (b & 31U));
+  case InstrCode::I32_SHR_S:
+    return Constant::from_i32(static_cast<uint32_t>(sa >> (b & 31U)));
+  case InstrCode::I32_SHR_U:
+    return Constant::from_i32(a >> (b & 31U));
+  case InstrCode::I32_ROTL:
+    return Constant::from_i32(std::rotl(a, static_cast<int>(b & 31U)));
+  case InstrCode::I32_ROTR:
+    return Constant::from_i32(std::rotr(a, static_cast<int>(b & 31U)));
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<Constant> evaluate_i64_binary(InstrCode code, uint64_t a, uint64_t b) {
+  int64_t const sa = static_cast<int64_t>(a);
+  int64_t const sb = static_cast<int64_t>(b);
+  switch (code) {
+  case InstrCode::I64_EQ:
+    return from_bool(a == b);
+  case InstrCode::I64_NE:
+    return from_bool(a != b);
+  case InstrCode::I64_LT_S:
+    return from_bool(sa < sb);
+  case InstrCode::I64_LT_U:
+    return from_bool(a < b);
+  case InstrCode::I64_GT_S:
+    return from_bool(sa > sb);
+  case InstrCode::I64_GT_U:
+    return from_bool(a > b);
+  case InstrCode::I64_LE_S:
+    return from_bool(sa <= sb);
+  case InstrCode::I64_LE_U:
+    return from_bool(a <= b);
+  case InstrCode::I64_GE_S:
+    return from_bool(sa >= sb);
+  case InstrCode::I64_GE_U:
+    return from_bool(a >= b);
+  case InstrCode::I64_ADD:
+    return Constant::from_i64(a + b);
+  case InstrCode::I64_SUB:
+    return Constant::from_i64(a - b);
+  case InstrCode::I64_MUL:
+    return Constant::from_i64(a * b);
+  case InstrCode::I64_DIV_S:
+    if (b == 0U || (sa == std::numeric_limits<int64_t>::min() && sb == -1)) {
+      return std::nullopt;
+    }
+    return Constant::from_i64(static_cast<uint64_t>(sa / sb));
+  case InstrCode::I64_DIV_U:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    return Constant::from_i64(a / b);
+  case InstrCode::I64_REM_S:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    return Constant::from_i64(sb == -1 ? 0U : static_cast<uint64_t>(sa % sb));
+  case InstrCode::I64_REM_U:
+    if (b == 0U) {
+      return std::nullopt;
+    }
+    return Constant::from_i64(a % b);
+  case InstrCode::I64_AND:
+    return Constant::from_i64(a & b);
+  case InstrCode::I64_OR:
+    return Constant::from_i64(a | b);
+  case InstrCode::I64_XOR:
+    return Constant::from_i64(a ^ b);
+  case InstrCode::I64_SHL:
+    return Constant::from_i64(a << (b & 63U));
+  case InstrCode::I64_SHR_S:
+    return Constant::from_i64(static_cast<uint64_t>(sa >> (b & 63U)));
+  case InstrCode::I64_SHR_U:
+    return Constant::from_i64(a >> (b & 63U));
+  case InstrCode::I64_ROTL:
+    return Constant::from_i64(std::rotl(a, static_cast<int>(b & 63U)));
+  case InstrCode::I64_ROTR:
+    return Constant::from_i64(std::rotr(a, static_cast<int>(b & 63U)));
+  default:
+    return std::nullopt;
+  }
+}
+
+template <class F> std::optional<Constant> evaluate_float_binary(InstrCode code, F a, F b, uint64_t a_bits,
+                                                                 uint64_t b_bits) {
+  constexpr bool is_f32 = std::is_same_v<F, float>;
+  auto const select = [](InstrCode f32_code, InstrCode f64_code) { return is_f32 ? f32_code : f64_code; };
+  if (code == select(InstrCode::F32_EQ, InstrCode::F64_EQ)) {
+    return from_bool(a == b);
+  }
+  if (code == select(InstrCode::F32_NE, InstrCode::F64_NE)) {
+    return from_bool(a != b);
+  }
+  if (code == select(InstrCode::F32_LT, InstrCode::F64_LT)) {
+    return from_bool(a < b);
+  }
+  if (code == select(InstrCode::F32_GT, InstrCode::F64_GT)) {
+    return from_bool(a > b);
+  }
+  if (code == select(InstrCode::F32_LE, InstrCode::F64_LE)) {
+    return from_bool(a <= b);
+  }
+  if (code == select(InstrCode::F32_GE, InstrCode::F64_GE)) {
+    return from_bool(a >= b);
+  }
+  if (code == select(InstrCode::F32_ADD, InstrCode::F64_ADD)) {
+    return from_float(static_cast<F>(a + b));
+  }
+  if (code == select(InstrCode::F32_SUB, InstrCode::F64_SUB)) {
+    return from_float(static_cast<F>(a - b));
+  }
+  if (code == select(InstrCode::F32_MUL, InstrCode::F64_MUL)) {
+    return from_float(static_cast<F>(a * b));
+  }
+  if (code == select(InstrCode::F32_DIV, InstrCode::F64_DIV)) {
+    return from_float(static_cast<F>(a / b));
+  }
+  if (code == select(InstrCode::F32_MIN, InstrCode::F64_MIN)) {
+    return from_float(get_min(a, b));
+  }
+  if (code == select(InstrCode::F32_MAX, InstrCode::F64_MAX)) {
+    return from_float(get_max(a, b));
+  }
+  if (code == select(InstrCode::F32_COPYSIGN, InstrCode::F64_COPYSIGN)) {
+    uint64_t const sign = is_f32 ? f32_sign : f64_sign;
+    return Constant{.m_type = is_f32 ? WasmType::F32 : WasmType::F64, .m_bits = (a_bits & ~sign) | (b_bits & sign)};
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+std::optional<Constant> evaluate(InstrCode code, std::span<Constant const> operands) {
+  switch (operands.size()) {
+  case 1U:
+    return evaluate_unary(code, operands[0]);
+  case 2U: {
+    Constant const &a = operands[0];
+    Constant const &b = operands[1];
+    if (a.m_type != b.m_type) {
+      return std::nullopt;
+    }
+    switch (a.m_type) {
+    case WasmType::I32:
+      return evaluate_i32_binary(code, a.get_i32(), b.get_i32());
+    case WasmType::I64:
+      return evaluate_i64_binary(code, a.get_i64(), b.get_i64());
+    case WasmType::F32:
+      return evaluate_float_binary(code, a.get_f32(), b.get_f32(), a.m_bits, b.m_bits);
+    case WasmType::F64:
+      return evaluate_float_binary(code, a.get_f64(), b.get_f64(), a.m_bits, b.m_bits);
+    default:
+      return std::nullopt;
+    }
+  }
+  case 3U:
+    if (code != InstrCode::SELECT || operands[2].m_type != WasmType::I32) {
+      return std::nullopt;
+    }
+    return operands[2].get_i32() != 0U ? operands[0] : operands[1];
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace wa
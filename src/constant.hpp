@@ -0,0 +1,43 @@
+#pragma once
+
+#include "instruction.hpp"
+#include "module.hpp"
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+
+namespace wa {
+
+/// value of a number type. floats are kept as bits, so NaN payloads and the sign of zero survive.
+struct Constant {
+  WasmType m_type;
+  uint64_t m_bits; // i32 and f32 are zero extended
+
+  static Constant from_i32(uint32_t v) { return Constant{.m_type = WasmType::I32, .m_bits = v}; }
+  static Constant from_i64(uint64_t v) { return Constant{.m_type = WasmType::I64, .m_bits = v}; }
+  static Constant from_f32(float v) { return Constant{.m_type = WasmType::F32, .m_bits = std::bit_cast<uint32_t>(v)}; }
+  static Constant from_f64(double v) { return Constant{.m_type = WasmType::F64, .m_bits = std::bit_cast<uint64_t>(v)}; }
+
+  uint32_t get_i32() const { return static_cast<uint32_t>(m_bits); }
+  uint64_t get_i64() const { return m_bits; }
+  float get_f32() const { return std::bit_cast<float>(static_cast<uint32_t>(m_bits)); }
+  double get_f64() const { return std::bit_cast<double>(m_bits); }
+
+  bool operator==(Constant const &o) const = default;
+
+  friend std::ostream &operator<<(std::ostream &os, Constant const &constant);
+};
+
+/// value of i32.const / i64.const / f32.const / f64.const
+std::optional<Constant> get_constant(Instr const &instr);
+/// constant instruction which pushes `constant`
+Instr create_constant_instr(Constant const &constant);
+
+/// result of a pure numeric instruction with wasm semantics, `operands` in push order.
+/// nullopt for other instructions and when the instruction traps, e.g. integer division by zero.
+/// arithmetic producing a NaN gives the canonical NaN, which is valid for every NaN the operands may carry.
+std::optional<Constant> evaluate(InstrCode code, std::span<Constant const> operands);
+
+} // namespace wa
@@ -0,0 +1,371 @@
+#include "constant_folding.hpp"
+#include "adt/scoped_hash_map.hpp"
+#include "analyzer.hpp"
+#include "args.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "constant.hpp"
+#include "extend_basic_block_builder.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <vector>
+
+namespace wa {
+
+static const Arg<bool> apply{"--ConstantFolding.apply", false}; // rewrite the module instead of only reporting
+
+namespace {
+
+constexpr size_t npos = static_cast<size_t>(-1);
+
+/// instructions in [m_begin, m_end) of the function compute a constant and can be replaced by it
+struct Replacement {
+  size_t m_begin;
+  size_t m_end;
+  Constant m_constant;
+};
+
+struct StackValue {
+  std::optional<Constant> m_constant = std::nullopt;
+  size_t m_begin = npos; // npos when the value is not computed by contiguous instructions of the current block
+  size_t m_end = npos;
+  size_t m_size = 0U;        // instructions in [m_begin, m_end)
+  bool m_from_local = false; // single local.get of a known local
+
+  bool is_replaceable() const { return m_constant.has_value() && m_begin != npos; }
+};
+
+class ConstantFoldingImpl {
+  Module const &m_module;
+  Function &m_function;
+  ScopedHashMap<uint32_t, std::optional<Constant>> m_locals{};
+  std::vector<StackValue> m_stack{};
+  std::vector<Replacement> m_replacements{};
+  FunctionConstantFolding m_result;
+
+public:
+  ConstantFoldingImpl(Module const &module, size_t function_index)
+      : m_module(module), m_function(*module.m_functions[function_index]),
+        m_result{.m_function_index = function_index, .m_instr_num = m_function.get_instr().size()} {}
+
+  FunctionConstantFolding run(Cfg const &cfg, ExtendCfg const &extend_cfg) {
+    for (ExtendBasicBlock const &extend_block : extend_cfg.m_extend_blocks) {
+      m_locals.clear();
+      m_stack.clear();
+      if (extend_block.m_first == EnterBlockIndex) {
+        init_declared_locals();
+      }
+      fold_tree(cfg, extend_block);
+    }
+    return m_result;
+  }
+
+  /// replaces the recorded instructions, returns false when nothing is folded
+  bool rewrite() {
+    if (m_replacements.empty()) {
+      return false;
+    }
+    std::ranges::sort(m_replacements, {}, &Replacement::m_begin);
+    std::span<Instr const> const instr = m_function.get_instr();
+    std::vector<Instr> rewritten{};
+    rewritten.reserve(instr.size());
+    size_t position = 0U;
+    for (Replacement const &replacement : m_replacements) {
+      rewritten.insert(rewritten.end(), instr.begin() + position, instr.begin() + replacement.m_begin);
+      rewritten.push_back(create_constant_instr(replacement.m_constant));
+      position = replacement.m_end;
+    }
+    rewritten.insert(rewritten.end(), instr.begin() + position, instr.end());
+    m_function.set_instr(std::move(rewritten));
+    return true;
+  }
+
+private:
+  /// declared locals are zero when the function is entered
+  void init_declared_locals() {
+    uint32_t local_index = static_cast<uint32_t>(m_function.get_type()->get_arguments().size());
+    for (WasmType type : m_function.get_locals()) {
+      std::optional<Constant> zero{};
+      switch (type) {
+      case WasmType::I32:
+        zero = Constant::from_i32(0U);
+        break;
+      case WasmType::I64:
+        zero = Constant::from_i64(0U);
+        break;
+      case WasmType::F32:
+        zero = Constant::from_f32(0.0F);
+        break;
+      case WasmType::F64:
+        zero = Constant::from_f64(0.0);
+        break;
+      default:
+        break;
+      }
+      m_locals.insert_outermost(local_index++, zero);
+    }
+  }
+
+  /// depth first walk of the extended basic block tree like ValueNumbering, each tree edge opens a new scope
+  void fold_tree(Cfg const &cfg, ExtendBasicBlock const &extend_block) {
+    struct Frame {
+      BasicBlock const *m_block;
+      std::vector<size_t> m_children{};
+      size_t m_next_child = 0U;
+      std::vector<StackValue> m_stack{};
+    };
+    std::vector<Frame> frames{};
+    auto const enter = [&](size_t block_index) {
+      m_locals.push_scope();
+      BasicBlock const &block = cfg.m_blocks.at(block_index);
+      fold_block(block);
+      Frame frame{.m_block = &block};
+      for (size_t back : block.m_backs) {
+        if (back != extend_block.m_first && extend_block.m_blocks.contains(back)) {
+          frame.m_children.push_back(back);
+        }
+      }
+      // values flowing into the children are replaced in this block, children only see their constants
+      for (StackValue const &value : m_stack) {
+        consume(value);
+        frame.m_stack.push_back(StackValue{.m_constant = value.m_constant});
+      }
+      frames.push_back(std::move(frame));
+    };
+    enter(extend_block.m_first);
+    while (!frames.empty()) {
+      Frame &frame = frames.back();
+      if (frame.m_next_child == frame.m_children.size()) {
+        m_locals.pop_scope();
+        frames.pop_back();
+        continue;
+      }
+      size_t const child = frame.m_children[frame.m_next_child++];
+      if (frame.m_block->is_fall_through(child)) {
+        m_stack = frame.m_stack;
+      } else {
+        m_stack.clear();
+      }
+      enter(child);
+    }
+  }
+
+  StackValue pop() {
+    if (m_stack.empty()) {
+      // produced before this tree
+      return StackValue{};
+    }
+    StackValue value = m_stack.back();
+    m_stack.pop_back();
+    return value;
+  }
+
+  /// the value is used by an instruction which cannot be folded, so it is a maximal constant expression
+  void consume(StackValue const &value) {
+    if (!value.is_replaceable() || (value.m_size == 1U && !value.m_from_local)) {
+      return;
+    }
+    m_replacements.push_back(
+        Replacement{.m_begin = value.m_begin, .m_end = value.m_end, .m_constant = *value.m_constant});
+    if (value.m_from_local) {
+      m_result.m_propagated_num++;
+    } else {
+      m_result.m_folded_num++;
+      m_result.m_saved_instr_num += value.m_size - 1U;
+    }
+  }
+
+  void consume_operands(size_t operand_num) {
+    for (size_t i = 0; i < operand_num; i++) {
+      consume(pop());
+    }
+  }
+
+  void push_unknown(size_t result_num) {
+    for (size_t i = 0; i < result_num; i++) {
+      m_stack.push_back(StackValue{});
+    }
+  }
+
+  void call(FunctionType const &type) {
+    consume_operands(type.get_arguments().size());
+    push_unknown(type.get_results().size());
+  }
+
+  void fold(Instr const &instr, size_t position) {
+    size_t const operand_num = instr.get_operand_count();
+    if (instr.get_result_count() != 1U || operand_num == 0U || operand_num > m_stack.size()) {
+      consume_operands(operand_num);
+      push_unknown(instr.get_result_count());
+      return;
+    }
+    std::vector<StackValue> const operands{m_stack.end() - static_cast<std::ptrdiff_t>(operand_num), m_stack.end()};
+    std::vector<Constant> constants{};
+    constants.reserve(operand_num);
+    bool is_contiguous = true;
+    size_t size = 1U;
+    for (size_t i = 0; i < operand_num; i++) {
+      if (!operands[i].m_constant.has_value()) {
+        break;
+      }
+      constants.push_back(*operands[i].m_constant);
+      size_t const next_begin = i + 1U < operand_num ? operands[i + 1U].m_begin : position;
+      is_contiguous = is_contiguous && operands[i].is_replaceable() && operands[i].m_end == next_begin;
+      size += operands[i].m_size;
+    }
+    std::optional<Constant> const result =
+        constants.size() == operand_num ? evaluate(instr.get_code(), constants) : std::nullopt;
+    if (!result.has_value()) {
+      consume_operands(operand_num);
+      push_unknown(1U);
+      return;
+    }
+    size_t const begin = operands.front().m_begin;
+    m_stack.resize(m_stack.size() - operand_num);
+    if (is_contiguous) {
+      m_stack.push_back(StackValue{.m_constant = result, .m_begin = begin, .m_end = position + 1U, .m_size = size});
+    } else {
+      // the operands stay in the code, but the value is still known for later instructions
+      for (StackValue const &operand : operands) {
+        consume(operand);
+      }
+      m_stack.push_back(StackValue{.m_constant = result});
+    }
+  }
+
+  void fold_block(BasicBlock const &block) {
+    Instr const *const first_instr = m_function.get_instr().data();
+    for (Instr const *instr : block.m_instr) {
+      size_t const position = static_cast<size_t>(instr - first_instr);
+      InstrCode const code = instr->get_code();
+      switch (code) {
+      case InstrCode::NOP:
+      case InstrCode::BLOCK:
+      case InstrCode::LOOP:
+      case InstrCode::ELSE:
+      case InstrCode::END:
+        break;
+      case InstrCode::UNREACHABLE:
+      case InstrCode::RETURN:
+      case InstrCode::BR:
+        consume_operands(m_stack.size());
+        break;
+      case InstrCode::IF:
+      case InstrCode::BR_IF:
+      case InstrCode::BR_TABLE:
+      case InstrCode::DROP:
+      case InstrCode::GLOBAL_SET:
+        consume(pop());
+        break;
+      case InstrCode::I32_CONST:
+      case InstrCode::I64_CONST:
+      case InstrCode::F32_CONST:
+      case InstrCode::F64_CONST:
+        m_stack.push_back(
+            StackValue{.m_constant = get_constant(*instr), .m_begin = position, .m_end = position + 1U, .m_size = 1U});
+        break;
+      case InstrCode::LOCAL_GET: {
+        std::optional<Constant> const *local = m_locals.find(instr->get_index());
+        if (local != nullptr && local->has_value()) {
+          m_stack.push_back(StackValue{.m_constant = *local,
+                                       .m_begin = position,
+                                       .m_end = position + 1U,
+                                       .m_size = 1U,
+                                       .m_from_local = true});
+        } else {
+          push_unknown(1U);
+        }
+        break;
+      }
+      case InstrCode::LOCAL_SET:
+      case InstrCode::LOCAL_TEE: {
+        StackValue const value = pop();
+        consume(value);
+        m_locals.insert_or_assign(instr->get_index(), value.m_constant);
+        if (code == InstrCode::LOCAL_TEE) {
+          m_stack.push_back(StackValue{.m_constant = value.m_constant});
+        }
+        break;
+      }
+      case InstrCode::CALL:
+        call(*m_module.m_functions.at(instr->get_index())->get_type());
+        break;
+      case InstrCode::CALL_INDIRECT:
+        consume(pop());
+        call(*instr->get_function_type());
+        break;
+      default:
+        if (is_load(code) || is_store(code) || code == InstrCode::GLOBAL_GET || code == InstrCode::MEMORY_SIZE ||
+            code == InstrCode::MEMORY_GROW) {
+          consume_operands(instr->get_operand_count());
+          push_unknown(instr->get_result_count());
+        } else {
+          fold(*instr, position);
+        }
+        break;
+      }
+    }
+  }
+};
+
+} // namespace
+
+PreservedAnalyses ConstantFolding::run(Module &module, std::set<size_t> &changed_functions) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto extend_cfg_builder = get_context()->m_analysis_manager->get_analyzer<ExtendBasicBlockBuilder>();
+  extend_cfg_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  std::vector<ExtendCfg> const &extend_cfgs = extend_cfg_builder->get_extend_cfgs();
+  std::vector<char> changed(cfgs.size(), 0);
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    Cfg const &cfg = cfgs[cfg_index];
+    ConstantFoldingImpl impl{module, cfg.m_function_index};
+    m_functions[cfg_index] = impl.run(cfg, extend_cfgs.at(cfg_index));
+    // the cfg points into the instructions, so they are only rewritten after the walk
+    if (apply) {
+      changed[cfg_index] = impl.rewrite() ? 1 : 0;
+    }
+  });
+
+  for (size_t cfg_index = 0; cfg_index < cfgs.size(); cfg_index++) {
+    if (changed[cfg_index] != 0) {
+      changed_functions.insert(cfgs[cfg_index].m_function_index);
+    }
+  }
+  return changed_functions.empty() ? PreservedAnalyses::all() : PreservedAnalyses::none();
+}
+
+void ConstantFolding::dump_result() const {
+  FunctionConstantFolding total{.m_function_index = 0U, .m_instr_num = 0U};
+  for (FunctionConstantFolding const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] instr=" << result.m_instr_num
+              << " folded=" << result.m_folded_num << " saved=" << result.m_saved_instr_num
+              << " propagated=" << result.m_propagated_num << "\n";
+    total.m_instr_num += result.m_instr_num;
+    total.m_folded_num += result.m_folded_num;
+    total.m_saved_instr_num += result.m_saved_instr_num;
+    total.m_propagated_num += result.m_propagated_num;
+  }
+  std::cout << "total instr=" << total.m_instr_num << " folded=" << total.m_folded_num
+            << " saved=" << total.m_saved_instr_num << " propagated=" << total.m_propagated_num
+            << (apply ? " (applied)" : "") << "\n";
+}
+
+std::shared_ptr<ITransform> createConstantFoldingTransform(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<ConstantFolding>(new ConstantFolding(context));
+}
+
+} // namespace wa
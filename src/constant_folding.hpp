@@ -0,0 +1,36 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "module.hpp"
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct FunctionConstantFolding {
+  size_t m_function_index;
+  size_t m_instr_num;
+  size_t m_folded_num = 0U;      // maximal constant expressions replaced by one constant
+  size_t m_saved_instr_num = 0U; // instructions removed by that
+  size_t m_propagated_num = 0U;  // local.get replaced by the constant stored into the local
+};
+
+/// evaluates pure numeric instructions on constant operands and propagates constants through locals along the trees
+/// of extended basic blocks. declared locals start as zero in the entry block.
+/// the folded expressions are only reported unless --ConstantFolding.apply is given.
+class ConstantFolding : public ITransform {
+  std::vector<FunctionConstantFolding> m_functions{};
+
+public:
+  explicit ConstantFolding(std::shared_ptr<AnalyzerContext> const &context) : ITransform(context) {}
+
+  PreservedAnalyses run(Module &module, std::set<size_t> &changed_functions) override;
+
+  std::vector<FunctionConstantFolding> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+};
+
+} // namespace wa
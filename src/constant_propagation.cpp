@@ -0,0 +1,339 @@
+#include "constant_propagation.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "constant.hpp"
+#include "dataflow.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "ssa_builder.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+enum class Level : uint8_t {
+  Top,      // not known yet, optimistically any constant
+  Constant, // m_constant whenever it is computed
+  Bottom,   // not a constant
+};
+
+struct LatticeValue {
+  Level m_level = Level::Top;
+  Constant m_constant{.m_type = WasmType::I32, .m_bits = 0U};
+
+  bool operator==(LatticeValue const &o) const {
+    return m_level == o.m_level && (m_level != Level::Constant || m_constant == o.m_constant);
+  }
+
+  static LatticeValue bottom() { return LatticeValue{.m_level = Level::Bottom}; }
+  static LatticeValue constant(Constant const &constant) {
+    return LatticeValue{.m_level = Level::Constant, .m_constant = constant};
+  }
+
+  void meet(LatticeValue const &o) {
+    if (m_level == Level::Top || o.m_level == Level::Bottom) {
+      *this = o;
+    } else if (o.m_level == Level::Constant && !(m_constant == o.m_constant)) {
+      *this = bottom();
+    }
+  }
+};
+
+class ConstantPropagationImpl {
+  Cfg const &m_cfg;
+  SsaFunction const &m_ssa;
+  std::vector<LatticeValue> m_values{};
+  std::vector<bool> m_executable_blocks{};
+  std::vector<uint32_t> m_edge_begins{}; // incoming edges of position p are [m_edge_begins[p], m_edge_begins[p + 1])
+  std::vector<bool> m_executable_edges{};
+  std::vector<std::pair<SsaValueId, uint32_t>> m_condition_users{}; // sorted (condition, block position)
+  std::vector<std::pair<uint32_t, uint32_t>> m_flow_work_list{};    // (pred position, succ position)
+  std::vector<SsaValueId> m_ssa_work_list{};
+
+public:
+  ConstantPropagationImpl(Cfg const &cfg, SsaFunction const &ssa) : m_cfg(cfg), m_ssa(ssa) {}
+
+  FunctionConstantPropagation run() {
+    init();
+    solve();
+    return collect();
+  }
+
+private:
+  BasicBlock const &get_block(size_t position) const {
+    return m_cfg.m_blocks.at(m_ssa.m_order.get_block_index(position));
+  }
+
+  void init() {
+    BlockOrder const &order = m_ssa.m_order;
+    m_values.resize(m_ssa.m_values.size());
+    for (size_t value = 0; value < m_ssa.m_values.size(); value++) {
+      SsaValue const &ssa_value = m_ssa.m_values[value];
+      if (ssa_value.m_kind == SsaValueKind::Unknown) {
+        m_values[value] = LatticeValue::bottom();
+      } else if (ssa_value.m_kind == SsaValueKind::Constant) {
+        m_values[value] = LatticeValue::constant(ssa_value.m_constant);
+      }
+    }
+    m_executable_blocks.assign(order.size(), false);
+    m_edge_begins.assign(order.size() + 1U, 0U);
+    for (size_t position = 0; position < order.size(); position++) {
+      m_edge_begins[position + 1U] = m_edge_begins[position] + static_cast<uint32_t>(order.m_preds[position].size());
+    }
+    m_executable_edges.assign(m_edge_begins.back(), false);
+    for (size_t position = 0; position < m_ssa.m_blocks.size(); position++) {
+      if (m_ssa.m_blocks[position].m_condition != SsaBlock::no_condition) {
+        m_condition_users.emplace_back(m_ssa.m_blocks[position].m_condition, static_cast<uint32_t>(position));
+      }
+    }
+    std::ranges::sort(m_condition_users);
+  }
+
+  void solve() {
+    if (m_ssa.m_order.m_reachable_size == 0U) {
+      return;
+    }
+    visit_block(0U);
+    while (!m_flow_work_list.empty() || !m_ssa_work_list.empty()) {
+      while (!m_flow_work_list.empty()) {
+        auto const [pred, succ] = m_flow_work_list.back();
+        m_flow_work_list.pop_back();
+        std::vector<uint32_t> const &preds = m_ssa.m_order.m_preds[succ];
+        size_t const edge = m_edge_begins[succ] + static_cast<size_t>(std::ranges::find(preds, pred) - preds.begin());
+        if (m_executable_edges[edge]) {
+          continue;
+        }
+        m_executable_edges[edge] = true;
+        if (m_executable_blocks[succ]) {
+          // only the phis see the new edge
+          for (SsaValueId phi : m_ssa.m_blocks[succ].m_phis) {
+            evaluate_value(phi);
+          }
+        } else {
+          visit_block(succ);
+        }
+      }
+      while (!m_ssa_work_list.empty()) {
+        SsaValueId const value = m_ssa_work_list.back();
+        m_ssa_work_list.pop_back();
+        for (SsaValueId user : m_ssa.get_users(value)) {
+          if (m_executable_blocks[m_ssa.m_values[user].m_block]) {
+            evaluate_value(user);
+          }
+        }
+        auto const [begin, end] = std::ranges::equal_range(m_condition_users, value, {},
+                                                           &std::pair<SsaValueId, uint32_t>::first);
+        for (auto it = begin; it != end; ++it) {
+          if (m_executable_blocks[it->second]) {
+            evaluate_branch(it->second);
+          }
+        }
+      }
+    }
+  }
+
+  void visit_block(uint32_t position) {
+    m_executable_blocks[position] = true;
+    SsaBlock const &block = m_ssa.m_blocks[position];
+    for (SsaValueId phi : block.m_phis) {
+      evaluate_value(phi);
+    }
+    for (SsaValueId value : block.m_values) {
+      evaluate_value(value);
+    }
+    evaluate_branch(position);
+  }
+
+  void evaluate_branch(uint32_t position) {
+    SsaValueId const condition = m_ssa.m_blocks[position].m_condition;
+    BasicBlock const &block = get_block(position);
+    if (condition != SsaBlock::no_condition && block.m_true_target != BasicBlock::no_target &&
+        block.m_false_target != BasicBlock::no_target) {
+      LatticeValue const &value = m_values[condition];
+      if (value.m_level == Level::Top) {
+        return;
+      }
+      if (value.m_level == Level::Constant) {
+        size_t const target = value.m_constant.get_i32() != 0U ? block.m_true_target : block.m_false_target;
+        m_flow_work_list.emplace_back(position, static_cast<uint32_t>(m_ssa.m_order.get_position(target)));
+        return;
+      }
+    }
+    for (uint32_t succ : m_ssa.m_order.m_succs[position]) {
+      m_flow_work_list.emplace_back(position, succ);
+    }
+  }
+
+  void evaluate_value(SsaValueId value) {
+    LatticeValue const result = compute(value);
+    if (!(result == m_values[value])) {
+      m_values[value] = result;
+      m_ssa_work_list.push_back(value);
+    }
+  }
+
+  LatticeValue compute(SsaValueId value) const {
+    SsaValue const &ssa_value = m_ssa.m_values[value];
+    std::span<SsaValueId const> const operands = m_ssa.get_operands(value);
+    if (ssa_value.m_kind == SsaValueKind::Phi) {
+      LatticeValue result{};
+      for (size_t i = 0; i < operands.size(); i++) {
+        if (m_executable_edges[m_edge_begins[ssa_value.m_block] + i]) {
+          result.meet(m_values[operands[i]]);
+        }
+      }
+      return result;
+    }
+    if (ssa_value.m_kind != SsaValueKind::Instr) {
+      return m_values[value];
+    }
+    if (ssa_value.m_code == InstrCode::SELECT && m_values[operands[2]].m_level == Level::Constant) {
+      return m_values[operands[m_values[operands[2]].m_constant.get_i32() != 0U ? 0U : 1U]];
+    }
+    std::vector<Constant> constants{};
+    constants.reserve(operands.size());
+    bool has_top = false;
+    for (SsaValueId operand : operands) {
+      LatticeValue const &operand_value = m_values[operand];
+      if (operand_value.m_level == Level::Bottom) {
+        return LatticeValue::bottom();
+      }
+      has_top = has_top || operand_value.m_level == Level::Top;
+      constants.push_back(operand_value.m_constant);
+    }
+    if (has_top) {
+      return LatticeValue{};
+    }
+    std::optional<Constant> const result = evaluate(ssa_value.m_code, constants);
+    // a trapping instruction never produces its value, but the trap itself is not modeled
+    return result.has_value() ? LatticeValue::constant(result.value()) : LatticeValue::bottom();
+  }
+
+  FunctionConstantPropagation collect() const {
+    BlockOrder const &order = m_ssa.m_order;
+    FunctionConstantPropagation result{.m_function_index = m_ssa.m_function_index, .m_block_num = order.size()};
+    for (size_t position = 0; position < order.size(); position++) {
+      size_t const block_index = order.get_block_index(position);
+      BasicBlock const &block = get_block(position);
+      if (!m_executable_blocks[position]) {
+        if (block_index != ExitBlockIndex) {
+          result.m_unreachable_blocks.push_back(block_index);
+          result.m_unreachable_instr_num += block.m_instr.size();
+        }
+        continue;
+      }
+      SsaValueId const condition = m_ssa.m_blocks[position].m_condition;
+      if (condition != SsaBlock::no_condition && m_values[condition].m_level == Level::Constant &&
+          block.m_true_target != BasicBlock::no_target && block.m_false_target != BasicBlock::no_target &&
+          block.m_true_target != block.m_false_target) {
+        result.m_constant_branches.push_back(ConstantBranch{
+            .m_block = block_index,
+            .m_target = m_values[condition].m_constant.get_i32() != 0U ? block.m_true_target : block.m_false_target});
+      }
+    }
+    std::ranges::sort(result.m_unreachable_blocks);
+    std::ranges::sort(result.m_constant_branches, {}, &ConstantBranch::m_block);
+
+    // a local is constant when every executable read sees the same constant
+    std::map<uint32_t, LatticeValue> reads{};
+    for (SsaLocalAccess const &access : m_ssa.m_local_gets) {
+      if (!m_executable_blocks[access.m_block]) {
+        continue;
+      }
+      LatticeValue const &value = m_values[access.m_value];
+      if (value.m_level == Level::Constant) {
+        result.m_constant_read_num++;
+      }
+      auto [it, is_inserted] = reads.try_emplace(access.m_local, value);
+      if (!is_inserted) {
+        it->second.meet(value);
+      }
+    }
+    for (auto const &[local, value] : reads) {
+      if (value.m_level == Level::Constant) {
+        result.m_constant_locals.push_back(ConstantLocal{.m_local = local, .m_constant = value.m_constant});
+      }
+    }
+    return result;
+  }
+};
+
+} // namespace
+
+void ConstantPropagation::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto ssa_builder = get_context()->m_analysis_manager->get_analyzer<SsaBuilder>();
+  ssa_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    m_functions[cfg_index] = ConstantPropagationImpl{cfgs[cfg_index], ssa_builder->get_ssa(cfg_index)}.run();
+  });
+}
+
+void ConstantPropagation::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto ssa_builder = get_context()->m_analysis_manager->get_analyzer<SsaBuilder>();
+  ssa_builder->analyze(module);
+
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = ConstantPropagationImpl{cfg, ssa_builder->get_ssa(cfg_index)}.run();
+  });
+}
+
+void ConstantPropagation::dump_result() const {
+  size_t block_num = 0U;
+  size_t unreachable_block_num = 0U;
+  size_t unreachable_instr_num = 0U;
+  size_t constant_branch_num = 0U;
+  size_t constant_local_num = 0U;
+  size_t constant_read_num = 0U;
+  for (FunctionConstantPropagation const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] blocks=" << result.m_block_num
+              << " unreachable=" << result.m_unreachable_blocks.size() << " (" << result.m_unreachable_instr_num
+              << " instr) constant_branches=" << result.m_constant_branches.size()
+              << " constant_locals=" << result.m_constant_locals.size()
+              << " constant_reads=" << result.m_constant_read_num << "\n";
+    for (ConstantLocal const &local : result.m_constant_locals) {
+      std::cout << "  local[" << local.m_local << "] = " << local.m_constant << "\n";
+    }
+    for (ConstantBranch const &branch : result.m_constant_branches) {
+      std::cout << "  block[" << branch.m_block << "] always branches to block[" << branch.m_target << "]\n";
+    }
+    for (size_t block_index : result.m_unreachable_blocks) {
+      std::cout << "  block[" << block_index << "] is unreachable\n";
+    }
+    block_num += result.m_block_num;
+    unreachable_block_num += result.m_unreachable_blocks.size();
+    unreachable_instr_num += result.m_unreachable_instr_num;
+    constant_branch_num += result.m_constant_branches.size();
+    constant_local_num += result.m_constant_locals.size();
+    constant_read_num += result.m_constant_read_num;
+  }
+  std::cout << "total blocks=" << block_num << " unreachable=" << unreachable_block_num << " ("
+            << unreachable_instr_num << " instr) constant_branches=" << constant_branch_num
+            << " constant_locals=" << constant_local_num << " constant_reads=" << constant_read_num << "\n";
+}
+
+std::shared_ptr<IAnalyzer> createConstantPropagationAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<ConstantPropagation>(new ConstantPropagation(context));
+}
+
+} // namespace wa
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "constant.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct ConstantLocal {
+  uint32_t m_local;
+  Constant m_constant;
+};
+
+/// `if` / `br_if` at the end of m_block whose condition is constant, only the edge to m_target is taken
+struct ConstantBranch {
+  size_t m_block;
+  size_t m_target;
+};
+
+struct FunctionConstantPropagation {
+  size_t m_function_index;
+  size_t m_block_num = 0U;
+  size_t m_constant_read_num = 0U; // executable local.get which read a constant
+  std::vector<ConstantLocal> m_constant_locals{}; // locals which hold the same constant at every executable read
+  std::vector<ConstantBranch> m_constant_branches{};
+  std::vector<size_t> m_unreachable_blocks{}; // blocks which are never executed, the exit block is not included
+  size_t m_unreachable_instr_num = 0U;
+};
+
+/// sparse conditional constant propagation by Wegman and Zadeck over the ssa form of SsaBuilder.
+/// blocks are only evaluated once an edge into them is executable, and a branch with a constant condition only
+/// makes one of its edges executable. the work is proportional to the number of ssa edges and cfg edges.
+class ConstantPropagation : public IAnalyzer {
+  std::vector<FunctionConstantPropagation> m_functions{};
+
+public:
+  explicit ConstantPropagation(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<FunctionConstantPropagation> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
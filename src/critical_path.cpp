@@ -0,0 +1,494 @@
+#include "critical_path.hpp"
+#include "analyzer.hpp"
+#include "args.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <ranges>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+static const Arg<std::string> latency_file{"--CriticalPath.latency", ""}; // lines of `<opcode> <cycles>`
+static const Arg<size_t> statistic_num{"--CriticalPath.num", 32u};
+
+namespace {
+
+/// cycles until the result of an instruction is available.
+/// defaults are rough L1 hit latencies of a current x86-64 core, locals and constants live in registers.
+/// latency file lines are `<opcode as printed by --Printer> <cycles>`, `#` starts a comment.
+class LatencyTable {
+  std::vector<uint32_t> m_latencies = std::vector<uint32_t>(0x10000U, 1U); // indexed by InstrCode
+
+public:
+  static LatencyTable create() {
+    LatencyTable table{};
+    for (InstrCode code : get_codes()) {
+      table.m_latencies[static_cast<uint16_t>(code)] = get_default(code);
+    }
+    if (!latency_file.m_v.empty()) {
+      table.load(latency_file.m_v);
+    }
+    return table;
+  }
+
+  uint32_t get(InstrCode code) const { return m_latencies[static_cast<uint16_t>(code)]; }
+
+private:
+  static std::vector<InstrCode> get_codes() {
+    std::vector<InstrCode> codes{};
+    for (uint16_t prefix : {uint16_t{0U}, static_cast<uint16_t>(SATURATING_TRUNCATION_PREFIX << 8U)}) {
+      for (uint16_t i = 0; i < 0x100U; i++) {
+        InstrCode const code = static_cast<InstrCode>(prefix + i);
+        std::ostringstream ss{};
+        ss << code;
+        if (!ss.str().starts_with("Unknown instruction")) {
+          codes.push_back(code);
+        }
+      }
+    }
+    return codes;
+  }
+
+  static uint32_t get_default(InstrCode code) {
+    switch (code) {
+    case InstrCode::UNREACHABLE:
+    case InstrCode::NOP:
+    case InstrCode::BLOCK:
+    case InstrCode::LOOP:
+    case InstrCode::ELSE:
+    case InstrCode::END:
+    case InstrCode::DROP:
+    case InstrCode::LOCAL_GET:
+    case InstrCode::LOCAL_SET:
+    case InstrCode::LOCAL_TEE:
+    case InstrCode::I32_CONST:
+    case InstrCode::I64_CONST:
+    case InstrCode::F32_CONST:
+    case InstrCode::F64_CONST:
+      return 0U;
+    case InstrCode::I32_MUL:
+    case InstrCode::I64_MUL:
+      return 3U;
+    case InstrCode::I32_DIV_S:
+    case InstrCode::I32_DIV_U:
+    case InstrCode::I32_REM_S:
+    case InstrCode::I32_REM_U:
+      return 26U;
+    case InstrCode::I64_DIV_S:
+    case InstrCode::I64_DIV_U:
+    case InstrCode::I64_REM_S:
+    case InstrCode::I64_REM_U:
+      return 42U;
+    case InstrCode::F32_ADD:
+    case InstrCode::F32_SUB:
+    case InstrCode::F32_MUL:
+    case InstrCode::F32_MIN:
+    case InstrCode::F32_MAX:
+    case InstrCode::F64_ADD:
+    case InstrCode::F64_SUB:
+    case InstrCode::F64_MUL:
+    case InstrCode::F64_MIN:
+    case InstrCode::F64_MAX:
+      return 4U;
+    case InstrCode::F32_CEIL:
+    case InstrCode::F32_FLOOR:
+    case InstrCode::F32_TRUNC:
+    case InstrCode::F32_NEAREST:
+    case InstrCode::F64_CEIL:
+    case InstrCode::F64_FLOOR:
+    case InstrCode::F64_TRUNC:
+    case InstrCode::F64_NEAREST:
+      return 8U;
+    case InstrCode::F32_DIV:
+      return 11U;
+    case InstrCode::F64_DIV:
+      return 14U;
+    case InstrCode::F32_SQRT:
+      return 12U;
+    case InstrCode::F64_SQRT:
+      return 18U;
+    case InstrCode::GLOBAL_GET:
+      return 4U;
+    case InstrCode::CALL:
+    case InstrCode::CALL_INDIRECT:
+      return 5U;
+    case InstrCode::MEMORY_GROW:
+      return 100U;
+    case InstrCode::I32_WRAP_I64:
+    case InstrCode::I64_EXTEND_S_I32:
+    case InstrCode::I64_EXTEND_U_I32:
+      return 1U;
+    default:
+      if (is_load(code)) {
+        return 4U;
+      }
+      bool const is_float_conversion =
+          (code >= InstrCode::I32_TRUNC_S_F32 && code <= InstrCode::F64_PROMOTE_F32) ||
+          (code >= InstrCode::I32_TRUNC_SAT_F32_S && code <= InstrCode::I64_TRUNC_SAT_F64_U);
+      return is_float_conversion ? 4U : 1U;
+    }
+  }
+
+  void load(std::string const &path) {
+    std::ifstream file{path};
+    if (!file.is_open()) {
+      throw std::runtime_error("cannot open latency table " + path);
+    }
+    std::map<std::string, InstrCode, std::less<>> names{};
+    for (InstrCode code : get_codes()) {
+      std::ostringstream ss{};
+      ss << code;
+      names.emplace(ss.str(), code);
+    }
+    std::string line{};
+    for (size_t line_number = 1U; std::getline(file, line); line_number++) {
+      std::istringstream ss{line.substr(0U, line.find('#'))};
+      std::string name{};
+      uint32_t latency = 0U;
+      if (!(ss >> name)) {
+        continue;
+      }
+      auto it = names.find(name);
+      if (it == names.end()) {
+        throw std::runtime_error(path + ":" + std::to_string(line_number) + ": unknown opcode " + name);
+      }
+      if (!(ss >> latency)) {
+        throw std::runtime_error(path + ":" + std::to_string(line_number) + ": invalid latency");
+      }
+      m_latencies[static_cast<uint16_t>(it->second)] = latency;
+    }
+  }
+};
+
+/// finish time of a value in the block as written and with balanced expression trees
+struct Time {
+  uint64_t m_plain = 0U;
+  uint64_t m_balanced = 0U;
+
+  Time operator+(uint64_t latency) const {
+    return Time{.m_plain = m_plain + latency, .m_balanced = m_balanced + latency};
+  }
+  static Time max(Time const &a, Time const &b) {
+    return Time{.m_plain = std::max(a.m_plain, b.m_plain), .m_balanced = std::max(a.m_balanced, b.m_balanced)};
+  }
+};
+
+struct StackValue {
+  Time m_ready{};
+  // reassociable operator chain computing the value. its balanced finish time is the combination of the ready
+  // times of the chain operands in m_leaves, computed when the value leaves the chain.
+  InstrCode m_chain_code{};
+  std::vector<uint64_t> m_leaves{};
+};
+
+/// schedules every instruction as soon as its dependences allow:
+///   - operands on the stack, values entering the block are ready at 0
+///   - local.get after the last local.set / local.tee of the local in the block. locals are renamed by any
+///     compiler, so writes never wait for earlier reads or writes.
+///   - linear memory and globals are one memory without alias analysis: reads wait for the last write, writes wait
+///     for the start of earlier reads and writes, calls read and write it.
+/// the critical path is the latest finish time of an instruction.
+class BlockScheduler {
+  enum class Access { None, Read, Write, ReadWrite };
+
+  Module const &m_module;
+  LatencyTable const &m_latencies;
+  BlockLatency *m_result = nullptr;
+  std::vector<StackValue> m_stack{};
+  std::unordered_map<uint32_t, Time> m_local_writes{}; // finish time of the last write
+  Time m_last_write_finish{};
+  Time m_last_access_start{};
+  std::vector<uint64_t> m_heap{}; // scratch of balance
+
+public:
+  BlockScheduler(Module const &module, LatencyTable const &latencies) : m_module(module), m_latencies(latencies) {}
+
+  void run(BasicBlock const &block, BlockLatency &result) {
+    m_result = &result;
+    m_stack.clear();
+    m_local_writes.clear();
+    m_last_write_finish = Time{};
+    m_last_access_start = Time{};
+    for (Instr const *instr : block.m_instr) {
+      step(*instr);
+    }
+    consume(m_stack.size());
+  }
+
+private:
+  void record(Time const &finish) {
+    m_result->m_critical_path = std::max(m_result->m_critical_path, finish.m_plain);
+    m_result->m_balanced_critical_path = std::max(m_result->m_balanced_critical_path, finish.m_balanced);
+  }
+
+  StackValue pop() {
+    if (m_stack.empty()) {
+      return StackValue{};
+    }
+    StackValue value = std::move(m_stack.back());
+    m_stack.pop_back();
+    return value;
+  }
+
+  /// combine the two earliest ready operands until one is left, which gives the minimal finish time of the chain
+  uint64_t balance(std::vector<uint64_t> const &leaves, uint64_t latency) {
+    m_heap.assign(leaves.begin(), leaves.end());
+    std::ranges::make_heap(m_heap, std::greater<>{});
+    while (m_heap.size() > 1U) {
+      std::ranges::pop_heap(m_heap, std::greater<>{});
+      uint64_t const first = m_heap.back();
+      m_heap.pop_back();
+      std::ranges::pop_heap(m_heap, std::greater<>{});
+      m_heap.back() = std::max(first, m_heap.back()) + latency;
+      std::ranges::push_heap(m_heap, std::greater<>{});
+    }
+    return m_heap.front();
+  }
+
+  Time finalize(StackValue const &value) {
+    if (value.m_leaves.empty()) {
+      return value.m_ready;
+    }
+    Time const ready{.m_plain = value.m_ready.m_plain,
+                     .m_balanced = balance(value.m_leaves, m_latencies.get(value.m_chain_code))};
+    record(ready);
+    return ready;
+  }
+
+  Time consume(size_t operand_num) {
+    Time ready{};
+    for (size_t i = 0; i < operand_num; i++) {
+      ready = Time::max(ready, finalize(pop()));
+    }
+    return ready;
+  }
+
+  Time execute(InstrCode code, Time start, Access access) {
+    if (access == Access::Read || access == Access::ReadWrite) {
+      start = Time::max(start, m_last_write_finish);
+    }
+    if (access == Access::Write || access == Access::ReadWrite) {
+      start = Time::max(start, m_last_access_start);
+    }
+    uint64_t const latency = m_latencies.get(code);
+    Time const finish = start + latency;
+    if (access != Access::None) {
+      m_last_access_start = Time::max(m_last_access_start, start);
+    }
+    if (access == Access::Write || access == Access::ReadWrite) {
+      m_last_write_finish = Time::max(m_last_write_finish, finish);
+    }
+    m_result->m_work += latency;
+    record(finish);
+    return finish;
+  }
+
+  void compute(Instr const &instr, size_t operand_num, size_t result_num, Access access) {
+    Time const finish = execute(instr.get_code(), consume(operand_num), access);
+    for (size_t i = 0; i < result_num; i++) {
+      m_stack.push_back(StackValue{.m_ready = finish});
+    }
+  }
+
+  bool extends(StackValue const &chain, StackValue const &operand) const {
+    return !operand.m_leaves.empty() && operand.m_chain_code == chain.m_chain_code;
+  }
+
+  void add_operand(StackValue &chain, StackValue &operand) {
+    if (!extends(chain, operand)) {
+      chain.m_leaves.push_back(finalize(operand).m_balanced);
+    } else if (chain.m_leaves.empty()) {
+      chain.m_leaves = std::move(operand.m_leaves);
+    } else {
+      chain.m_leaves.insert(chain.m_leaves.end(), operand.m_leaves.begin(), operand.m_leaves.end());
+    }
+  }
+
+  void step(Instr const &instr) {
+    InstrCode const code = instr.get_code();
+    switch (code) {
+    case InstrCode::NOP:
+    case InstrCode::BLOCK:
+    case InstrCode::LOOP:
+    case InstrCode::ELSE:
+    case InstrCode::END:
+      break;
+    case InstrCode::UNREACHABLE:
+    case InstrCode::RETURN:
+    case InstrCode::BR:
+      execute(code, consume(m_stack.size()), Access::None);
+      break;
+    case InstrCode::IF:
+    case InstrCode::BR_IF:
+    case InstrCode::BR_TABLE:
+    case InstrCode::DROP:
+      compute(instr, 1U, 0U, Access::None);
+      break;
+    case InstrCode::LOCAL_GET: {
+      auto it = m_local_writes.find(instr.get_index());
+      m_stack.push_back(StackValue{.m_ready = execute(code, it == m_local_writes.end() ? Time{} : it->second,
+                                                      Access::None)});
+      break;
+    }
+    case InstrCode::LOCAL_SET:
+      m_local_writes.insert_or_assign(instr.get_index(), execute(code, consume(1U), Access::None));
+      break;
+    case InstrCode::LOCAL_TEE: {
+      Time const finish = execute(code, consume(1U), Access::None);
+      m_local_writes.insert_or_assign(instr.get_index(), finish);
+      m_stack.push_back(StackValue{.m_ready = finish});
+      break;
+    }
+    case InstrCode::GLOBAL_GET:
+    case InstrCode::MEMORY_SIZE:
+      compute(instr, 0U, 1U, Access::Read);
+      break;
+    case InstrCode::GLOBAL_SET:
+      compute(instr, 1U, 0U, Access::Write);
+      break;
+    case InstrCode::MEMORY_GROW:
+      compute(instr, 1U, 1U, Access::ReadWrite);
+      break;
+    case InstrCode::CALL: {
+      FunctionType const &type = *m_module.m_functions.at(instr.get_index())->get_type();
+      compute(instr, type.get_arguments().size(), type.get_results().size(), Access::ReadWrite);
+      break;
+    }
+    case InstrCode::CALL_INDIRECT: {
+      FunctionType const &type = *instr.get_function_type();
+      compute(instr, type.get_arguments().size() + 1U, type.get_results().size(), Access::ReadWrite);
+      break;
+    }
+    default:
+      if (is_load(code)) {
+        compute(instr, 1U, 1U, Access::Read);
+      } else if (is_store(code)) {
+        compute(instr, 2U, 0U, Access::Write);
+      } else if (is_commutative(code) && is_associative(code, false)) {
+        StackValue r = pop();
+        StackValue l = pop();
+        uint64_t const latency = m_latencies.get(code);
+        StackValue chain{.m_ready = Time{.m_plain = std::max(l.m_ready.m_plain, r.m_ready.m_plain) + latency},
+                         .m_chain_code = code};
+        // leaves are unordered, take over the longer chain to keep long chains linear
+        if (extends(chain, r) && (!extends(chain, l) || r.m_leaves.size() > l.m_leaves.size())) {
+          std::swap(l, r);
+        }
+        add_operand(chain, l);
+        add_operand(chain, r);
+        m_result->m_work += latency;
+        m_result->m_critical_path = std::max(m_result->m_critical_path, chain.m_ready.m_plain);
+        m_stack.push_back(std::move(chain));
+      } else {
+        compute(instr, instr.get_operand_count(), instr.get_result_count(), Access::None);
+      }
+      break;
+    }
+  }
+};
+
+} // namespace
+
+static FunctionLatency analyze_function(Module const &module, LatencyTable const &latencies, Cfg const &cfg) {
+  FunctionLatency result{.m_function_index = cfg.m_function_index};
+  BlockScheduler scheduler{module, latencies};
+  for (auto const &[block_index, block] : cfg.m_blocks) {
+    BlockLatency block_result{.m_block_index = block_index, .m_instr_num = block.m_instr.size()};
+    scheduler.run(block, block_result);
+    result.m_work += block_result.m_work;
+    result.m_critical_path += block_result.m_critical_path;
+    result.m_balanced_critical_path += block_result.m_balanced_critical_path;
+    result.m_blocks.push_back(block_result);
+  }
+  return result;
+}
+
+void CriticalPath::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  LatencyTable const latencies = LatencyTable::create();
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    m_functions[cfg_index] = analyze_function(module, latencies, cfgs[cfg_index]);
+  });
+}
+
+void CriticalPath::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  LatencyTable const latencies = LatencyTable::create();
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = analyze_function(module, latencies, cfg);
+  });
+}
+
+void CriticalPath::dump_result() const {
+  struct RankedBlock {
+    size_t m_function_index;
+    BlockLatency const *m_block;
+  };
+  std::vector<RankedBlock> blocks{};
+  for (FunctionLatency const &function : m_functions) {
+    for (BlockLatency const &block : function.m_blocks) {
+      blocks.push_back(RankedBlock{.m_function_index = function.m_function_index, .m_block = &block});
+    }
+  }
+  // longest chains first, the less parallel one on ties
+  std::ranges::stable_sort(blocks, [](RankedBlock const &l, RankedBlock const &r) {
+    if (l.m_block->m_critical_path != r.m_block->m_critical_path) {
+      return l.m_block->m_critical_path > r.m_block->m_critical_path;
+    }
+    return l.m_block->get_ilp() < r.m_block->get_ilp();
+  });
+  std::cout << "blocks:\n";
+  for (RankedBlock const &ranked : blocks | std::views::take(statistic_num)) {
+    BlockLatency const &block = *ranked.m_block;
+    std::cout << "  function[" << ranked.m_function_index << "] BB[" << block.m_block_index
+              << "] critical_path=" << block.m_critical_path << " balanced=" << block.m_balanced_critical_path
+              << " work=" << block.m_work << " ilp=" << block.get_ilp() << " instr=" << block.m_instr_num << "\n";
+  }
+
+  std::vector<FunctionLatency const *> functions{};
+  for (FunctionLatency const &function : m_functions) {
+    functions.push_back(&function);
+  }
+  std::ranges::stable_sort(functions, [](FunctionLatency const *l, FunctionLatency const *r) {
+    return l->m_critical_path > r->m_critical_path;
+  });
+  std::cout << "functions:\n";
+  for (FunctionLatency const *function : functions | std::views::take(statistic_num)) {
+    double const ilp = function->m_critical_path == 0U ? 1.0
+                                                        : static_cast<double>(function->m_work) /
+                                                              static_cast<double>(function->m_critical_path);
+    std::cout << "  function[" << function->m_function_index << "] critical_path=" << function->m_critical_path
+              << " balanced=" << function->m_balanced_critical_path << " work=" << function->m_work
+              << " ilp=" << ilp << "\n";
+  }
+}
+
+std::shared_ptr<IAnalyzer> createCriticalPathAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<CriticalPath>(new CriticalPath(context));
+}
+
+} // namespace wa
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+/// latency bound of a block, in cycles of the latency table
+struct BlockLatency {
+  size_t m_block_index;
+  size_t m_instr_num;
+  uint64_t m_work = 0U;                   // sum of the latencies of all instructions
+  uint64_t m_critical_path = 0U;          // longest path through the dependence DAG
+  uint64_t m_balanced_critical_path = 0U; // same after balancing the reassociable expression trees
+
+  /// average number of instructions in flight when the block runs as fast as its dependences allow
+  double get_ilp() const {
+    return m_critical_path == 0U ? 1.0 : static_cast<double>(m_work) / static_cast<double>(m_critical_path);
+  }
+};
+
+struct FunctionLatency {
+  size_t m_function_index;
+  uint64_t m_work = 0U;                   // sums over the blocks, each block executed once
+  uint64_t m_critical_path = 0U;
+  uint64_t m_balanced_critical_path = 0U;
+  std::vector<BlockLatency> m_blocks{};
+};
+
+/// critical path and instruction level parallelism of each basic block.
+/// the dependence DAG is built from the operand stack, reads of locals after writes in the block and the order of
+/// memory, global and call instructions.
+class CriticalPath : public IAnalyzer {
+  std::vector<FunctionLatency> m_functions{};
+
+public:
+  explicit CriticalPath(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<FunctionLatency> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
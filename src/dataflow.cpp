@@ -0,0 +1,72 @@
+#include "dataflow.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+BlockOrder BlockOrder::create(Cfg const &cfg) {
+  BlockOrder order{};
+  if (cfg.m_blocks.empty()) {
+    return order;
+  }
+  size_t const max_block_index = std::ranges::max(cfg.m_blocks | std::views::keys);
+  order.m_positions.assign(max_block_index + 1U, invalid_position);
+
+  // iterative post order dfs
+  std::vector<size_t> post_order{};
+  post_order.reserve(cfg.m_blocks.size());
+  DynBitSet visited{max_block_index + 1U};
+  auto const dfs = [&](size_t start) {
+    using Frame = std::pair<size_t, std::set<size_t>::const_iterator>;
+    std::vector<Frame> stack{};
+    visited.mask(start);
+    stack.emplace_back(start, cfg.m_blocks.at(start).m_backs.begin());
+    while (!stack.empty()) {
+      auto &[block_index, it] = stack.back();
+      if (it == cfg.m_blocks.at(block_index).m_backs.end()) {
+        post_order.push_back(block_index);
+        stack.pop_back();
+        continue;
+      }
+      size_t const next = *it;
+      ++it;
+      if (!visited.test(next)) {
+        visited.mask(next);
+        stack.emplace_back(next, cfg.m_blocks.at(next).m_backs.begin());
+      }
+    }
+  };
+  if (cfg.m_blocks.contains(EnterBlockIndex)) {
+    dfs(EnterBlockIndex);
+  }
+  order.m_blocks.assign(post_order.rbegin(), post_order.rend());
+  order.m_reachable_size = order.m_blocks.size();
+  for (size_t block_index : cfg.m_blocks | std::views::keys) {
+    if (!visited.test(block_index)) {
+      order.m_blocks.push_back(block_index);
+    }
+  }
+
+  for (size_t position = 0; position < order.m_blocks.size(); position++) {
+    order.m_positions[order.m_blocks[position]] = position;
+  }
+  order.m_preds.resize(order.m_blocks.size());
+  order.m_succs.resize(order.m_blocks.size());
+  for (size_t position = 0; position < order.m_blocks.size(); position++) {
+    for (size_t back : cfg.m_blocks.at(order.m_blocks[position]).m_backs) {
+      size_t const back_position = order.m_positions[back];
+      order.m_succs[position].push_back(static_cast<uint32_t>(back_position));
+      order.m_preds[back_position].push_back(static_cast<uint32_t>(position));
+    }
+  }
+  return order;
+}
+
+} // namespace wa
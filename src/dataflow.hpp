@@ -0,0 +1,139 @@
+#pragma once
+
+#include "adt/dyn_bit_set.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "thread_pool.hpp"
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+enum class DataflowDirection { Forward, Backward };
+
+/// dense numbering of the blocks of one cfg in reverse post order starting from EnterBlockIndex.
+/// blocks which are not reachable from the entry are appended in block index order.
+struct BlockOrder {
+  static constexpr size_t invalid_position = std::numeric_limits<size_t>::max();
+
+  size_t m_reachable_size = 0U;      // positions before it are reachable from the entry
+  std::vector<size_t> m_blocks{};    // position -> block index
+  std::vector<size_t> m_positions{}; // block index -> position
+  std::vector<std::vector<uint32_t>> m_preds{};
+  std::vector<std::vector<uint32_t>> m_succs{};
+
+  static BlockOrder create(Cfg const &cfg);
+
+  size_t size() const { return m_blocks.size(); }
+  size_t get_position(size_t block_index) const { return m_positions.at(block_index); }
+  size_t get_block_index(size_t position) const { return m_blocks[position]; }
+  bool is_reachable(size_t position) const { return position < m_reachable_size; }
+};
+
+/// a dataflow problem over one function.
+/// - Lattice: value attached to the entry and the exit of each block
+/// - direction: Forward meets over predecessors, Backward meets over successors
+/// - get_boundary: value flowing into blocks without predecessors (successors for Backward)
+/// - get_top: identity of meet, used as the initial value
+/// - meet: merge `from` into `to`
+/// - transfer: update `output` from `input`, return whether `output` changed
+template <class P>
+concept DataflowProblem = requires(P &problem, typename P::Lattice &to, typename P::Lattice const &from,
+                                   size_t block_index, BasicBlock const &block) {
+  typename P::Lattice;
+  { P::direction } -> std::convertible_to<DataflowDirection>;
+  { problem.get_boundary() } -> std::convertible_to<typename P::Lattice>;
+  { problem.get_top() } -> std::convertible_to<typename P::Lattice>;
+  problem.meet(to, from);
+  { problem.transfer(block_index, block, from, to) } -> std::same_as<bool>;
+};
+
+template <class L> struct DataflowResult {
+  BlockOrder m_order{};
+  std::vector<L> m_in{};  // value at block entry, indexed by position
+  std::vector<L> m_out{}; // value at block exit, indexed by position
+
+  L const &get_in(size_t block_index) const { return m_in[m_order.get_position(block_index)]; }
+  L const &get_out(size_t block_index) const { return m_out[m_order.get_position(block_index)]; }
+};
+
+/// worklist solver, the block with the smallest reverse post order position (largest for Backward) is processed
+/// first so most problems converge in one or two sweeps.
+template <DataflowProblem P> DataflowResult<typename P::Lattice> solve_dataflow(Cfg const &cfg, P &problem) {
+  using L = typename P::Lattice;
+  constexpr bool is_forward = P::direction == DataflowDirection::Forward;
+
+  DataflowResult<L> result{.m_order = BlockOrder::create(cfg)};
+  BlockOrder const &order = result.m_order;
+  size_t const size = order.size();
+  result.m_in.assign(size, problem.get_top());
+  result.m_out.assign(size, problem.get_top());
+  std::vector<L> &inputs = is_forward ? result.m_in : result.m_out;
+  std::vector<L> &outputs = is_forward ? result.m_out : result.m_in;
+  std::vector<std::vector<uint32_t>> const &sources = is_forward ? order.m_preds : order.m_succs;
+  std::vector<std::vector<uint32_t>> const &targets = is_forward ? order.m_succs : order.m_preds;
+
+  auto const get_priority = [size](size_t position) -> size_t { return is_forward ? position : size - 1U - position; };
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> work_list{};
+  DynBitSet in_work_list{size};
+  for (size_t position = 0; position < size; position++) {
+    work_list.push(get_priority(position));
+    in_work_list.mask(position);
+  }
+
+  while (!work_list.empty()) {
+    size_t const priority = work_list.top();
+    work_list.pop();
+    size_t const position = is_forward ? priority : size - 1U - priority;
+    in_work_list.unmask(position);
+
+    L &input = inputs[position];
+    input = problem.get_top();
+    bool has_source = false;
+    for (uint32_t source : sources[position]) {
+      // facts of unreachable code must not flow into reachable code
+      if (is_forward && order.is_reachable(position) && !order.is_reachable(source)) {
+        continue;
+      }
+      problem.meet(input, outputs[source]);
+      has_source = true;
+    }
+    if (!has_source) {
+      input = problem.get_boundary();
+    }
+    size_t const block_index = order.get_block_index(position);
+    if (!problem.transfer(block_index, cfg.m_blocks.at(block_index), input, outputs[position])) {
+      continue;
+    }
+    for (uint32_t target : targets[position]) {
+      if (!in_work_list.test(target)) {
+        in_work_list.mask(target);
+        work_list.push(get_priority(target));
+      }
+    }
+  }
+  return result;
+}
+
+/// solve one problem per function, functions are distributed over the thread pool.
+/// `create_problem(cfg_index)` is called on the worker thread which solves that function.
+template <class Fn>
+auto solve_dataflow_parallel(std::vector<Cfg> const &cfgs, Fn const &create_problem)
+    -> std::vector<DataflowResult<typename std::invoke_result_t<Fn, size_t>::Lattice>> {
+  using P = std::invoke_result_t<Fn, size_t>;
+  std::vector<DataflowResult<typename P::Lattice>> results(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    P problem = create_problem(cfg_index);
+    results[cfg_index] = solve_dataflow(cfgs[cfg_index], problem);
+  });
+  return results;
+}
+
+} // namespace wa
@@ -0,0 +1,333 @@
+#include "dead_code.hpp"
+#include "adt/dyn_bit_set.hpp"
+#include "analyzer.hpp"
+#include "args.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "dataflow.hpp"
+#include "instruction.hpp"
+#include "liveness.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include "writer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <vector>
+
+namespace wa {
+
+static const Arg<bool> strip{"--DeadCode.strip", false}; // remove the dead code instead of only reporting
+
+namespace {
+
+constexpr size_t npos = static_cast<size_t>(-1);
+
+enum class Action : uint8_t {
+  Keep,
+  Remove,
+  ToDrop, // local.set of a dead local whose value is still needed for its side effects
+};
+
+struct StackValue {
+  size_t m_begin = npos; // npos when the value is not computed by contiguous pure instructions of this block
+  size_t m_end = npos;
+};
+
+class DeadCodeImpl {
+  Module const &m_module;
+  Function &m_function;
+  std::vector<Action> m_actions;
+  std::vector<StackValue> m_stack{};
+  FunctionDeadCode m_result;
+
+public:
+  DeadCodeImpl(Module const &module, size_t function_index)
+      : m_module(module), m_function(*module.m_functions[function_index]),
+        m_actions(m_function.get_instr().size(), Action::Keep), m_result{.m_function_index = function_index} {}
+
+  FunctionDeadCode run(Cfg const &cfg, FunctionLiveness const &liveness, Writer const &writer) {
+    BlockOrder const &order = liveness.m_live.m_order;
+    for (size_t position = order.m_reachable_size; position < order.size(); position++) {
+      size_t const block_index = order.get_block_index(position);
+      if (block_index != ExitBlockIndex) {
+        m_result.m_unreachable_block_num++;
+        m_result.m_unreachable_instr_num += cfg.m_blocks.at(block_index).m_instr.size();
+      }
+    }
+    mark_dead_tails();
+    for (size_t position = 0; position < order.m_reachable_size; position++) {
+      size_t const block_index = order.get_block_index(position);
+      mark_dead_values(cfg.m_blocks.at(block_index), liveness.m_live.get_out(block_index));
+    }
+
+    std::span<Instr const> const instr = m_function.get_instr();
+    for (size_t i = 0; i < instr.size(); i++) {
+      if (m_actions[i] == Action::Remove) {
+        m_result.m_removable_instr_num++;
+        m_result.m_removable_byte_num += writer.get_instr_size(instr[i]);
+      } else if (m_actions[i] == Action::ToDrop) {
+        m_result.m_removable_byte_num += writer.get_instr_size(instr[i]) - 1U;
+      }
+    }
+    return m_result;
+  }
+
+  /// applies the actions, returns false when nothing is removed
+  bool rewrite() {
+    if (m_result.m_removable_byte_num == 0U) {
+      return false;
+    }
+    std::span<Instr const> const instr = m_function.get_instr();
+    std::vector<Instr> rewritten{};
+    rewritten.reserve(instr.size() - m_result.m_removable_instr_num);
+    for (size_t i = 0; i < instr.size(); i++) {
+      if (m_actions[i] == Action::Remove) {
+        continue;
+      }
+      rewritten.push_back(m_actions[i] == Action::ToDrop ? Instr{InstrCode::DROP} : instr[i]);
+    }
+    m_function.set_instr(std::move(rewritten));
+    return true;
+  }
+
+private:
+  /// the operand stack is polymorphic after an unconditional branch, so everything up to the end or else of the
+  /// enclosing block can be removed, including nested blocks. code after the end of a block which is never reached
+  /// is unreachable as well, but it must still produce the results of its own enclosing block and is kept.
+  void mark_dead_tails() {
+    std::span<Instr const> const instr = m_function.get_instr();
+    size_t depth = 0U;
+    std::optional<size_t> dead_depth{};
+    for (size_t i = 0; i < instr.size(); i++) {
+      InstrCode const code = instr[i].get_code();
+      if (dead_depth.has_value()) {
+        if ((code == InstrCode::END || code == InstrCode::ELSE) && depth == dead_depth.value()) {
+          dead_depth.reset();
+        } else {
+          m_actions[i] = Action::Remove;
+        }
+      }
+      switch (code) {
+      case InstrCode::BLOCK:
+      case InstrCode::LOOP:
+      case InstrCode::IF:
+        depth++;
+        break;
+      case InstrCode::END:
+        depth--;
+        break;
+      case InstrCode::UNREACHABLE:
+      case InstrCode::BR:
+      case InstrCode::BR_TABLE:
+      case InstrCode::RETURN:
+        if (!dead_depth.has_value()) {
+          dead_depth = depth;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  StackValue pop() {
+    if (m_stack.empty()) {
+      // produced in another block
+      return StackValue{};
+    }
+    StackValue const value = m_stack.back();
+    m_stack.pop_back();
+    return value;
+  }
+
+  /// `value` is removable together with the instruction at `position` which consumes it
+  static bool is_removable(StackValue const &value, size_t position) {
+    return value.m_begin != npos && value.m_end == position;
+  }
+
+  void remove(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      m_actions[i] = Action::Remove;
+    }
+  }
+
+  void push_opaque(size_t result_num) {
+    for (size_t i = 0; i < result_num; i++) {
+      m_stack.push_back(StackValue{});
+    }
+  }
+
+  void mark_dead_values(BasicBlock const &block, DynBitSet const &live_out) {
+    Instr const *const first_instr = m_function.get_instr().data();
+    // stores into locals which are overwritten or never read before the end of the function
+    std::vector<bool> is_dead_store(block.m_instr.size(), false);
+    DynBitSet live = live_out;
+    for (size_t k = block.m_instr.size(); k > 0; k--) {
+      Instr const &instr = *block.m_instr[k - 1U];
+      switch (instr.get_code()) {
+      case InstrCode::LOCAL_GET:
+        live.mask(instr.get_index());
+        break;
+      case InstrCode::LOCAL_SET:
+      case InstrCode::LOCAL_TEE:
+        is_dead_store[k - 1U] = !live.test(instr.get_index());
+        live.unmask(instr.get_index());
+        break;
+      default:
+        break;
+      }
+    }
+
+    m_stack.clear();
+    for (size_t k = 0; k < block.m_instr.size(); k++) {
+      Instr const &instr = *block.m_instr[k];
+      size_t const position = static_cast<size_t>(block.m_instr[k] - first_instr);
+      InstrCode const code = instr.get_code();
+      switch (code) {
+      case InstrCode::DROP: {
+        StackValue const value = pop();
+        if (is_removable(value, position)) {
+          m_result.m_dead_value_num++;
+          remove(value.m_begin, position + 1U);
+        }
+        break;
+      }
+      case InstrCode::LOCAL_SET: {
+        StackValue const value = pop();
+        if (!is_dead_store[k]) {
+          break;
+        }
+        m_result.m_dead_store_num++;
+        if (is_removable(value, position)) {
+          m_result.m_dead_value_num++;
+          remove(value.m_begin, position + 1U);
+        } else {
+          m_actions[position] = Action::ToDrop;
+        }
+        break;
+      }
+      case InstrCode::LOCAL_TEE: {
+        StackValue value = pop();
+        if (!is_dead_store[k]) {
+          push_opaque(1U);
+          break;
+        }
+        // the value passes through unchanged
+        m_result.m_dead_store_num++;
+        m_actions[position] = Action::Remove;
+        if (is_removable(value, position)) {
+          value.m_end = position + 1U;
+        }
+        m_stack.push_back(value);
+        break;
+      }
+      case InstrCode::NOP:
+        break;
+      case InstrCode::UNREACHABLE:
+      case InstrCode::RETURN:
+      case InstrCode::BR:
+      case InstrCode::BR_TABLE:
+        m_stack.clear();
+        break;
+      case InstrCode::IF:
+      case InstrCode::BR_IF:
+        pop();
+        break;
+      case InstrCode::CALL: {
+        FunctionType const &type = *m_module.m_functions.at(instr.get_index())->get_type();
+        for (size_t i = 0; i < type.get_arguments().size(); i++) {
+          pop();
+        }
+        push_opaque(type.get_results().size());
+        break;
+      }
+      case InstrCode::CALL_INDIRECT: {
+        FunctionType const &type = *instr.get_function_type();
+        for (size_t i = 0; i <= type.get_arguments().size(); i++) {
+          pop();
+        }
+        push_opaque(type.get_results().size());
+        break;
+      }
+      default: {
+        size_t const operand_num = instr.get_operand_count();
+        bool is_contiguous = true;
+        size_t begin = position;
+        for (size_t i = 0; i < operand_num; i++) {
+          StackValue const operand = pop();
+          is_contiguous = is_contiguous && is_removable(operand, begin);
+          begin = operand.m_begin;
+        }
+        if (is_pure(code) && is_contiguous && instr.get_result_count() == 1U) {
+          m_stack.push_back(StackValue{.m_begin = begin, .m_end = position + 1U});
+        } else {
+          push_opaque(instr.get_result_count());
+        }
+        break;
+      }
+      }
+    }
+  }
+};
+
+} // namespace
+
+PreservedAnalyses DeadCode::run(Module &module, std::set<size_t> &changed_functions) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto liveness = get_context()->m_analysis_manager->get_analyzer<Liveness>();
+  liveness->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  Writer const writer{module};
+  std::vector<char> changed(cfgs.size(), 0);
+  m_functions.clear();
+  m_functions.resize(cfgs.size(), FunctionDeadCode{.m_function_index = 0U});
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    Cfg const &cfg = cfgs[cfg_index];
+    DeadCodeImpl impl{module, cfg.m_function_index};
+    m_functions[cfg_index] = impl.run(cfg, liveness->get_results().at(cfg_index), writer);
+    // the cfg points into the instructions, so they are only rewritten after the walk
+    if (strip) {
+      changed[cfg_index] = impl.rewrite() ? 1 : 0;
+    }
+  });
+
+  for (size_t cfg_index = 0; cfg_index < cfgs.size(); cfg_index++) {
+    if (changed[cfg_index] != 0) {
+      changed_functions.insert(cfgs[cfg_index].m_function_index);
+    }
+  }
+  return changed_functions.empty() ? PreservedAnalyses::all() : PreservedAnalyses::none();
+}
+
+void DeadCode::dump_result() const {
+  FunctionDeadCode total{.m_function_index = 0U};
+  for (FunctionDeadCode const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] unreachable: blocks=" << result.m_unreachable_block_num
+              << " instr=" << result.m_unreachable_instr_num << " dead: values=" << result.m_dead_value_num
+              << " stores=" << result.m_dead_store_num << " removable: instr=" << result.m_removable_instr_num
+              << " bytes=" << result.m_removable_byte_num << "\n";
+    total.m_unreachable_block_num += result.m_unreachable_block_num;
+    total.m_unreachable_instr_num += result.m_unreachable_instr_num;
+    total.m_dead_value_num += result.m_dead_value_num;
+    total.m_dead_store_num += result.m_dead_store_num;
+    total.m_removable_instr_num += result.m_removable_instr_num;
+    total.m_removable_byte_num += result.m_removable_byte_num;
+  }
+  std::cout << "total unreachable: blocks=" << total.m_unreachable_block_num
+            << " instr=" << total.m_unreachable_instr_num << " dead: values=" << total.m_dead_value_num
+            << " stores=" << total.m_dead_store_num << " removable: instr=" << total.m_removable_instr_num
+            << " bytes=" << total.m_removable_byte_num << (strip ? " (stripped)" : "") << "\n";
+}
+
+std::shared_ptr<ITransform> createDeadCodeTransform(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<DeadCode>(new DeadCode(context));
+}
+
+} // namespace wa
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "module.hpp"
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct FunctionDeadCode {
+  size_t m_function_index;
+  size_t m_unreachable_block_num = 0U; // blocks not reachable from the entry, the exit block is not included
+  size_t m_unreachable_instr_num = 0U;
+  size_t m_dead_value_num = 0U; // pure values which are dropped or stored into a dead local
+  size_t m_dead_store_num = 0U; // local.set / local.tee of a local which is not live afterwards
+  size_t m_removable_instr_num = 0U;
+  size_t m_removable_byte_num = 0U;
+};
+
+/// finds code which never executes or whose result is never used.
+/// - instructions after br, br_table, return and unreachable up to the end of the enclosing block
+/// - pure values which are dropped or stored into a local that is not live afterwards
+/// - stores into locals which are not live afterwards
+/// the removable bytes are only reported unless --DeadCode.strip is given, which removes the dead code before the
+/// analyzers run.
+class DeadCode : public ITransform {
+  std::vector<FunctionDeadCode> m_functions{};
+
+public:
+  explicit DeadCode(std::shared_ptr<AnalyzerContext> const &context) : ITransform(context) {}
+
+  PreservedAnalyses run(Module &module, std::set<size_t> &changed_functions) override;
+
+  std::vector<FunctionDeadCode> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+};
+
+} // namespace wa
@@ -3,62 +3,70 @@
 #include "analyzer.hpp"
 #include "basic_block_builder.hpp"
 #include "cfg.hpp"
+#include "dataflow.hpp"
 #include "debug.hpp"
 #include <algorithm>
 #include <cstddef>
 #include <iostream>
-#include <map>
 #include <ranges>
 #include <set>
+#include <vector>
 
 namespace wa {
 
-static auto get_dom(Cfg const &cfg) -> std::map<size_t, DynBitSet> {
-  // prepare
-  std::map<size_t, DynBitSet> dom_bit_maps{};
-  size_t const bit_size = std::ranges::max(cfg.m_blocks | std::views::keys) + 1U;
-  for (auto const &[index, block] : cfg.m_blocks) {
-    if (index == EnterBlockIndex) {
-      dom_bit_maps[index] = DynBitSet{bit_size};
-    } else {
-      dom_bit_maps[index] = ~DynBitSet{bit_size};
-    }
-  }
-  std::map<size_t, std::set<size_t>> const &pred_map = cfg.get_pred_map();
+namespace {
 
-  // iterator until no change
-  bool is_changed = true;
-  while (is_changed) {
-    is_changed = false;
-    for (auto const &[index, block] : cfg.m_blocks) {
-      std::set<size_t> const &pred_set = pred_map.at(index);
-      DynBitSet tmp = pred_set.empty() ? DynBitSet{bit_size} : ~DynBitSet{bit_size};
-      for (size_t pred : pred_set) {
-        tmp &= dom_bit_maps[pred];
-      }
-      tmp.mask(index);
-      if (tmp != dom_bit_maps[index]) {
-        is_changed = true;
-        dom_bit_maps[index] = tmp;
-      }
-    }
+class DomProblem {
+  size_t m_bit_size;
+  DynBitSet m_tmp;
+
+public:
+  using Lattice = DynBitSet;
+  static constexpr DataflowDirection direction = DataflowDirection::Forward;
+
+  explicit DomProblem(Cfg const &cfg)
+      : m_bit_size(std::ranges::max(cfg.m_blocks | std::views::keys) + 1U), m_tmp(m_bit_size) {}
+
+  DynBitSet get_boundary() const { return DynBitSet{m_bit_size}; }
+  DynBitSet get_top() const { return DynBitSet{m_bit_size, true}; }
+  void meet(DynBitSet &to, DynBitSet const &from) const { to &= from; }
+  bool transfer(size_t block_index, BasicBlock const &, DynBitSet const &input, DynBitSet &output) {
+    // dom sets only shrink from the initial full set, so in-place and-assign is enough to detect changes.
+    m_tmp = input;
+    m_tmp.mask(block_index);
+    return output.and_assign_changed(m_tmp);
   }
+};
+
+} // namespace
+
+void DomBuilder::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_dom_bit_sets = solve_dataflow_parallel(cfgs, [&cfgs](size_t cfg_index) { return DomProblem{cfgs[cfg_index]}; });
 
   if (Debug::is_debug_mode()) {
-    for (auto const &[index, dom_bit_set] : dom_bit_maps) {
-      std::cout << "dom of block[" << index << "]: " << dom_bit_set << "\n";
+    for (DataflowResult<DynBitSet> const &result : m_dom_bit_sets) {
+      for (size_t block_index = 0; block_index < result.m_order.m_positions.size(); block_index++) {
+        if (result.m_order.m_positions[block_index] == BlockOrder::invalid_position) {
+          continue;
+        }
+        std::cout << "dom of block[" << block_index << "]: " << result.get_out(block_index) << "\n";
+      }
     }
   }
-  return dom_bit_maps;
 }
 
-void DomBuilder::analyze_impl(Module &module) {
+void DomBuilder::update_impl(Module &module, std::set<size_t> const &function_indexes) {
   auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
   cfg_builder->analyze(module);
 
-  for (Cfg const &cfg : cfg_builder->get_cfgs()) {
-    m_dom_bit_set = get_dom(cfg);
-  }
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    DomProblem problem{cfg};
+    m_dom_bit_sets[cfg_index] = solve_dataflow(cfg, problem);
+  });
 }
 
 std::shared_ptr<IAnalyzer> createDomBuilderAnalyzer(std::shared_ptr<AnalyzerContext> context) {
@@ -2,18 +2,31 @@
 
 #include "adt/dyn_bit_set.hpp"
 #include "analyzer.hpp"
+#include "dataflow.hpp"
+#include <cstddef>
 #include <memory>
+#include <set>
+#include <vector>
 
 namespace wa {
 
 class DomBuilder : public IAnalyzer {
-  std::map<size_t, DynBitSet> m_dom_bit_set;
+  std::vector<DataflowResult<DynBitSet>> m_dom_bit_sets{};
 
 public:
   explicit DomBuilder(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
 
+  /// blocks which dominate `block_index`, indexed by block index
+  DynBitSet const &get_dom(size_t cfg_index, size_t block_index) const {
+    return m_dom_bit_sets.at(cfg_index).get_out(block_index);
+  }
+  bool is_dominate(size_t cfg_index, size_t dominator, size_t block_index) const {
+    return get_dom(cfg_index, block_index).test(dominator);
+  }
+
 private:
   void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
 };
 
 } // namespace wa
@@ -6,7 +6,9 @@
 #include <cassert>
 #include <cstddef>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 namespace wa {
@@ -50,30 +52,45 @@ static ExtendBasicBlock create_extend_basic_bloc(size_t index, std::map<size_t,
   return extend_block;
 }
 
+static ExtendCfg create_extend_cfg(Cfg const &cfg) {
+  if (Debug::is_debug_mode()) {
+    std::cout << "============= ExtendBasicBlock start =============\n";
+  }
+  ExtendCfg extend_cfg{};
+  std::map<size_t, size_t> const front_block_num_map = get_front_block_num_map(cfg);
+  for (auto const &[index, _] : cfg.m_blocks) {
+    if (!is_first_block(index, front_block_num_map)) {
+      continue;
+    }
+    // only the first basic block can have multiple predecessor basic blocks;
+    extend_cfg.m_extend_blocks.push_back(create_extend_basic_bloc(index, cfg.m_blocks, front_block_num_map));
+    if (Debug::is_debug_mode()) {
+      extend_cfg.m_extend_blocks.back().dump();
+    }
+  }
+  if (Debug::is_debug_mode()) {
+    std::cout << "============= ExtendBasicBlock end =============\n";
+  }
+  return extend_cfg;
+}
+
 void ExtendBasicBlockBuilder::analyze_impl(Module &module) {
   std::shared_ptr<BasicBlockBuilder> cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
   cfg_builder->analyze(module);
 
+  m_extend_cfgs.clear();
   for (Cfg const &cfg : cfg_builder->get_cfgs()) {
-    if (Debug::is_debug_mode()) {
-      std::cout << "============= ExtendBasicBlock start =============\n";
-    }
-    m_extend_cfgs.push_back(ExtendCfg{});
-    std::vector<ExtendBasicBlock> &current_extend_blocks = m_extend_cfgs.back().m_extend_blocks;
-    std::map<size_t, size_t> const front_block_num_map = get_front_block_num_map(cfg);
-    for (auto const &[index, _] : cfg.m_blocks) {
-      if (!is_first_block(index, front_block_num_map)) {
-        continue;
-      }
-      // only the first basic block can have multiple predecessor basic blocks;
-      current_extend_blocks.push_back(create_extend_basic_bloc(index, cfg.m_blocks, front_block_num_map));
-      if (Debug::is_debug_mode()) {
-        current_extend_blocks.back().dump();
-      }
-    }
-    if (Debug::is_debug_mode()) {
-      std::cout << "============= ExtendBasicBlock end =============\n";
-    }
+    m_extend_cfgs.push_back(create_extend_cfg(cfg));
+  }
+}
+
+void ExtendBasicBlockBuilder::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  std::shared_ptr<BasicBlockBuilder> cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  for (size_t const function_index : function_indexes) {
+    size_t const cfg_index = cfg_builder->get_cfg_index(function_index);
+    m_extend_cfgs.at(cfg_index) = create_extend_cfg(cfg_builder->get_cfgs()[cfg_index]);
   }
 }
 
@@ -4,6 +4,7 @@
 #include "cfg.hpp"
 #include <cstddef>
 #include <memory>
+#include <set>
 #include <vector>
 
 namespace wa {
@@ -13,7 +14,10 @@ class ExtendBasicBlockBuilder : public IAnalyzer {
 
 public:
   explicit ExtendBasicBlockBuilder(std::shared_ptr<AnalyzerContext> context) : IAnalyzer(context) {}
+  /// aligned with BasicBlockBuilder::get_cfgs
+  std::vector<ExtendCfg> const &get_extend_cfgs() const { return m_extend_cfgs; }
   void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
 };
 
 } // namespace wa
@@ -1,67 +1,970 @@
 #include "high_frequency_sub_expr.hpp"
-#include "adt/range.hpp"
 #include "adt/string.hpp"
+#include "adt/suffix_array.hpp"
 #include "analyzer.hpp"
 #include "args.hpp"
 #include "basic_block_builder.hpp"
 #include "cfg.hpp"
 #include "module.hpp"
+#include "pattern_file.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <queue>
+#include <ranges>
+#include <span>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace wa {
 
 static const Arg<size_t> depth{"--HighFrequencySubExpr.depth", 16u};
 static const Arg<size_t> statistic_num{"--HighFrequencySubExpr.num", 128u};
+static const Arg<std::string> mode{"--HighFrequencySubExpr.mode", "trie"}; // trie | sketch | suffix_array
+static const Arg<size_t> min_length{"--HighFrequencySubExpr.min_length", 2u};
+static const Arg<double> epsilon{"--HighFrequencySubExpr.epsilon", 1e-4};
+static const Arg<double> delta{"--HighFrequencySubExpr.delta", 1e-3};
+static const Arg<size_t> capacity{"--HighFrequencySubExpr.capacity", 4096u};
+static const Arg<std::string> output{"--HighFrequencySubExpr.output", ""}; // pattern file, trie mode only
+static const Arg<std::string> weight{"--HighFrequencySubExpr.weight", "none"}; // none | loop | profile
+static const Arg<size_t> loop_base{"--HighFrequencySubExpr.loop_base", 10u};
+static const Arg<std::string> profile{"--HighFrequencySubExpr.profile", ""};
+static const Arg<size_t> select_num{"--HighFrequencySubExpr.select", 0u}; // superinstructions, trie mode only
+
+static const Arg<std::string> const_mode{"--HighFrequencySubExpr.const", "none"};   // none | exact | bucket
+static const Arg<std::string> local_mode{"--HighFrequencySubExpr.local", "none"};   // none | exact | relative
+static const Arg<std::string> memarg_mode{"--HighFrequencySubExpr.memarg", "none"}; // none | exact | class
+static const Arg<std::string> index_mode{"--HighFrequencySubExpr.index", "none"};   // none | exact
+
+namespace {
+
+struct ImmediateModes {
+  ImmediateClass m_const;
+  ImmediateClass m_local;
+  ImmediateClass m_memarg;
+  ImmediateClass m_index;
+
+  static ImmediateModes create() {
+    return ImmediateModes{
+        .m_const = parse(const_mode, "--HighFrequencySubExpr.const",
+                         {{"none", ImmediateClass::None},
+                          {"exact", ImmediateClass::Exact},
+                          {"bucket", ImmediateClass::Small}}),
+        .m_local = parse(local_mode, "--HighFrequencySubExpr.local",
+                         {{"none", ImmediateClass::None},
+                          {"exact", ImmediateClass::Exact},
+                          {"relative", ImmediateClass::Relative}}),
+        .m_memarg = parse(memarg_mode, "--HighFrequencySubExpr.memarg",
+                          {{"none", ImmediateClass::None},
+                           {"exact", ImmediateClass::Exact},
+                           {"class", ImmediateClass::MemArgClass}}),
+        .m_index = parse(index_mode, "--HighFrequencySubExpr.index",
+                         {{"none", ImmediateClass::None}, {"exact", ImmediateClass::Exact}}),
+    };
+  }
+
+private:
+  static ImmediateClass parse(std::string const &value, std::string_view name,
+                              std::initializer_list<std::pair<std::string_view, ImmediateClass>> choices) {
+    for (auto const &[choice, immediate_class] : choices) {
+      if (choice == value) {
+        return immediate_class;
+      }
+    }
+    throw std::runtime_error(std::string{name} + ": unknown mode " + value);
+  }
+};
+
+struct Cursor {
+  PatternTrie::NodeIndex m_node;  // trie mode
+  uint64_t m_hash;                // sketch mode, rolling hash of the keys
+  std::vector<uint32_t> m_locals; // locals of the pattern in order of first use, only for relative local numbering
+};
+
+} // namespace
+
+/// estimated execution count of every block, each occurrence of a pattern in the block is counted that many times.
+///   none: 1
+///   loop: loop_base ^ loop depth
+///   profile: count of the block in the profile, or count of the function * loop_base ^ loop depth.
+///            functions missing in the profile are never executed.
+/// profile file lines are `<function index> <count>` or `<function index> <block index> <count>`, `#` starts a
+/// comment. block indices are the ones printed by --BasicBlockBuilder --debug.
+class BlockWeights {
+  static constexpr uint64_t max_weight = uint64_t{1} << 40U;
+
+  BlockWeightKind m_kind = BlockWeightKind::None;
+  std::map<size_t, uint64_t> m_function_counts{};
+  std::map<std::pair<size_t, size_t>, uint64_t> m_block_counts{};
+
+public:
+  static BlockWeightKind get_kind() {
+    if (weight.m_v == "none") {
+      return BlockWeightKind::None;
+    }
+    if (weight.m_v == "loop") {
+      return BlockWeightKind::Loop;
+    }
+    if (weight.m_v == "profile") {
+      return BlockWeightKind::Profile;
+    }
+    throw std::runtime_error("--HighFrequencySubExpr.weight: unknown mode " + weight.m_v);
+  }
+
+  static BlockWeights create() {
+    BlockWeights weights{};
+    weights.m_kind = get_kind();
+    if (weights.m_kind == BlockWeightKind::Profile) {
+      weights.load_profile(profile.m_v);
+    }
+    return weights;
+  }
+
+  uint64_t get(Cfg const &cfg, size_t block_index, BasicBlock const &block) const {
+    switch (m_kind) {
+    case BlockWeightKind::None:
+      return 1U;
+    case BlockWeightKind::Loop:
+      return get_loop_weight(block.m_loop_depth);
+    case BlockWeightKind::Profile:
+      break;
+    }
+    if (auto it = m_block_counts.find({cfg.m_function_index, block_index}); it != m_block_counts.end()) {
+      return it->second;
+    }
+    if (auto it = m_function_counts.find(cfg.m_function_index); it != m_function_counts.end()) {
+      return std::min(max_weight, it->second * get_loop_weight(block.m_loop_depth));
+    }
+    return 0U;
+  }
+
+private:
+  static uint64_t get_loop_weight(size_t loop_depth) {
+    uint64_t result = 1U;
+    for (size_t i = 0; i < loop_depth && result < max_weight; i++) {
+      result *= loop_base;
+    }
+    return std::min(result, max_weight);
+  }
+
+  void load_profile(std::string const &path) {
+    std::ifstream file{path};
+    if (!file.is_open()) {
+      throw std::runtime_error("cannot open profile " + path);
+    }
+    std::string line{};
+    for (size_t line_number = 1U; std::getline(file, line); line_number++) {
+      line = line.substr(0U, line.find('#'));
+      std::istringstream ss{line};
+      std::vector<uint64_t> numbers{};
+      for (uint64_t number = 0U; ss >> number;) {
+        numbers.push_back(number);
+      }
+      if (!ss.eof()) {
+        throw std::runtime_error(path + ":" + std::to_string(line_number) + ": invalid number");
+      }
+      if (numbers.size() == 2U) {
+        m_function_counts.insert_or_assign(numbers[0], std::min(max_weight, numbers[1]));
+      } else if (numbers.size() == 3U) {
+        m_block_counts.insert_or_assign({numbers[0], numbers[1]}, std::min(max_weight, numbers[2]));
+      } else if (!numbers.empty()) {
+        throw std::runtime_error(path + ":" + std::to_string(line_number) + ": expect 2 or 3 numbers");
+      }
+    }
+  }
+};
+
+static bool is_one_byte_leb(int64_t value) { return value >= -64 && value < 64; }
+
+static PatternKey get_const_key(Instr const &instr, ImmediateClass mode) {
+  PatternKey key{.m_code = instr.get_code()};
+  if (mode == ImmediateClass::None) {
+    return key;
+  }
+  uint64_t bits = 0U;
+  bool is_small = false;
+  switch (key.m_code) {
+  case InstrCode::I32_CONST:
+    bits = static_cast<uint64_t>(static_cast<int64_t>(instr.get_value<int32_t>()));
+    is_small = is_one_byte_leb(instr.get_value<int32_t>());
+    break;
+  case InstrCode::I64_CONST:
+    bits = static_cast<uint64_t>(instr.get_value<int64_t>());
+    is_small = is_one_byte_leb(instr.get_value<int64_t>());
+    break;
+  case InstrCode::F32_CONST:
+    bits = std::bit_cast<uint32_t>(instr.get_value<float>());
+    is_small = bits == 0U;
+    break;
+  default:
+    bits = std::bit_cast<uint64_t>(instr.get_value<double>());
+    is_small = bits == 0U;
+    break;
+  }
+  if (mode == ImmediateClass::Exact) {
+    key.m_class = ImmediateClass::Exact;
+    key.m_value = bits;
+  } else {
+    key.m_class = is_small ? ImmediateClass::Small : ImmediateClass::Large;
+  }
+  return key;
+}
+
+static PatternKey get_mem_arg_key(Instr const &instr, ImmediateClass mode) {
+  PatternKey key{.m_code = instr.get_code(), .m_class = mode};
+  MemArg const &mem_arg = instr.get_mem_arg();
+  if (mode == ImmediateClass::Exact) {
+    key.m_value = static_cast<uint64_t>(mem_arg.m_offset) << 32U | mem_arg.m_align;
+  } else if (mode == ImmediateClass::MemArgClass) {
+    uint64_t const offset_class = mem_arg.m_offset == 0U ? 0U : (mem_arg.m_offset < 128U ? 1U : 2U);
+    key.m_value = (mem_arg.m_align == get_natural_alignment(key.m_code) ? 1U : 0U) | offset_class << 1U;
+  }
+  return key;
+}
+
+/// key of `instr` as seen from a pattern which starts at `cursor`.
+/// the key only depends on the cursor with relative local numbering.
+static PatternKey get_key(Instr const &instr, ImmediateModes const &modes, Cursor &cursor) {
+  InstrCode const code = instr.get_code();
+  switch (code) {
+  case InstrCode::I32_CONST:
+  case InstrCode::I64_CONST:
+  case InstrCode::F32_CONST:
+  case InstrCode::F64_CONST:
+    return get_const_key(instr, modes.m_const);
+  case InstrCode::LOCAL_GET:
+  case InstrCode::LOCAL_SET:
+  case InstrCode::LOCAL_TEE: {
+    if (modes.m_local != ImmediateClass::Relative) {
+      return PatternKey{.m_code = code,
+                        .m_class = modes.m_local,
+                        .m_value = modes.m_local == ImmediateClass::Exact ? instr.get_index() : 0U};
+    }
+    auto it = std::ranges::find(cursor.m_locals, instr.get_index());
+    if (it == cursor.m_locals.end()) {
+      it = cursor.m_locals.insert(it, instr.get_index());
+    }
+    return PatternKey{.m_code = code,
+                      .m_class = ImmediateClass::Relative,
+                      .m_value = static_cast<uint64_t>(it - cursor.m_locals.begin())};
+  }
+  case InstrCode::GLOBAL_GET:
+  case InstrCode::GLOBAL_SET:
+  case InstrCode::CALL:
+  case InstrCode::BR:
+  case InstrCode::BR_IF:
+    return PatternKey{.m_code = code,
+                      .m_class = modes.m_index,
+                      .m_value = modes.m_index == ImmediateClass::Exact ? instr.get_index() : 0U};
+  default:
+    if (is_load(code) || is_store(code)) {
+      return get_mem_arg_key(instr, modes.m_memarg);
+    }
+    return PatternKey{.m_code = code};
+  }
+}
+
+/// visit every n-gram (n <= depth) of the block as `fn(cursor, last_key, instrs of the n-gram)`.
+/// cursors[i] is the state of the n-gram which starts i instructions after the oldest tracked one and ends at
+/// the previous instruction. each new instruction extends every cursor by one step and starts a new one.
+template <class Fn>
+static void for_each_ngram(BasicBlock const &block, ImmediateModes const &modes, std::vector<Cursor> &cursors,
+                           Fn const &fn) {
+  size_t active_num = 0U;
+  for (size_t position = 0; position < block.m_instr.size(); position++) {
+    Instr const &instr = *block.m_instr[position];
+    if (active_num == depth) {
+      // recycle the oldest cursor to keep the buffers of m_locals
+      std::ranges::rotate(cursors, cursors.begin() + 1);
+      active_num--;
+    }
+    cursors[active_num].m_node = PatternTrie::root;
+    cursors[active_num].m_hash = 0U;
+    cursors[active_num].m_locals.clear();
+    active_num++;
+    for (size_t i = 0; i < active_num; i++) {
+      size_t const length = active_num - i;
+      fn(cursors[i], get_key(instr, modes, cursors[i]),
+         std::span<Instr const *const>{block.m_instr.data() + position + 1U - length, length});
+    }
+  }
+}
+
+static void count_block(PatternTrie &trie, BasicBlock const &block, uint64_t block_weight,
+                        ImmediateModes const &modes, std::vector<Cursor> &cursors) {
+  auto const fn = [&trie, block_weight](Cursor &cursor, PatternKey const &key, std::span<Instr const *const>) {
+    cursor.m_node = trie.get_or_insert_child(cursor.m_node, key);
+    std::optional<size_t> &count = trie.value(cursor.m_node);
+    count = count.value_or(0U) + block_weight;
+  };
+  for_each_ngram(block, modes, cursors, fn);
+}
+
+static void sketch_block(PatternSketch &sketch, BasicBlock const &block, uint64_t block_weight,
+                         ImmediateModes const &modes, std::vector<Cursor> &cursors) {
+  auto const fn = [&](Cursor &cursor, PatternKey const &key, std::span<Instr const *const> instrs) {
+    uint64_t x = cursor.m_hash + PatternKeyHash{}(key) + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    cursor.m_hash = x ^ (x >> 31U);
+    uint64_t const estimate = sketch.m_frequency.add(cursor.m_hash, block_weight);
+    // an untracked pattern whose upper bound cannot beat the smallest tracked count would be evicted again at once.
+    // skipping it keeps the Space-Saving bounds, since its real count stays below the smallest tracked count.
+    if (!sketch.m_heavy_hitters.contains(cursor.m_hash) && estimate <= sketch.m_heavy_hitters.get_min_count()) {
+      return;
+    }
+    sketch.m_heavy_hitters.add(cursor.m_hash, block_weight, [&]() {
+      std::vector<PatternKey> path{};
+      Cursor local_cursor{};
+      for (Instr const *instr : instrs) {
+        path.push_back(get_key(*instr, modes, local_cursor));
+      }
+      return path;
+    });
+  };
+  for_each_ngram(block, modes, cursors, fn);
+}
+
+std::ostream &operator<<(std::ostream &os, PatternKey const &key) {
+  os << key.m_code;
+  switch (key.m_class) {
+  case ImmediateClass::None:
+    return os;
+  case ImmediateClass::Exact:
+    switch (key.m_code) {
+    case InstrCode::I32_CONST:
+    case InstrCode::I64_CONST:
+      return os << " " << static_cast<int64_t>(key.m_value);
+    case InstrCode::F32_CONST:
+      return os << " " << std::bit_cast<float>(static_cast<uint32_t>(key.m_value));
+    case InstrCode::F64_CONST:
+      return os << " " << std::bit_cast<double>(key.m_value);
+    default:
+      if (is_load(key.m_code) || is_store(key.m_code)) {
+        return os << " offset=" << (key.m_value >> 32U) << " align=" << (key.m_value & 0xFFFFFFFFU);
+      }
+      return os << " " << key.m_value;
+    }
+  case ImmediateClass::Relative:
+    return os << " $" << key.m_value;
+  case ImmediateClass::Small:
+    return os << " small";
+  case ImmediateClass::Large:
+    return os << " large";
+  case ImmediateClass::MemArgClass: {
+    constexpr std::array<char const *, 3U> offset_classes{"0", "small", "large"};
+    return os << ((key.m_value & 1U) != 0U ? " natural" : " unaligned")
+              << " offset=" << offset_classes[key.m_value >> 1U];
+  }
+  }
+  return os;
+}
+
+/// split functions into at most `part_num` contiguous ranges with similar instruction numbers.
+static std::vector<size_t> partition_cfgs(std::vector<Cfg> const &cfgs, size_t part_num) {
+  size_t total = 0U;
+  for (Cfg const &cfg : cfgs) {
+    for (auto const &[_, block] : cfg.m_blocks) {
+      total += block.m_instr.size();
+    }
+  }
+  std::vector<size_t> bounds{0U};
+  size_t accumulated = 0U;
+  for (size_t cfg_index = 0; cfg_index < cfgs.size(); cfg_index++) {
+    for (auto const &[_, block] : cfgs[cfg_index].m_blocks) {
+      accumulated += block.m_instr.size();
+    }
+    if (accumulated * part_num >= total * bounds.size() && bounds.size() < part_num) {
+      bounds.push_back(cfg_index + 1U);
+    }
+  }
+  if (bounds.back() != cfgs.size()) {
+    bounds.push_back(cfgs.size());
+  }
+  return bounds;
+}
 
 void HighFrequencySubExpr::analyze_impl(Module &module) {
   auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
   cfg_builder->analyze(module);
+  m_total_instr_num = 0U;
+  m_trie = PatternTrie{};
+  m_sketch = PatternSketch{};
+  m_repeats.clear();
+  m_superinstructions.clear();
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  BlockWeights const weights = mode.m_v == "suffix_array" ? BlockWeights{} : BlockWeights::create();
+  for (Cfg const &cfg : cfgs) {
+    for (auto const &[block_index, block] : cfg.m_blocks) {
+      m_total_instr_num += block.m_instr.size() * weights.get(cfg, block_index, block);
+    }
+  }
+  if (mode.m_v == "trie") {
+    m_mode = Mode::Trie;
+    count_patterns(cfgs, weights);
+  } else if (mode.m_v == "sketch") {
+    m_mode = Mode::Sketch;
+    sketch_patterns(cfgs, weights);
+  } else if (mode.m_v == "suffix_array") {
+    m_mode = Mode::SuffixArray;
+    find_repeats(cfgs);
+  } else {
+    throw std::runtime_error("--HighFrequencySubExpr.mode: unknown mode " + mode.m_v);
+  }
+  if (select_num != 0U) {
+    if (m_mode != Mode::Trie) {
+      throw std::runtime_error("--HighFrequencySubExpr.select needs exact counts of the trie mode");
+    }
+    select_superinstructions(cfgs, weights);
+  }
+}
+
+/// count every part of the functions into its own `State` in parallel, then merge the states pairwise in
+/// log2(part_num) parallel rounds. blocks which are never executed are skipped.
+template <class State, class Create, class Count, class Merge>
+static State reduce_parts(std::vector<Cfg> const &cfgs, BlockWeights const &weights, Create const &create,
+                          Count const &count, Merge const &merge) {
+  std::vector<size_t> const bounds = partition_cfgs(cfgs, ThreadPool::get_thread_num());
+  std::vector<State> states(bounds.size() - 1U);
+  ThreadPool::for_each(states.size(), [&](size_t part) {
+    states[part] = create();
+    std::vector<Cursor> cursors(depth);
+    for (size_t cfg_index = bounds[part]; cfg_index < bounds[part + 1U]; cfg_index++) {
+      for (auto const &[block_index, block] : cfgs[cfg_index].m_blocks) {
+        uint64_t const block_weight = weights.get(cfgs[cfg_index], block_index, block);
+        if (block_weight != 0U) {
+          count(states[part], block, block_weight, cursors);
+        }
+      }
+    }
+  });
+  for (size_t step = 1U; step < states.size(); step *= 2U) {
+    ThreadPool::for_each((states.size() + 2U * step - 1U) / (2U * step), [&](size_t i) {
+      size_t const to = i * 2U * step;
+      size_t const from = to + step;
+      if (from < states.size()) {
+        merge(states[to], states[from]);
+        states[from] = State{};
+      }
+    });
+  }
+  return std::move(states.front());
+}
+
+void HighFrequencySubExpr::count_patterns(std::vector<Cfg> const &cfgs, BlockWeights const &weights) {
+  if (depth == 0U || cfgs.empty()) {
+    return;
+  }
+  ImmediateModes const modes = ImmediateModes::create();
+  m_trie = reduce_parts<PatternTrie>(
+      cfgs, weights, []() { return PatternTrie{}; },
+      [&modes](PatternTrie &trie, BasicBlock const &block, uint64_t block_weight, std::vector<Cursor> &cursors) {
+        count_block(trie, block, block_weight, modes, cursors);
+      },
+      [](PatternTrie &to, PatternTrie const &from) {
+        to.merge(from, [](std::optional<size_t> &count, size_t const &other) { count = count.value_or(0U) + other; });
+      });
+}
+
+void HighFrequencySubExpr::sketch_patterns(std::vector<Cfg> const &cfgs, BlockWeights const &weights) {
+  if (depth == 0U || cfgs.empty()) {
+    return;
+  }
+  ImmediateModes const modes = ImmediateModes::create();
+  m_sketch = reduce_parts<PatternSketch>(
+      cfgs, weights, []() { return PatternSketch::create(epsilon, delta, capacity); },
+      [&modes](PatternSketch &sketch, BasicBlock const &block, uint64_t block_weight, std::vector<Cursor> &cursors) {
+        sketch_block(sketch, block, block_weight, modes, cursors);
+      },
+      [](PatternSketch &to, PatternSketch const &from) { to.merge(from); });
+}
+
+namespace {
+
+/// scratch buffers of tile_block, indexed by instruction position
+struct TileBuffer {
+  std::vector<uint64_t> m_best{}; // dispatches of the suffix starting at the position
+  std::vector<size_t> m_pattern{};
+  std::vector<size_t> m_length{};
+  Cursor m_cursor{};
+};
+
+/// block executed at least once
+struct WeightedBlock {
+  BasicBlock const *m_block;
+  uint64_t m_weight;
+};
 
-  for (BasicBlock const &block : cfg_builder->get_all_blocks()) {
-    m_total_instr_num += block.m_instr.size();
-    std::vector<InstrCode> codes{};
-    for (Instr const *instr : block.m_instr) {
-      codes.push_back(instr->get_code());
-      for (size_t i = codes.size() > depth ? (codes.size() - depth) : 0U; i < codes.size(); i++) {
-        m_trie.update(std::span<InstrCode>{&codes[i], codes.size() - i}, [](std::optional<size_t> &v) -> void {
-          if (v.has_value()) {
-            v.value()++;
-          } else {
-            v = 1;
-          }
+} // namespace
+
+static constexpr size_t no_pattern = std::numeric_limits<size_t>::max();
+
+/// cover `block` with single instructions and the patterns of `patterns` (the value is the pattern index) accepted by
+/// `is_selected` using the fewest dispatches, ties prefer the longer pattern. returns the number of dispatches.
+template <class Selected>
+static uint64_t tile_block(PatternTrie const &patterns, Selected const &is_selected, BasicBlock const &block,
+                           ImmediateModes const &modes, TileBuffer &buffer) {
+  size_t const n = block.m_instr.size();
+  buffer.m_best.assign(n + 1U, 0U);
+  buffer.m_pattern.assign(n, no_pattern);
+  buffer.m_length.assign(n, 1U);
+  for (size_t i = n; i-- > 0U;) {
+    buffer.m_best[i] = buffer.m_best[i + 1U] + 1U;
+    buffer.m_cursor.m_locals.clear();
+    PatternTrie::NodeIndex node = PatternTrie::root;
+    for (size_t j = i; j < n; j++) {
+      node = patterns.find_child(node, get_key(*block.m_instr[j], modes, buffer.m_cursor));
+      if (node == PatternTrie::invalid_node) {
+        break;
+      }
+      std::optional<size_t> const &pattern = patterns.value(node);
+      if (pattern.has_value() && is_selected(pattern.value()) && buffer.m_best[j + 1U] + 1U <= buffer.m_best[i]) {
+        buffer.m_best[i] = buffer.m_best[j + 1U] + 1U;
+        buffer.m_pattern[i] = pattern.value();
+        buffer.m_length[i] = j + 1U - i;
+      }
+    }
+  }
+  return buffer.m_best[0];
+}
+
+/// sum of `fn(index, buffer)` over `indices`, split into one contiguous part with its own buffer per thread
+template <class Fn>
+static uint64_t sum_in_parallel(std::span<uint32_t const> indices, std::vector<TileBuffer> &buffers, Fn const &fn) {
+  std::vector<uint64_t> sums(buffers.size(), 0U);
+  ThreadPool::for_each(buffers.size(), [&](size_t part) {
+    size_t const end = indices.size() * (part + 1U) / buffers.size();
+    for (size_t i = indices.size() * part / buffers.size(); i < end; i++) {
+      sums[part] += fn(indices[i], buffers[part]);
+    }
+  });
+  return std::reduce(sums.begin(), sums.end(), uint64_t{0U});
+}
+
+/// patterns of at least 2 instructions which would eliminate the most dispatches on their own (count * (length - 1)),
+/// best first. ties are broken by the depth first visiting order.
+static std::vector<PatternTrie::NodeIndex> get_superinstruction_candidates(PatternTrie const &trie, size_t num) {
+  struct Candidate {
+    uint64_t m_saved;
+    size_t m_order;
+    PatternTrie::NodeIndex m_node;
+    // min-heap on rank: the worst candidate is on the top
+    bool operator<(Candidate const &o) const {
+      return m_saved != o.m_saved ? m_saved > o.m_saved : m_order < o.m_order;
+    }
+  };
+  struct Item {
+    PatternTrie::NodeIndex m_node;
+    size_t m_length;
+  };
+  std::priority_queue<Candidate> heap{};
+  if (num == 0U) {
+    return {};
+  }
+  size_t order = 0U;
+  std::vector<Item> work_list{Item{.m_node = PatternTrie::root, .m_length = 0U}};
+  std::vector<Item> children{};
+  std::vector<PatternTrie::NodeIndex> buffer{};
+  while (!work_list.empty()) {
+    Item const item = work_list.back();
+    work_list.pop_back();
+    if (std::optional<size_t> const &count = trie.value(item.m_node); count.has_value()) {
+      // no pattern of the subtree is more frequent or longer than the depth
+      if (heap.size() == num && count.value() * (depth - 1U) <= heap.top().m_saved) {
+        continue;
+      }
+      uint64_t const saved = count.value() * (item.m_length - 1U);
+      if (item.m_length >= 2U && (heap.size() < num || saved > heap.top().m_saved)) {
+        heap.push(Candidate{.m_saved = saved, .m_order = order, .m_node = item.m_node});
+        if (heap.size() > num) {
+          heap.pop();
+        }
+      }
+      order++;
+    }
+    children.clear();
+    trie.for_each_sorted_child(item.m_node, buffer, [&](PatternKey const &, PatternTrie::NodeIndex child) {
+      children.push_back(Item{.m_node = child, .m_length = item.m_length + 1U});
+    });
+    work_list.insert(work_list.end(), children.rbegin(), children.rend());
+  }
+  std::vector<PatternTrie::NodeIndex> results(heap.size());
+  for (auto it = results.rbegin(); it != results.rend(); ++it) {
+    *it = heap.top().m_node;
+    heap.pop();
+  }
+  return results;
+}
+
+/// greedily pick up to `select` superinstructions among the `num` best candidates, each time the one which
+/// eliminates the most dispatches when every block is tiled with the selection so far.
+/// gains are not submodular, a candidate can gain more once another one is selected, so an old gain is no bound of
+/// the current one. selecting a candidate only changes the tiling of the blocks containing it, so after each
+/// selection exactly the candidates sharing such a block are evaluated again, by tiling the blocks containing them.
+void HighFrequencySubExpr::select_superinstructions(std::vector<Cfg> const &cfgs, BlockWeights const &weights) {
+  m_superinstructions.clear();
+  ImmediateModes const modes = ImmediateModes::create();
+  std::vector<PatternTrie::NodeIndex> const candidates = get_superinstruction_candidates(m_trie, statistic_num);
+  PatternTrie candidate_trie{};
+  for (size_t i = 0; i < candidates.size(); i++) {
+    std::vector<PatternKey> path = m_trie.get_path(candidates[i]);
+    candidate_trie.insert_or_assign(path, i);
+  }
+
+  std::vector<WeightedBlock> blocks{};
+  for (Cfg const &cfg : cfgs) {
+    for (auto const &[block_index, block] : cfg.m_blocks) {
+      uint64_t const block_weight = weights.get(cfg, block_index, block);
+      if (block_weight != 0U && block.m_instr.size() >= 2U) {
+        blocks.push_back(WeightedBlock{.m_block = &block, .m_weight = block_weight});
+      }
+    }
+  }
+  // occurrences[i] are the blocks containing candidate i, dispatches[b] is the tiled size of block b
+  std::vector<std::vector<uint32_t>> occurrences(candidates.size());
+  std::vector<uint64_t> dispatches(blocks.size());
+  std::vector<bool> is_selected(candidates.size(), false);
+  auto const is_selected_now = [&is_selected](size_t i) { return is_selected[i]; };
+  std::vector<TileBuffer> buffers(ThreadPool::get_thread_num());
+  TileBuffer &buffer = buffers.front();
+  for (uint32_t b = 0; b < blocks.size(); b++) {
+    BasicBlock const &block = *blocks[b].m_block;
+    dispatches[b] = block.m_instr.size();
+    for (size_t i = 0; i < block.m_instr.size(); i++) {
+      buffer.m_cursor.m_locals.clear();
+      PatternTrie::NodeIndex node = PatternTrie::root;
+      for (size_t j = i; j < block.m_instr.size(); j++) {
+        node = candidate_trie.find_child(node, get_key(*block.m_instr[j], modes, buffer.m_cursor));
+        if (node == PatternTrie::invalid_node) {
+          break;
+        }
+        if (std::optional<size_t> const &candidate = candidate_trie.value(node);
+            candidate.has_value() &&
+            (occurrences[candidate.value()].empty() || occurrences[candidate.value()].back() != b)) {
+          occurrences[candidate.value()].push_back(b);
+        }
+      }
+    }
+  }
+
+  std::vector<uint64_t> gains(candidates.size(), 0U);
+  std::vector<bool> is_dirty(candidates.size(), true);
+  std::vector<bool> is_changed(blocks.size(), false);
+  std::vector<size_t> selected{};
+  while (selected.size() < select_num) {
+    std::optional<size_t> best{};
+    for (size_t candidate = 0; candidate < candidates.size(); candidate++) {
+      if (is_selected[candidate]) {
+        continue;
+      }
+      if (is_dirty[candidate]) {
+        auto const is_selected_with = [&](size_t i) { return i == candidate || is_selected[i]; };
+        gains[candidate] = sum_in_parallel(occurrences[candidate], buffers, [&](uint32_t b, TileBuffer &part_buffer) {
+          uint64_t const tiled = tile_block(candidate_trie, is_selected_with, *blocks[b].m_block, modes, part_buffer);
+          return (dispatches[b] - tiled) * blocks[b].m_weight;
         });
+        is_dirty[candidate] = false;
       }
+      if (!best.has_value() || gains[candidate] > gains[best.value()]) {
+        best = candidate;
+      }
+    }
+    if (!best.has_value() || gains[best.value()] == 0U) {
+      break;
+    }
+    size_t const candidate = best.value();
+    is_selected[candidate] = true;
+    sum_in_parallel(occurrences[candidate], buffers, [&](uint32_t b, TileBuffer &part_buffer) -> uint64_t {
+      dispatches[b] = tile_block(candidate_trie, is_selected_now, *blocks[b].m_block, modes, part_buffer);
+      return 0U;
+    });
+    selected.push_back(candidate);
+    m_superinstructions.push_back(Superinstruction{
+        .m_path = m_trie.get_path(candidates[candidate]), .m_saved = gains[candidate], .m_uses = 0U});
+
+    for (uint32_t b : occurrences[candidate]) {
+      is_changed[b] = true;
+    }
+    for (size_t i = 0; i < candidates.size(); i++) {
+      is_dirty[i] = is_dirty[i] || std::ranges::any_of(occurrences[i], [&](uint32_t b) { return is_changed[b]; });
     }
+    for (uint32_t b : occurrences[candidate]) {
+      is_changed[b] = false;
+    }
+  }
+
+  std::vector<uint64_t> uses(candidates.size(), 0U);
+  for (WeightedBlock const &weighted_block : blocks) {
+    tile_block(candidate_trie, is_selected_now, *weighted_block.m_block, modes, buffer);
+    for (size_t i = 0; i < weighted_block.m_block->m_instr.size(); i += buffer.m_length[i]) {
+      if (buffer.m_pattern[i] != no_pattern) {
+        uses[buffer.m_pattern[i]] += weighted_block.m_weight;
+      }
+    }
+  }
+  for (size_t i = 0; i < selected.size(); i++) {
+    m_superinstructions[i].m_uses = uses[selected[i]];
   }
 }
 
-void HighFrequencySubExpr::dump_result() {
-  if (m_total_instr_num == 0) {
-    throw std::runtime_error("empty code section");
+/// maximal repeats (occurring at least twice, not extensible to the left or right without losing an occurrence) of
+/// the concatenated block streams, ranked by covered instructions (count * length).
+/// every block is terminated by a unique separator so no repeat crosses a block boundary.
+void HighFrequencySubExpr::find_repeats(std::vector<Cfg> const &cfgs) {
+  std::vector<InstrCode> symbols{};
+  for (Cfg const &cfg : cfgs) {
+    for (auto const &[_, block] : cfg.m_blocks) {
+      for (Instr const *instr : block.m_instr) {
+        symbols.push_back(instr->get_code());
+      }
+    }
+  }
+  std::ranges::sort(symbols);
+  auto const [unique_end, _] = std::ranges::unique(symbols);
+  symbols.erase(unique_end, symbols.end());
+
+  std::vector<int32_t> text{};
+  text.reserve(m_total_instr_num + m_total_instr_num / 4U);
+  int32_t separator = static_cast<int32_t>(symbols.size());
+  for (Cfg const &cfg : cfgs) {
+    for (auto const &[_, block] : cfg.m_blocks) {
+      if (block.m_instr.empty()) {
+        continue;
+      }
+      for (Instr const *instr : block.m_instr) {
+        text.push_back(static_cast<int32_t>(std::ranges::lower_bound(symbols, instr->get_code()) - symbols.begin()));
+      }
+      text.push_back(separator++);
+    }
+  }
+  if (text.empty()) {
+    return;
+  }
+  std::vector<int32_t> const sa = SuffixArray::build(text, separator - 1);
+  std::vector<int32_t> const lcp = SuffixArray::build_lcp(text, sa);
+
+  // left_changes[i] is the number of k < i where the symbols preceding suffixes sa[k - 1] and sa[k] differ.
+  // an interval is left maximal when it contains such a k; separators are unique so they always differ.
+  auto const get_preceding = [&](size_t position) -> int32_t {
+    return sa[position] == 0 ? -1 : text[sa[position] - 1];
+  };
+  std::vector<int32_t> left_changes(sa.size() + 1U, 0);
+  for (size_t k = 1; k < sa.size(); k++) {
+    left_changes[k + 1U] = left_changes[k] + (get_preceding(k) != get_preceding(k - 1U) ? 1 : 0);
+  }
+
+  struct Candidate {
+    size_t m_covered; // by non-overlapping occurrences
+    int32_t m_length;
+    int32_t m_lb;
+    int32_t m_count;
+    int32_t m_disjoint_count;
+    // min-heap on rank: the worst candidate is on the top
+    bool operator<(Candidate const &o) const {
+      if (m_covered != o.m_covered) {
+        return m_covered > o.m_covered;
+      }
+      return m_length != o.m_length ? m_length > o.m_length : m_lb < o.m_lb;
+    }
+  };
+  std::priority_queue<Candidate> heap{};
+  std::vector<int32_t> starts{};
+  auto const report = [&](int32_t length, int32_t lb, int32_t rb) {
+    // right maximal by construction of lcp intervals
+    if (static_cast<size_t>(length) < min_length || left_changes[rb + 1] == left_changes[lb + 1]) {
+      return;
+    }
+    int32_t const count = rb - lb + 1;
+    // overlapping occurrences bound the coverage from above, skip sorting the starts of hopeless candidates
+    size_t const max_covered = static_cast<size_t>(count) * static_cast<size_t>(length);
+    if (heap.size() >= statistic_num && (heap.empty() || max_covered < heap.top().m_covered)) {
+      return;
+    }
+    starts.assign(sa.begin() + lb, sa.begin() + rb + 1);
+    std::ranges::sort(starts);
+    int32_t disjoint_count = 0;
+    int32_t next_start = 0;
+    for (int32_t const start : starts) {
+      if (start >= next_start) {
+        disjoint_count++;
+        next_start = start + length;
+      }
+    }
+    heap.push(Candidate{.m_covered = static_cast<size_t>(disjoint_count) * static_cast<size_t>(length),
+                        .m_length = length,
+                        .m_lb = lb,
+                        .m_count = count,
+                        .m_disjoint_count = disjoint_count});
+    if (heap.size() > statistic_num) {
+      heap.pop();
+    }
+  };
+  // bottom up traversal of the lcp interval tree
+  struct Interval {
+    int32_t m_lcp;
+    int32_t m_lb;
+  };
+  std::vector<Interval> stack{Interval{.m_lcp = 0, .m_lb = 0}};
+  int32_t const n = static_cast<int32_t>(sa.size());
+  for (int32_t i = 1; i <= n; i++) {
+    int32_t const current_lcp = i < n ? lcp[i] : 0;
+    int32_t lb = i - 1;
+    while (current_lcp < stack.back().m_lcp) {
+      Interval const interval = stack.back();
+      stack.pop_back();
+      report(interval.m_lcp, interval.m_lb, i - 1);
+      lb = interval.m_lb;
+    }
+    if (current_lcp > stack.back().m_lcp) {
+      stack.push_back(Interval{.m_lcp = current_lcp, .m_lb = lb});
+    }
+  }
+
+  m_repeats.resize(heap.size());
+  for (auto it = m_repeats.rbegin(); it != m_repeats.rend(); ++it) {
+    Candidate const &candidate = heap.top();
+    auto const begin = text.begin() + sa[candidate.m_lb];
+    it->m_count = static_cast<size_t>(candidate.m_count);
+    it->m_disjoint_count = static_cast<size_t>(candidate.m_disjoint_count);
+    it->m_path.clear();
+    for (int32_t symbol : std::span{begin, begin + candidate.m_length}) {
+      it->m_path.push_back(symbols[symbol]);
+    }
+    heap.pop();
   }
-  struct CountAndPath {
+}
+
+std::vector<PatternTrie::NodeIndex> HighFrequencySubExpr::get_top_patterns(size_t num) const {
+  // ranked by count, ties are broken by the depth first (lexicographic) visiting order.
+  struct Candidate {
     size_t m_count;
-    std::vector<InstrCode> m_path;
-    bool operator<(CountAndPath const &o) const { return m_count < o.m_count; }
+    size_t m_order;
+    PatternTrie::NodeIndex m_node;
+    // min-heap on rank: the worst candidate is on the top
+    bool operator<(Candidate const &o) const {
+      return m_count != o.m_count ? m_count > o.m_count : m_order < o.m_order;
+    }
   };
-  std::priority_queue<CountAndPath> results{};
-  m_trie.for_each([&results](std::vector<InstrCode> path, size_t const &count) {
-    results.push(CountAndPath{.m_count = count, .m_path = std::move(path)});
-  });
-  for (size_t i : Range(statistic_num)) {
-    if (results.empty()) {
-      break;
+  std::priority_queue<Candidate> heap{};
+  if (num == 0U) {
+    return {};
+  }
+  size_t order = 0U;
+  std::vector<PatternTrie::NodeIndex> work_list{PatternTrie::root};
+  std::vector<PatternTrie::NodeIndex> children{};
+  std::vector<PatternTrie::NodeIndex> buffer{};
+  while (!work_list.empty()) {
+    PatternTrie::NodeIndex const node = work_list.back();
+    work_list.pop_back();
+    if (std::optional<size_t> const &count = m_trie.value(node); count.has_value()) {
+      // a pattern is never more frequent than its prefix, so the whole subtree loses against a full heap.
+      if (heap.size() == num && count.value() <= heap.top().m_count) {
+        continue;
+      }
+      heap.push(Candidate{.m_count = count.value(), .m_order = order++, .m_node = node});
+      if (heap.size() > num) {
+        heap.pop();
+      }
     }
-    CountAndPath const &result = results.top();
+    children.clear();
+    m_trie.for_each_sorted_child(
+        node, buffer, [&children](PatternKey const &, PatternTrie::NodeIndex child) { children.push_back(child); });
+    work_list.insert(work_list.end(), children.rbegin(), children.rend());
+  }
+  std::vector<PatternTrie::NodeIndex> results(heap.size());
+  for (auto it = results.rbegin(); it != results.rend(); ++it) {
+    *it = heap.top().m_node;
+    heap.pop();
+  }
+  return results;
+}
+
+void HighFrequencySubExpr::write_patterns(std::ostream &os) const {
+  if (m_mode != Mode::Trie) {
+    throw std::runtime_error("--HighFrequencySubExpr.output needs exact counts of the trie mode");
+  }
+  ImmediateModes const modes = ImmediateModes::create();
+  BlockWeightKind const weight_kind = BlockWeights::get_kind();
+  PatternFileSettings const settings{.m_depth = depth,
+                                     .m_const = modes.m_const,
+                                     .m_local = modes.m_local,
+                                     .m_memarg = modes.m_memarg,
+                                     .m_index = modes.m_index,
+                                     .m_weight = weight_kind,
+                                     .m_loop_base = weight_kind == BlockWeightKind::None ? 0U : loop_base.m_v};
+  PatternFileWriter writer{os, settings, m_total_instr_num};
+  m_trie.for_each([&writer](std::vector<PatternKey> const &path, size_t const &count) { writer.write(path, count); });
+  writer.finish();
+}
 
-    std::cout << StringOperator::join(result.m_path, ", ") << ": "
-              << (static_cast<double>(result.m_count) / static_cast<double>(m_total_instr_num) * 100) << "%\n";
-    results.pop();
+void HighFrequencySubExpr::dump_result() {
+  if (m_total_instr_num == 0) {
+    throw std::runtime_error("empty code section");
+  }
+  if (!output.m_v.empty()) {
+    std::ofstream file{output.m_v, std::ios::binary | std::ios::out | std::ios::trunc};
+    if (!file.is_open()) {
+      throw std::runtime_error("cannot open " + output.m_v);
+    }
+    write_patterns(file);
+  }
+  if (m_mode == Mode::Sketch) {
+    std::vector<PatternSketch::HeavyHitters::Entry> entries = m_sketch.m_heavy_hitters.get_entries();
+    std::ranges::sort(entries, [](auto const &l, auto const &r) {
+      return l.m_count != r.m_count ? l.m_count > r.m_count : l.m_data < r.m_data;
+    });
+    for (auto const &entry : entries | std::views::take(statistic_num)) {
+      // both summaries over-estimate, the smaller upper bound is the better estimate
+      uint64_t const upper = std::min(entry.m_count, m_sketch.m_frequency.estimate(entry.m_key));
+      uint64_t const lower = entry.m_count - entry.m_error;
+      std::cout << StringOperator::join(entry.m_data, ", ") << ": "
+                << (static_cast<double>(upper) / static_cast<double>(m_total_instr_num) * 100) << "% (>= "
+                << (static_cast<double>(lower) / static_cast<double>(m_total_instr_num) * 100) << "%)\n";
+    }
+    return;
+  }
+  if (m_mode == Mode::SuffixArray) {
+    for (RepeatPattern const &repeat : m_repeats) {
+      size_t const covered = repeat.m_disjoint_count * repeat.m_path.size();
+      std::cout << StringOperator::join(repeat.m_path, ", ") << ": count=" << repeat.m_count
+                << " disjoint=" << repeat.m_disjoint_count << " length=" << repeat.m_path.size() << " covered="
+                << (static_cast<double>(covered) / static_cast<double>(m_total_instr_num) * 100) << "%\n";
+    }
+    return;
+  }
+  if (select_num != 0U) {
+    uint64_t saved = 0U;
+    for (Superinstruction const &superinstruction : m_superinstructions) {
+      saved += superinstruction.m_saved;
+      std::cout << StringOperator::join(superinstruction.m_path, ", ") << ": uses=" << superinstruction.m_uses
+                << " saved="
+                << (static_cast<double>(superinstruction.m_saved) / static_cast<double>(m_total_instr_num) * 100)
+                << "% cumulative=" << (static_cast<double>(saved) / static_cast<double>(m_total_instr_num) * 100)
+                << "%\n";
+    }
+    std::cout << "dispatches: " << m_total_instr_num << " -> " << (m_total_instr_num - saved) << "\n";
+    return;
+  }
+  for (PatternTrie::NodeIndex node : get_top_patterns(statistic_num)) {
+    std::cout << StringOperator::join(m_trie.get_path(node), ", ") << ": "
+              << (static_cast<double>(m_trie.value(node).value()) / static_cast<double>(m_total_instr_num) * 100)
+              << "%\n";
   }
 }
 
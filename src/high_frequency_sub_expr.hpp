@@ -1,22 +1,121 @@
 #pragma once
 
-#include "adt/trie.hpp"
+#include "adt/count_min_sketch.hpp"
+#include "adt/flat_trie.hpp"
+#include "adt/space_saving.hpp"
 #include "analyzer.hpp"
+#include "cfg.hpp"
+#include "instruction.hpp"
 #include "module.hpp"
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <ostream>
+#include <vector>
 
 namespace wa {
 
+/// how the immediate of an instruction takes part in a pattern
+enum class ImmediateClass : uint8_t {
+  None,        // ignored
+  Exact,       // m_value is the immediate, memarg is `offset << 32 | align`
+  Relative,    // m_value is the order of first use of the local inside the pattern
+  Small,       // constant encoded in one LEB128 byte
+  Large,       // any other constant
+  MemArgClass, // bit 0: natural alignment, bit 1..: offset is 0 / encoded in one byte / larger
+};
+
+/// estimated execution count a block occurrence of a pattern is counted with
+enum class BlockWeightKind : uint8_t {
+  None,    // every block counts once
+  Loop,    // loop_base ^ loop depth
+  Profile, // counts of a profile file
+};
+
+struct PatternKey {
+  InstrCode m_code{};
+  ImmediateClass m_class = ImmediateClass::None;
+  uint64_t m_value = 0U;
+
+  auto operator<=>(PatternKey const &o) const = default;
+};
+
+struct PatternKeyHash {
+  size_t operator()(PatternKey const &key) const {
+    return std::hash<uint64_t>{}((static_cast<uint64_t>(key.m_code) << 8U | static_cast<uint64_t>(key.m_class)) ^
+                                 (key.m_value * 0xC2B2AE3D27D4EB4FULL));
+  }
+};
+
+std::ostream &operator<<(std::ostream &os, PatternKey const &key);
+
+using PatternTrie = FlatTrie<PatternKey, size_t, PatternKeyHash>;
+
+/// fixed memory approximation of the n-gram counts, keyed by a rolling hash of the pattern.
+/// sketches created with the same parameters can be merged.
+struct PatternSketch {
+  using HeavyHitters = SpaceSaving<uint64_t, std::vector<PatternKey>>;
+
+  CountMinSketch m_frequency{};
+  HeavyHitters m_heavy_hitters{}; // m_data is the pattern of the hash
+
+  static PatternSketch create(double epsilon, double delta, size_t capacity) {
+    return PatternSketch{.m_frequency = CountMinSketch{epsilon, delta}, .m_heavy_hitters = HeavyHitters{capacity}};
+  }
+  void merge(PatternSketch const &o) {
+    m_frequency.merge(o.m_frequency);
+    m_heavy_hitters.merge(o.m_heavy_hitters);
+  }
+};
+
+class BlockWeights;
+
+/// repeated instruction sequence found in suffix array mode
+struct RepeatPattern {
+  std::vector<InstrCode> m_path;
+  size_t m_count;          // all occurrences, overlapping ones included
+  size_t m_disjoint_count; // greedy non-overlapping occurrences, m_disjoint_count * length instructions are covered
+};
+
+/// pattern chosen to become a single interpreter instruction
+struct Superinstruction {
+  std::vector<PatternKey> m_path;
+  uint64_t m_saved; // dispatches eliminated when added to the previously selected ones
+  uint64_t m_uses;  // dispatches of the superinstruction when tiling with the whole selection
+};
+
 class HighFrequencySubExpr : public IAnalyzer {
+public:
+  enum class Mode {
+    Trie,        // every n-gram up to the depth, exact counts
+    Sketch,      // every n-gram up to the depth, approximate counts of the heavy hitters in fixed memory
+    SuffixArray, // maximal repeats of any length
+  };
+
+private:
+  Mode m_mode = Mode::Trie;
   size_t m_total_instr_num = 0;
-  Trie<InstrCode, size_t> m_trie{};
+  PatternTrie m_trie{};
+  PatternSketch m_sketch{};
+  std::vector<RepeatPattern> m_repeats{}; // most covering first
+  std::vector<Superinstruction> m_superinstructions{}; // in order of selection
 
 public:
   explicit HighFrequencySubExpr(std::shared_ptr<AnalyzerContext> context) : IAnalyzer(context) {}
+  /// nodes of the `num` most frequent patterns, most frequent first
+  std::vector<PatternTrie::NodeIndex> get_top_patterns(size_t num) const;
+  /// exact counts in the format of PatternFileWriter
+  void write_patterns(std::ostream &os) const;
   void dump_result();
 
 private:
   void analyze_impl(Module &module) override;
+  void count_patterns(std::vector<Cfg> const &cfgs, BlockWeights const &weights);
+  void sketch_patterns(std::vector<Cfg> const &cfgs, BlockWeights const &weights);
+  void find_repeats(std::vector<Cfg> const &cfgs);
+  void select_superinstructions(std::vector<Cfg> const &cfgs, BlockWeights const &weights);
 };
 
 } // namespace wa
@@ -3,6 +3,7 @@
 #include "error.hpp"
 #include "module.hpp"
 #include <cstddef>
+#include <stdexcept>
 #include <type_traits>
 #include <variant>
 
@@ -422,6 +423,132 @@ std::ostream &operator<<(std::ostream &os, InstrCode code) {
   }
 }
 
+bool is_load(InstrCode code) { return code >= InstrCode::I32_LOAD && code <= InstrCode::I64_LOAD32_U; }
+bool is_store(InstrCode code) { return code >= InstrCode::I32_STORE && code <= InstrCode::I64_STORE32; }
+bool is_pure(InstrCode code) {
+  switch (code) {
+  case InstrCode::I32_DIV_S:
+  case InstrCode::I32_DIV_U:
+  case InstrCode::I32_REM_S:
+  case InstrCode::I32_REM_U:
+  case InstrCode::I64_DIV_S:
+  case InstrCode::I64_DIV_U:
+  case InstrCode::I64_REM_S:
+  case InstrCode::I64_REM_U:
+  case InstrCode::I32_TRUNC_S_F32:
+  case InstrCode::I32_TRUNC_U_F32:
+  case InstrCode::I32_TRUNC_S_F64:
+  case InstrCode::I32_TRUNC_U_F64:
+  case InstrCode::I64_TRUNC_S_F32:
+  case InstrCode::I64_TRUNC_U_F32:
+  case InstrCode::I64_TRUNC_S_F64:
+  case InstrCode::I64_TRUNC_U_F64:
+    return false;
+  case InstrCode::SELECT:
+  case InstrCode::LOCAL_GET:
+  case InstrCode::GLOBAL_GET:
+  case InstrCode::MEMORY_SIZE:
+    return true;
+  default:
+    // constants and numeric operators
+    return (code >= InstrCode::I32_CONST && code <= InstrCode::I64_EXTEND32_S) ||
+           (static_cast<uint16_t>(code) >> 8U) == SATURATING_TRUNCATION_PREFIX;
+  }
+}
+uint32_t get_natural_alignment(InstrCode code) {
+  switch (code) {
+  case InstrCode::I32_LOAD8_S:
+  case InstrCode::I32_LOAD8_U:
+  case InstrCode::I64_LOAD8_S:
+  case InstrCode::I64_LOAD8_U:
+  case InstrCode::I32_STORE8:
+  case InstrCode::I64_STORE8:
+    return 0U;
+  case InstrCode::I32_LOAD16_S:
+  case InstrCode::I32_LOAD16_U:
+  case InstrCode::I64_LOAD16_S:
+  case InstrCode::I64_LOAD16_U:
+  case InstrCode::I32_STORE16:
+  case InstrCode::I64_STORE16:
+    return 1U;
+  case InstrCode::I32_LOAD:
+  case InstrCode::F32_LOAD:
+  case InstrCode::I64_LOAD32_S:
+  case InstrCode::I64_LOAD32_U:
+  case InstrCode::I32_STORE:
+  case InstrCode::F32_STORE:
+  case InstrCode::I64_STORE32:
+    return 2U;
+  case InstrCode::I64_LOAD:
+  case InstrCode::F64_LOAD:
+  case InstrCode::I64_STORE:
+  case InstrCode::F64_STORE:
+    return 3U;
+  default:
+    throw std::runtime_error("not a memory access");
+  }
+}
+
+bool is_commutative(InstrCode code) {
+  switch (code) {
+  case InstrCode::I32_EQ:
+  case InstrCode::I32_NE:
+  case InstrCode::I64_EQ:
+  case InstrCode::I64_NE:
+  case InstrCode::F32_EQ:
+  case InstrCode::F32_NE:
+  case InstrCode::F64_EQ:
+  case InstrCode::F64_NE:
+  case InstrCode::I32_ADD:
+  case InstrCode::I32_MUL:
+  case InstrCode::I32_AND:
+  case InstrCode::I32_OR:
+  case InstrCode::I32_XOR:
+  case InstrCode::I64_ADD:
+  case InstrCode::I64_MUL:
+  case InstrCode::I64_AND:
+  case InstrCode::I64_OR:
+  case InstrCode::I64_XOR:
+  case InstrCode::F32_ADD:
+  case InstrCode::F32_MUL:
+  case InstrCode::F32_MIN:
+  case InstrCode::F32_MAX:
+  case InstrCode::F64_ADD:
+  case InstrCode::F64_MUL:
+  case InstrCode::F64_MIN:
+  case InstrCode::F64_MAX:
+    return true;
+  default:
+    return false;
+  }
+}
+bool is_associative(InstrCode code, bool is_fast_math) {
+  switch (code) {
+  case InstrCode::I32_ADD:
+  case InstrCode::I32_MUL:
+  case InstrCode::I32_AND:
+  case InstrCode::I32_OR:
+  case InstrCode::I32_XOR:
+  case InstrCode::I64_ADD:
+  case InstrCode::I64_MUL:
+  case InstrCode::I64_AND:
+  case InstrCode::I64_OR:
+  case InstrCode::I64_XOR:
+    return true;
+  case InstrCode::F32_ADD:
+  case InstrCode::F32_MUL:
+  case InstrCode::F32_MIN:
+  case InstrCode::F32_MAX:
+  case InstrCode::F64_ADD:
+  case InstrCode::F64_MUL:
+  case InstrCode::F64_MIN:
+  case InstrCode::F64_MAX:
+    return is_fast_math;
+  default:
+    return false;
+  }
+}
+
 static std::ostream &operator<<(std::ostream &os, std::shared_ptr<FunctionType> const &type) { return os << *type; }
 static std::ostream &operator<<(std::ostream &os, Index const &index) { return os << index.m_v; }
 static std::ostream &operator<<(std::ostream &os, std::vector<Index> const &indexes) {
@@ -446,6 +573,7 @@ std::ostream &operator<<(std::ostream &os, Instr const &instr) {
 
 size_t Instr::get_operand_count() const {
   switch (m_code) {
+  case InstrCode::NOP:
   case InstrCode::I32_CONST:
   case InstrCode::I64_CONST:
   case InstrCode::F32_CONST:
@@ -453,40 +581,14 @@ size_t Instr::get_operand_count() const {
 
   case InstrCode::LOCAL_GET:
   case InstrCode::GLOBAL_GET:
+  case InstrCode::MEMORY_SIZE:
     return 0U;
-  case InstrCode::I32_ADD:
-  case InstrCode::I32_SUB:
-  case InstrCode::I32_MUL:
-  case InstrCode::I32_DIV_S:
-  case InstrCode::I32_DIV_U:
-  case InstrCode::I32_REM_S:
-  case InstrCode::I32_REM_U:
-  case InstrCode::I32_AND:
-  case InstrCode::I32_OR:
-  case InstrCode::I32_XOR:
-  case InstrCode::I32_SHL:
-  case InstrCode::I32_SHR_S:
-  case InstrCode::I32_SHR_U:
-    return 2U;
 
-  case InstrCode::UNREACHABLE:
-  case InstrCode::NOP:
-  case InstrCode::BLOCK:
-  case InstrCode::LOOP:
-  case InstrCode::IF:
-  case InstrCode::ELSE:
-  case InstrCode::END:
-  case InstrCode::BR:
-  case InstrCode::BR_IF:
-  case InstrCode::BR_TABLE:
-  case InstrCode::RETURN:
-  case InstrCode::CALL:
-  case InstrCode::CALL_INDIRECT:
   case InstrCode::DROP:
-  case InstrCode::SELECT:
   case InstrCode::LOCAL_SET:
   case InstrCode::LOCAL_TEE:
   case InstrCode::GLOBAL_SET:
+  case InstrCode::MEMORY_GROW:
   case InstrCode::I32_LOAD:
   case InstrCode::I64_LOAD:
   case InstrCode::F32_LOAD:
@@ -501,76 +603,15 @@ size_t Instr::get_operand_count() const {
   case InstrCode::I64_LOAD16_U:
   case InstrCode::I64_LOAD32_S:
   case InstrCode::I64_LOAD32_U:
-  case InstrCode::I32_STORE:
-  case InstrCode::I64_STORE:
-  case InstrCode::F32_STORE:
-  case InstrCode::F64_STORE:
-  case InstrCode::I32_STORE8:
-  case InstrCode::I32_STORE16:
-  case InstrCode::I64_STORE8:
-  case InstrCode::I64_STORE16:
-  case InstrCode::I64_STORE32:
-  case InstrCode::MEMORY_SIZE:
-  case InstrCode::MEMORY_GROW:
 
   case InstrCode::I32_EQZ:
-  case InstrCode::I32_EQ:
-  case InstrCode::I32_NE:
-  case InstrCode::I32_LT_S:
-  case InstrCode::I32_LT_U:
-  case InstrCode::I32_GT_S:
-  case InstrCode::I32_GT_U:
-  case InstrCode::I32_LE_S:
-  case InstrCode::I32_LE_U:
-  case InstrCode::I32_GE_S:
-  case InstrCode::I32_GE_U:
   case InstrCode::I64_EQZ:
-  case InstrCode::I64_EQ:
-  case InstrCode::I64_NE:
-  case InstrCode::I64_LT_S:
-  case InstrCode::I64_LT_U:
-  case InstrCode::I64_GT_S:
-  case InstrCode::I64_GT_U:
-  case InstrCode::I64_LE_S:
-  case InstrCode::I64_LE_U:
-  case InstrCode::I64_GE_S:
-  case InstrCode::I64_GE_U:
-  case InstrCode::F32_EQ:
-  case InstrCode::F32_NE:
-  case InstrCode::F32_LT:
-  case InstrCode::F32_GT:
-  case InstrCode::F32_LE:
-  case InstrCode::F32_GE:
-  case InstrCode::F64_EQ:
-  case InstrCode::F64_NE:
-  case InstrCode::F64_LT:
-  case InstrCode::F64_GT:
-  case InstrCode::F64_LE:
-  case InstrCode::F64_GE:
   case InstrCode::I32_CLZ:
   case InstrCode::I32_CTZ:
   case InstrCode::I32_POPCNT:
-
-  case InstrCode::I32_ROTL:
-  case InstrCode::I32_ROTR:
   case InstrCode::I64_CLZ:
   case InstrCode::I64_CTZ:
   case InstrCode::I64_POPCNT:
-  case InstrCode::I64_ADD:
-  case InstrCode::I64_SUB:
-  case InstrCode::I64_MUL:
-  case InstrCode::I64_DIV_S:
-  case InstrCode::I64_DIV_U:
-  case InstrCode::I64_REM_S:
-  case InstrCode::I64_REM_U:
-  case InstrCode::I64_AND:
-  case InstrCode::I64_OR:
-  case InstrCode::I64_XOR:
-  case InstrCode::I64_SHL:
-  case InstrCode::I64_SHR_S:
-  case InstrCode::I64_SHR_U:
-  case InstrCode::I64_ROTL:
-  case InstrCode::I64_ROTR:
   case InstrCode::F32_ABS:
   case InstrCode::F32_NEG:
   case InstrCode::F32_CEIL:
@@ -578,13 +619,6 @@ size_t Instr::get_operand_count() const {
   case InstrCode::F32_TRUNC:
   case InstrCode::F32_NEAREST:
   case InstrCode::F32_SQRT:
-  case InstrCode::F32_ADD:
-  case InstrCode::F32_SUB:
-  case InstrCode::F32_MUL:
-  case InstrCode::F32_DIV:
-  case InstrCode::F32_MIN:
-  case InstrCode::F32_MAX:
-  case InstrCode::F32_COPYSIGN:
   case InstrCode::F64_ABS:
   case InstrCode::F64_NEG:
   case InstrCode::F64_CEIL:
@@ -592,13 +626,7 @@ size_t Instr::get_operand_count() const {
   case InstrCode::F64_TRUNC:
   case InstrCode::F64_NEAREST:
   case InstrCode::F64_SQRT:
-  case InstrCode::F64_ADD:
-  case InstrCode::F64_SUB:
-  case InstrCode::F64_MUL:
-  case InstrCode::F64_DIV:
-  case InstrCode::F64_MIN:
-  case InstrCode::F64_MAX:
-  case InstrCode::F64_COPYSIGN:
+
   case InstrCode::I32_WRAP_I64:
   case InstrCode::I32_TRUNC_S_F32:
   case InstrCode::I32_TRUNC_U_F32:
@@ -637,19 +665,50 @@ size_t Instr::get_operand_count() const {
   case InstrCode::I64_TRUNC_SAT_F32_U:
   case InstrCode::I64_TRUNC_SAT_F64_S:
   case InstrCode::I64_TRUNC_SAT_F64_U:
-    throw Todo{__func__};
-  }
-}
+    return 1U;
 
-size_t Instr::get_result_count() const {
-  switch (m_code) {
-  case InstrCode::I32_CONST:
-  case InstrCode::I64_CONST:
-  case InstrCode::F32_CONST:
-  case InstrCode::F64_CONST:
+  case InstrCode::I32_STORE:
+  case InstrCode::I64_STORE:
+  case InstrCode::F32_STORE:
+  case InstrCode::F64_STORE:
+  case InstrCode::I32_STORE8:
+  case InstrCode::I32_STORE16:
+  case InstrCode::I64_STORE8:
+  case InstrCode::I64_STORE16:
+  case InstrCode::I64_STORE32:
 
-  case InstrCode::GLOBAL_GET:
-  case InstrCode::LOCAL_GET:
+  case InstrCode::I32_EQ:
+  case InstrCode::I32_NE:
+  case InstrCode::I32_LT_S:
+  case InstrCode::I32_LT_U:
+  case InstrCode::I32_GT_S:
+  case InstrCode::I32_GT_U:
+  case InstrCode::I32_LE_S:
+  case InstrCode::I32_LE_U:
+  case InstrCode::I32_GE_S:
+  case InstrCode::I32_GE_U:
+  case InstrCode::I64_EQ:
+  case InstrCode::I64_NE:
+  case InstrCode::I64_LT_S:
+  case InstrCode::I64_LT_U:
+  case InstrCode::I64_GT_S:
+  case InstrCode::I64_GT_U:
+  case InstrCode::I64_LE_S:
+  case InstrCode::I64_LE_U:
+  case InstrCode::I64_GE_S:
+  case InstrCode::I64_GE_U:
+  case InstrCode::F32_EQ:
+  case InstrCode::F32_NE:
+  case InstrCode::F32_LT:
+  case InstrCode::F32_GT:
+  case InstrCode::F32_LE:
+  case InstrCode::F32_GE:
+  case InstrCode::F64_EQ:
+  case InstrCode::F64_NE:
+  case InstrCode::F64_LT:
+  case InstrCode::F64_GT:
+  case InstrCode::F64_LE:
+  case InstrCode::F64_GE:
 
   case InstrCode::I32_ADD:
   case InstrCode::I32_SUB:
@@ -664,10 +723,44 @@ size_t Instr::get_result_count() const {
   case InstrCode::I32_SHL:
   case InstrCode::I32_SHR_S:
   case InstrCode::I32_SHR_U:
-    return 1U;
+  case InstrCode::I32_ROTL:
+  case InstrCode::I32_ROTR:
+  case InstrCode::I64_ADD:
+  case InstrCode::I64_SUB:
+  case InstrCode::I64_MUL:
+  case InstrCode::I64_DIV_S:
+  case InstrCode::I64_DIV_U:
+  case InstrCode::I64_REM_S:
+  case InstrCode::I64_REM_U:
+  case InstrCode::I64_AND:
+  case InstrCode::I64_OR:
+  case InstrCode::I64_XOR:
+  case InstrCode::I64_SHL:
+  case InstrCode::I64_SHR_S:
+  case InstrCode::I64_SHR_U:
+  case InstrCode::I64_ROTL:
+  case InstrCode::I64_ROTR:
+  case InstrCode::F32_ADD:
+  case InstrCode::F32_SUB:
+  case InstrCode::F32_MUL:
+  case InstrCode::F32_DIV:
+  case InstrCode::F32_MIN:
+  case InstrCode::F32_MAX:
+  case InstrCode::F32_COPYSIGN:
+  case InstrCode::F64_ADD:
+  case InstrCode::F64_SUB:
+  case InstrCode::F64_MUL:
+  case InstrCode::F64_DIV:
+  case InstrCode::F64_MIN:
+  case InstrCode::F64_MAX:
+  case InstrCode::F64_COPYSIGN:
+    return 2U;
+
+  case InstrCode::SELECT:
+    return 3U;
 
+  // depend on block type, label or callee
   case InstrCode::UNREACHABLE:
-  case InstrCode::NOP:
   case InstrCode::BLOCK:
   case InstrCode::LOOP:
   case InstrCode::IF:
@@ -679,11 +772,39 @@ size_t Instr::get_result_count() const {
   case InstrCode::RETURN:
   case InstrCode::CALL:
   case InstrCode::CALL_INDIRECT:
+    throw Todo{__func__};
+  }
+  throw Todo{__func__};
+}
+
+size_t Instr::get_result_count() const {
+  switch (m_code) {
+  case InstrCode::NOP:
   case InstrCode::DROP:
-  case InstrCode::SELECT:
   case InstrCode::LOCAL_SET:
-  case InstrCode::LOCAL_TEE:
   case InstrCode::GLOBAL_SET:
+  case InstrCode::I32_STORE:
+  case InstrCode::I64_STORE:
+  case InstrCode::F32_STORE:
+  case InstrCode::F64_STORE:
+  case InstrCode::I32_STORE8:
+  case InstrCode::I32_STORE16:
+  case InstrCode::I64_STORE8:
+  case InstrCode::I64_STORE16:
+  case InstrCode::I64_STORE32:
+    return 0U;
+
+  case InstrCode::I32_CONST:
+  case InstrCode::I64_CONST:
+  case InstrCode::F32_CONST:
+  case InstrCode::F64_CONST:
+
+  case InstrCode::LOCAL_GET:
+  case InstrCode::LOCAL_TEE:
+  case InstrCode::GLOBAL_GET:
+  case InstrCode::SELECT:
+  case InstrCode::MEMORY_SIZE:
+  case InstrCode::MEMORY_GROW:
   case InstrCode::I32_LOAD:
   case InstrCode::I64_LOAD:
   case InstrCode::F32_LOAD:
@@ -698,19 +819,7 @@ size_t Instr::get_result_count() const {
   case InstrCode::I64_LOAD16_U:
   case InstrCode::I64_LOAD32_S:
   case InstrCode::I64_LOAD32_U:
-  case InstrCode::I32_STORE:
-  case InstrCode::I64_STORE:
-  case InstrCode::F32_STORE:
-  case InstrCode::F64_STORE:
-  case InstrCode::I32_STORE8:
-  case InstrCode::I32_STORE16:
-  case InstrCode::I64_STORE8:
-  case InstrCode::I64_STORE16:
-  case InstrCode::I64_STORE32:
-  case InstrCode::MEMORY_SIZE:
-  case InstrCode::MEMORY_GROW:
 
-  case InstrCode::I32_EQZ:
   case InstrCode::I32_EQ:
   case InstrCode::I32_NE:
   case InstrCode::I32_LT_S:
@@ -721,7 +830,6 @@ size_t Instr::get_result_count() const {
   case InstrCode::I32_LE_U:
   case InstrCode::I32_GE_S:
   case InstrCode::I32_GE_U:
-  case InstrCode::I64_EQZ:
   case InstrCode::I64_EQ:
   case InstrCode::I64_NE:
   case InstrCode::I64_LT_S:
@@ -744,15 +852,22 @@ size_t Instr::get_result_count() const {
   case InstrCode::F64_GT:
   case InstrCode::F64_LE:
   case InstrCode::F64_GE:
-  case InstrCode::I32_CLZ:
-  case InstrCode::I32_CTZ:
-  case InstrCode::I32_POPCNT:
 
+  case InstrCode::I32_ADD:
+  case InstrCode::I32_SUB:
+  case InstrCode::I32_MUL:
+  case InstrCode::I32_DIV_S:
+  case InstrCode::I32_DIV_U:
+  case InstrCode::I32_REM_S:
+  case InstrCode::I32_REM_U:
+  case InstrCode::I32_AND:
+  case InstrCode::I32_OR:
+  case InstrCode::I32_XOR:
+  case InstrCode::I32_SHL:
+  case InstrCode::I32_SHR_S:
+  case InstrCode::I32_SHR_U:
   case InstrCode::I32_ROTL:
   case InstrCode::I32_ROTR:
-  case InstrCode::I64_CLZ:
-  case InstrCode::I64_CTZ:
-  case InstrCode::I64_POPCNT:
   case InstrCode::I64_ADD:
   case InstrCode::I64_SUB:
   case InstrCode::I64_MUL:
@@ -768,13 +883,6 @@ size_t Instr::get_result_count() const {
   case InstrCode::I64_SHR_U:
   case InstrCode::I64_ROTL:
   case InstrCode::I64_ROTR:
-  case InstrCode::F32_ABS:
-  case InstrCode::F32_NEG:
-  case InstrCode::F32_CEIL:
-  case InstrCode::F32_FLOOR:
-  case InstrCode::F32_TRUNC:
-  case InstrCode::F32_NEAREST:
-  case InstrCode::F32_SQRT:
   case InstrCode::F32_ADD:
   case InstrCode::F32_SUB:
   case InstrCode::F32_MUL:
@@ -782,13 +890,6 @@ size_t Instr::get_result_count() const {
   case InstrCode::F32_MIN:
   case InstrCode::F32_MAX:
   case InstrCode::F32_COPYSIGN:
-  case InstrCode::F64_ABS:
-  case InstrCode::F64_NEG:
-  case InstrCode::F64_CEIL:
-  case InstrCode::F64_FLOOR:
-  case InstrCode::F64_TRUNC:
-  case InstrCode::F64_NEAREST:
-  case InstrCode::F64_SQRT:
   case InstrCode::F64_ADD:
   case InstrCode::F64_SUB:
   case InstrCode::F64_MUL:
@@ -796,6 +897,30 @@ size_t Instr::get_result_count() const {
   case InstrCode::F64_MIN:
   case InstrCode::F64_MAX:
   case InstrCode::F64_COPYSIGN:
+
+  case InstrCode::I32_EQZ:
+  case InstrCode::I64_EQZ:
+  case InstrCode::I32_CLZ:
+  case InstrCode::I32_CTZ:
+  case InstrCode::I32_POPCNT:
+  case InstrCode::I64_CLZ:
+  case InstrCode::I64_CTZ:
+  case InstrCode::I64_POPCNT:
+  case InstrCode::F32_ABS:
+  case InstrCode::F32_NEG:
+  case InstrCode::F32_CEIL:
+  case InstrCode::F32_FLOOR:
+  case InstrCode::F32_TRUNC:
+  case InstrCode::F32_NEAREST:
+  case InstrCode::F32_SQRT:
+  case InstrCode::F64_ABS:
+  case InstrCode::F64_NEG:
+  case InstrCode::F64_CEIL:
+  case InstrCode::F64_FLOOR:
+  case InstrCode::F64_TRUNC:
+  case InstrCode::F64_NEAREST:
+  case InstrCode::F64_SQRT:
+
   case InstrCode::I32_WRAP_I64:
   case InstrCode::I32_TRUNC_S_F32:
   case InstrCode::I32_TRUNC_U_F32:
@@ -834,8 +959,24 @@ size_t Instr::get_result_count() const {
   case InstrCode::I64_TRUNC_SAT_F32_U:
   case InstrCode::I64_TRUNC_SAT_F64_S:
   case InstrCode::I64_TRUNC_SAT_F64_U:
+    return 1U;
+
+  // depend on block type, label or callee
+  case InstrCode::UNREACHABLE:
+  case InstrCode::BLOCK:
+  case InstrCode::LOOP:
+  case InstrCode::IF:
+  case InstrCode::ELSE:
+  case InstrCode::END:
+  case InstrCode::BR:
+  case InstrCode::BR_IF:
+  case InstrCode::BR_TABLE:
+  case InstrCode::RETURN:
+  case InstrCode::CALL:
+  case InstrCode::CALL_INDIRECT:
     throw Todo{__func__};
   }
+  throw Todo{__func__};
 }
 
 } // namespace wa
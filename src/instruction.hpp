@@ -234,6 +234,18 @@ enum class InstrCode : uint16_t {
 
 std::ostream &operator<<(std::ostream &os, InstrCode code);
 
+bool is_load(InstrCode code);
+bool is_store(InstrCode code);
+/// instruction without side effects which cannot trap, so an unused result can be removed with its operands
+bool is_pure(InstrCode code);
+/// log2 of the access size of a load or store
+uint32_t get_natural_alignment(InstrCode code);
+/// binary operator where `a op b == b op a`
+bool is_commutative(InstrCode code);
+/// binary operator where `(a op b) op c == a op (b op c)`.
+/// floating point operators only qualify with `is_fast_math`, which accepts different rounding.
+bool is_associative(InstrCode code, bool is_fast_math);
+
 class FunctionType;
 
 struct Index {
@@ -263,10 +275,18 @@ public:
   void set_value(float v) { m_content = v; }
   void set_value(double v) { m_content = v; }
   void set_mem_arg(uint32_t align, uint32_t offset) { m_content = MemArg{.m_align = align, .m_offset = offset}; }
+  /// change the opcode and keep the immediate, e.g. local.set to local.tee
+  void set_code(InstrCode code) { m_code = code; }
 
   InstrCode get_code() const { return m_code; }
   uint32_t get_index() const { return std::get<Index>(m_content).m_v; }
+  /// block type of block / loop / if, signature of call_indirect
+  std::shared_ptr<FunctionType> const &get_function_type() const {
+    return std::get<std::shared_ptr<FunctionType>>(m_content);
+  }
   std::vector<Index> const &get_indexes() const { return std::get<std::vector<Index>>(m_content); }
+  template <class T> T get_value() const { return std::get<T>(m_content); }
+  MemArg const &get_mem_arg() const { return std::get<MemArg>(m_content); }
 
   size_t get_operand_count() const;
   size_t get_result_count() const;
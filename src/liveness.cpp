@@ -0,0 +1,215 @@
+#include "liveness.hpp"
+#include "adt/dyn_bit_set.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "dataflow.hpp"
+#include "debug.hpp"
+#include "dom_builder.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <ranges>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+struct GenKill {
+  DynBitSet m_gen;  // used before any definition in the block
+  DynBitSet m_kill; // defined in the block
+};
+
+class LivenessProblem {
+  size_t m_local_num;
+  std::vector<GenKill> const &m_gen_kill; // indexed by block index
+  DynBitSet m_tmp;
+
+public:
+  using Lattice = DynBitSet;
+  static constexpr DataflowDirection direction = DataflowDirection::Backward;
+
+  explicit LivenessProblem(size_t local_num, std::vector<GenKill> const &gen_kill)
+      : m_local_num(local_num), m_gen_kill(gen_kill), m_tmp(local_num) {}
+
+  DynBitSet get_boundary() const { return DynBitSet{m_local_num}; }
+  DynBitSet get_top() const { return DynBitSet{m_local_num}; }
+  void meet(DynBitSet &to, DynBitSet const &from) const { to |= from; }
+  bool transfer(size_t block_index, BasicBlock const &, DynBitSet const &live_out, DynBitSet &live_in) {
+    // live sets only grow from the initial empty set, so in-place or-assign is enough to detect changes.
+    GenKill const &gen_kill = m_gen_kill[block_index];
+    m_tmp = live_out;
+    m_tmp.and_not(gen_kill.m_kill);
+    m_tmp |= gen_kill.m_gen;
+    return live_in.or_assign_changed(m_tmp);
+  }
+};
+
+} // namespace
+
+static GenKill get_gen_kill(BasicBlock const &block, size_t local_num) {
+  GenKill gen_kill{.m_gen = DynBitSet{local_num}, .m_kill = DynBitSet{local_num}};
+  for (Instr const *instr : block.m_instr) {
+    switch (instr->get_code()) {
+    case InstrCode::LOCAL_GET:
+      if (!gen_kill.m_kill.test(instr->get_index())) {
+        gen_kill.m_gen.mask(instr->get_index());
+      }
+      break;
+    case InstrCode::LOCAL_SET:
+    case InstrCode::LOCAL_TEE:
+      gen_kill.m_kill.mask(instr->get_index());
+      break;
+    default:
+      break;
+    }
+  }
+  return gen_kill;
+}
+
+/// walk the block backward from live-out and return the largest number of simultaneously live locals.
+static size_t get_block_max_live(BasicBlock const &block, DynBitSet live) {
+  size_t live_num = live.count();
+  size_t max_live = live_num;
+  for (Instr const *instr : block.m_instr | std::views::reverse) {
+    switch (instr->get_code()) {
+    case InstrCode::LOCAL_GET:
+      if (!live.test(instr->get_index())) {
+        live.mask(instr->get_index());
+        live_num++;
+      }
+      break;
+    case InstrCode::LOCAL_SET:
+    case InstrCode::LOCAL_TEE:
+      if (live.test(instr->get_index())) {
+        live.unmask(instr->get_index());
+        live_num--;
+      }
+      break;
+    default:
+      break;
+    }
+    max_live = std::max(max_live, live_num);
+  }
+  return max_live;
+}
+
+/// natural loops from back edges `tail -> header` where header dominates tail.
+/// loops sharing a header are merged. returns header position -> loop body positions.
+static std::map<size_t, DynBitSet> get_natural_loops(BlockOrder const &order, DomBuilder const &dom_builder,
+                                                     size_t cfg_index) {
+  std::map<size_t, DynBitSet> loops{};
+  for (size_t tail = 0; tail < order.m_reachable_size; tail++) {
+    for (uint32_t header : order.m_succs[tail]) {
+      if (!dom_builder.is_dominate(cfg_index, order.get_block_index(header), order.get_block_index(tail))) {
+        continue;
+      }
+      auto [it, _] = loops.try_emplace(header, order.size());
+      DynBitSet &body = it->second;
+      body.mask(header);
+      std::vector<size_t> work_list{};
+      if (!body.test(tail)) {
+        body.mask(tail);
+        work_list.push_back(tail);
+      }
+      while (!work_list.empty()) {
+        size_t const current = work_list.back();
+        work_list.pop_back();
+        for (uint32_t pred : order.m_preds[current]) {
+          if (order.is_reachable(pred) && !body.test(pred)) {
+            body.mask(pred);
+            work_list.push_back(pred);
+          }
+        }
+      }
+    }
+  }
+  return loops;
+}
+
+static FunctionLiveness analyze_function(Module const &module, Cfg const &cfg, DomBuilder const &dom_builder,
+                                         size_t cfg_index) {
+  FunctionLiveness result{.m_function_index = cfg.m_function_index,
+                          .m_local_num = module.m_functions[cfg.m_function_index]->get_local_num()};
+
+  std::vector<GenKill> gen_kill(std::ranges::max(cfg.m_blocks | std::views::keys) + 1U);
+  for (auto const &[block_index, block] : cfg.m_blocks) {
+    gen_kill[block_index] = get_gen_kill(block, result.m_local_num);
+  }
+  LivenessProblem problem{result.m_local_num, gen_kill};
+  result.m_live = solve_dataflow(cfg, problem);
+
+  BlockOrder const &order = result.m_live.m_order;
+  std::vector<size_t> block_max_live(order.size());
+  for (size_t position = 0; position < order.size(); position++) {
+    size_t const block_index = order.get_block_index(position);
+    block_max_live[position] = get_block_max_live(cfg.m_blocks.at(block_index), result.m_live.m_out[position]);
+    result.m_max_live = std::max(result.m_max_live, block_max_live[position]);
+  }
+  for (auto const &[header, body] : get_natural_loops(order, dom_builder, cfg_index)) {
+    LoopLiveness loop{.m_header = order.get_block_index(header), .m_block_num = body.count(), .m_max_live = 0U};
+    body.for_each_set_bit(
+        [&](size_t position) { loop.m_max_live = std::max(loop.m_max_live, block_max_live[position]); });
+    result.m_loops.push_back(loop);
+  }
+  return result;
+}
+
+void Liveness::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto dom_builder = get_context()->m_analysis_manager->get_analyzer<DomBuilder>();
+  dom_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size(), FunctionLiveness{.m_function_index = 0U, .m_local_num = 0U});
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    m_functions[cfg_index] = analyze_function(module, cfgs[cfg_index], *dom_builder, cfg_index);
+  });
+
+  if (Debug::is_debug_mode()) {
+    for (FunctionLiveness const &result : m_functions) {
+      for (size_t position = 0; position < result.m_live.m_order.size(); position++) {
+        std::cout << "live of block[" << result.m_live.m_order.get_block_index(position)
+                  << "]: in=" << result.m_live.m_in[position] << " out=" << result.m_live.m_out[position] << "\n";
+      }
+    }
+  }
+}
+
+void Liveness::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto dom_builder = get_context()->m_analysis_manager->get_analyzer<DomBuilder>();
+  dom_builder->analyze(module);
+
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = analyze_function(module, cfg, *dom_builder, cfg_index);
+  });
+}
+
+void Liveness::dump_result() const {
+  for (FunctionLiveness const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] locals=" << result.m_local_num
+              << " max_live=" << result.m_max_live << "\n";
+    for (LoopLiveness const &loop : result.m_loops) {
+      std::cout << "  loop BB[" << loop.m_header << "] blocks=" << loop.m_block_num << " max_live=" << loop.m_max_live
+                << "\n";
+    }
+  }
+}
+
+std::shared_ptr<IAnalyzer> createLivenessAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<Liveness>(new Liveness(context));
+}
+
+} // namespace wa
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "adt/dyn_bit_set.hpp"
+#include "analyzer.hpp"
+#include "dataflow.hpp"
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct LoopLiveness {
+  size_t m_header;
+  size_t m_block_num;
+  size_t m_max_live;
+};
+
+struct FunctionLiveness {
+  size_t m_function_index;
+  size_t m_local_num;
+  DataflowResult<DynBitSet> m_live{}; // m_in is live-in, m_out is live-out
+  size_t m_max_live = 0U;
+  std::vector<LoopLiveness> m_loops{};
+};
+
+/// live locals (including arguments) per block, and register pressure per function and per natural loop.
+class Liveness : public IAnalyzer {
+  std::vector<FunctionLiveness> m_functions{};
+
+public:
+  explicit Liveness(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<FunctionLiveness> const &get_results() const { return m_functions; }
+  DynBitSet const &get_live_in(size_t cfg_index, size_t block_index) const {
+    return m_functions.at(cfg_index).m_live.get_in(block_index);
+  }
+  DynBitSet const &get_live_out(size_t cfg_index, size_t block_index) const {
+    return m_functions.at(cfg_index).m_live.get_out(block_index);
+  }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
@@ -1,14 +1,82 @@
 
 #include "analyzer.hpp"
 #include "args.hpp"
+#include "benchmark.hpp"
+#include "call_graph.hpp"
+#include "constant_folding.hpp"
+#include "constant_propagation.hpp"
+#include "critical_path.hpp"
+#include "dead_code.hpp"
 #include "high_frequency_sub_expr.hpp"
+#include "liveness.hpp"
 #include "parser.hpp"
+#include "pattern_file.hpp"
+#include "peephole.hpp"
+#include "stack_height.hpp"
+#include "tree_height_balancing.hpp"
+#include "value_numbering.hpp"
+#include "writer.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 using namespace wa;
 
 int main(int argc, char const *argv[]) {
   std::string wasm_file{};
   Args::get_arg_parser().add_argument("wasm file").store_into(wasm_file).required();
+  std::string output_file{};
+  Args::get_arg_parser().add_argument("--output").store_into(output_file).help("write the module to a wasm file");
+  bool is_round_trip = false;
+  Args::get_arg_parser()
+      .add_argument("--round_trip")
+      .store_into(is_round_trip)
+      .help("check that writing the unmodified module reproduces the input");
+
+  // merge pattern files written by --HighFrequencySubExpr.output
+  argparse::ArgumentParser merge_command{"merge"};
+  merge_command.add_description("merge pattern files written by --HighFrequencySubExpr.output");
+  std::vector<std::string> merge_inputs{};
+  std::string merge_output{};
+  size_t merge_num = 128U;
+  merge_command.add_argument("pattern files").store_into(merge_inputs).nargs(argparse::nargs_pattern::at_least_one);
+  merge_command.add_argument("-o", "--output").store_into(merge_output);
+  merge_command.add_argument("--num").store_into(merge_num);
+  Args::get_arg_parser().add_subparser(merge_command);
+
+  // time TreeHeightBalancing on synthetic add chains
+  argparse::ArgumentParser bench_command{"bench"};
+  bench_command.add_description("time TreeHeightBalancing on synthetic deep i32.add chains");
+  std::vector<int> bench_depths{10000, 100000};
+  size_t bench_repeat = 5U;
+  std::string bench_output{};
+  bench_command.add_argument("--depth").store_into(bench_depths).nargs(argparse::nargs_pattern::at_least_one);
+  bench_command.add_argument("--repeat").store_into(bench_repeat);
+  bench_command.add_argument("-o", "--output").store_into(bench_output).help("write the deepest chain module");
+  Args::get_arg_parser().add_subparser(bench_command);
+
+  // the required positional wasm file would swallow the sub command name
+  if (argc > 1 && std::string_view{argv[1]} == "merge") {
+    merge_command.parse_args(argc - 1, argv + 1);
+    merge_pattern_files(merge_inputs, merge_output, merge_num);
+    return 0;
+  }
+  if (argc > 1 && std::string_view{argv[1]} == "bench") {
+    bench_command.parse_args(argc - 1, argv + 1);
+    if (std::ranges::any_of(bench_depths, [](int depth) { return depth <= 0; })) {
+      throw std::runtime_error("bench --depth: depths must be positive");
+    }
+    run_tree_height_benchmark({bench_depths.begin(), bench_depths.end()}, bench_repeat, bench_output);
+    return 0;
+  }
 
   Args::get_arg_parser().parse_args(argc, argv);
 
@@ -16,9 +84,59 @@ int main(int argc, char const *argv[]) {
 
   AnalyzerManager analyzer_manager{parser.parse()};
 
+  if (is_round_trip) {
+    std::ostringstream encoded{};
+    Writer{analyzer_manager.get_module()}.write(encoded);
+    std::string const bytes = encoded.str();
+    std::optional<size_t> const difference = Writer::find_difference(
+        parser.get_binary(), std::span{reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size()});
+    if (difference.has_value()) {
+      std::cout << "round trip differs at offset " << difference.value() << " (input " << parser.get_binary().size()
+                << " bytes, output " << bytes.size() << " bytes)\n";
+      return 1;
+    }
+    std::cout << "round trip identical, " << bytes.size() << " bytes\n";
+  }
+
+  analyzer_manager.transform();
   analyzer_manager.analyze();
 
+  if (AnalyzerManager::is_ConstantFolding_active()) {
+    analyzer_manager.get_transform<ConstantFolding>()->dump_result();
+  }
+  if (AnalyzerManager::is_DeadCode_active()) {
+    analyzer_manager.get_transform<DeadCode>()->dump_result();
+  }
+  if (AnalyzerManager::is_Peephole_active()) {
+    analyzer_manager.get_transform<Peephole>()->dump_result();
+  }
+  if (AnalyzerManager::is_CallGraph_active()) {
+    analyzer_manager.get_analyzer<CallGraph>()->dump_result();
+  }
+  if (AnalyzerManager::is_ConstantPropagation_active()) {
+    analyzer_manager.get_analyzer<ConstantPropagation>()->dump_result();
+  }
+  if (AnalyzerManager::is_CriticalPath_active()) {
+    analyzer_manager.get_analyzer<CriticalPath>()->dump_result();
+  }
   if (AnalyzerManager::is_HighFrequencySubExpr_active()) {
     analyzer_manager.get_analyzer<HighFrequencySubExpr>()->dump_result();
   }
+  if (AnalyzerManager::is_Liveness_active()) {
+    analyzer_manager.get_analyzer<Liveness>()->dump_result();
+  }
+  if (AnalyzerManager::is_StackHeight_active()) {
+    analyzer_manager.get_analyzer<StackHeight>()->dump_result();
+  }
+  if (AnalyzerManager::is_TreeHeightBalancing_active()) {
+    analyzer_manager.get_analyzer<TreeHeightBalancing>()->dump_result();
+  }
+  if (AnalyzerManager::is_ValueNumbering_active()) {
+    analyzer_manager.get_analyzer<ValueNumbering>()->dump_result();
+  }
+
+  if (!output_file.empty()) {
+    std::ofstream os{output_file, std::ios::binary};
+    Writer{analyzer_manager.get_module()}.write(os);
+  }
 }
@@ -4,8 +4,11 @@
 #include "instruction.hpp"
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <span>
+#include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
@@ -18,7 +21,7 @@ enum class WasmType : uint8_t {
   F32 = 0x7D,
   F64 = 0x7C,
   V128 = 0x7B,
-  FuncRef = 0x0,
+  FuncRef = 0x70,
   ExternRef = 0x6F,
 };
 
@@ -43,6 +46,9 @@ public:
   FunctionType(std::vector<WasmType> arguments, std::vector<WasmType> results)
       : m_arguments(std::move(arguments)), m_results(std::move(results)) {}
 
+  std::vector<WasmType> const &get_arguments() const { return m_arguments; }
+  std::vector<WasmType> const &get_results() const { return m_results; }
+
   friend std::ostream &operator<<(std::ostream &os, FunctionType const &type) {
     return os << "func (" << StringOperator::join(type.m_arguments, ", ") << ") => ("
               << StringOperator::join(type.m_results, ", ") << ")";
@@ -66,23 +72,58 @@ class Function {
   std::shared_ptr<FunctionType> m_type = nullptr;
   bool m_is_import = false;
   bool m_is_export = false;
+  std::vector<WasmType> m_locals{};
   std::vector<Instr> m_instr{};
+  std::vector<uint8_t> m_encoded_body{}; // body as parsed, empty once the locals or instructions are replaced
 
 public:
   void set_type(std::shared_ptr<FunctionType> const &type) { m_type = type; }
   void set_is_import() { m_is_import = true; }
   void set_is_export() { m_is_export = true; }
-  void set_instr(std::vector<Instr> instr) { m_instr = std::move(instr); }
+  void set_locals(std::vector<WasmType> locals) {
+    m_locals = std::move(locals);
+    m_encoded_body.clear();
+  }
+  void set_instr(std::vector<Instr> instr) {
+    m_instr = std::move(instr);
+    m_encoded_body.clear();
+  }
+  void set_encoded_body(std::vector<uint8_t> encoded_body) { m_encoded_body = std::move(encoded_body); }
 
   bool is_import() const { return m_is_import; }
   bool is_export() const { return m_is_export; }
   FunctionType const *get_type() const { return m_type.get(); }
+  /// declared locals, without arguments
+  std::vector<WasmType> const &get_locals() const { return m_locals; }
+  /// size of local index space, arguments come first
+  size_t get_local_num() const { return m_type->get_arguments().size() + m_locals.size(); }
   std::span<Instr> get_instr() { return {m_instr.begin(), m_instr.size()}; }
+  /// original encoding of the unchanged body, empty if the body must be encoded from the locals and instructions
+  std::span<const uint8_t> get_encoded_body() const { return m_encoded_body; }
+};
+
+/// imported function, table, memory or global. function imports take their type from the imported `Function` in
+/// `Module::m_functions`, the descriptor of the other kinds is kept as encoded.
+struct Import {
+  std::string m_module;
+  std::string m_name;
+  uint8_t m_kind;
+  std::vector<uint8_t> m_desc{};
+};
+
+/// section in the order of the binary. sections the module models are re-encoded by the writer and have no content,
+/// the others keep their encoded content.
+struct Section {
+  uint8_t m_id;
+  std::vector<uint8_t> m_content{};
 };
 
 struct Module {
   std::vector<std::shared_ptr<FunctionType>> m_function_types{};
   std::vector<std::shared_ptr<Function>> m_functions{};
+  std::vector<Import> m_imports{};
+  std::vector<Section> m_sections{};
+  std::optional<uint32_t> m_start_function{}; // index in m_functions
 };
 
 } // namespace wa
@@ -264,6 +264,7 @@ static void parse_import_section(Module &m, std::span<const uint8_t> binary) {
     std::string mod = consume_name(binary);
     std::string nm = consume_name(binary);
     uint8_t const import_desc_kind = consume_byte(binary);
+    std::span<const uint8_t> const desc = binary;
     switch (import_desc_kind) {
     case 0: {
       uint32_t const type_index = consume_leb128<uint32_t>(binary);
@@ -287,6 +288,10 @@ static void parse_import_section(Module &m, std::span<const uint8_t> binary) {
     default:
       throw std::runtime_error("invalid import desc kind");
     }
+    Import &import = m.m_imports.emplace_back(std::move(mod), std::move(nm), import_desc_kind);
+    if (import_desc_kind != 0) {
+      import.m_desc.assign(desc.begin(), binary.begin());
+    }
   }
 }
 
@@ -305,7 +310,25 @@ static void parse_memory_section(Module &m, std::span<const uint8_t> binary) {}
 
 static void parse_global_section(Module &m, std::span<const uint8_t> binary) {}
 
-static void parse_export_section(Module &m, std::span<const uint8_t> binary) {}
+static void parse_export_section(Module &m, std::span<const uint8_t> binary) {
+  uint32_t const n = consume_leb128<uint32_t>(binary);
+  for (size_t i : Range{n}) {
+    consume_name(binary);
+    uint8_t const export_desc_kind = consume_byte(binary);
+    uint32_t const index = consume_leb128<uint32_t>(binary);
+    if (export_desc_kind == 0) {
+      m.m_functions.at(index)->set_is_export();
+    }
+  }
+}
+
+static void parse_start_section(Module &m, std::span<const uint8_t> binary) {
+  uint32_t const index = consume_leb128<uint32_t>(binary);
+  if (index >= m.m_functions.size()) {
+    throw std::runtime_error("invalid start function index");
+  }
+  m.m_start_function = index;
+}
 
 static void parse_element_section(Module &m, std::span<const uint8_t> binary) {}
 
@@ -324,7 +347,7 @@ static std::shared_ptr<FunctionType> consume_block_type(Module const &m, std::sp
   case WasmType::V128:
   case WasmType::FuncRef:
   case WasmType::ExternRef:
-    forked_binary = binary;
+    binary = forked_binary;
     return std::make_shared<FunctionType>(std::vector<WasmType>{}, std::vector<WasmType>{static_cast<WasmType>(byte)});
     break;
   }
@@ -591,7 +614,7 @@ static Instr consume_instr(Module const &m, std::span<const uint8_t> &binary) {
   return instr;
 }
 
-static std::vector<Instr> consume_code(Module const &m, std::span<const uint8_t> binary) {
+static void consume_code(Module const &m, Function &fn, std::span<const uint8_t> binary) {
   size_t const local_size = static_cast<size_t>(consume_leb128<uint32_t>(binary));
   std::vector<WasmType> locals{};
   for (size_t i : Range{local_size}) {
@@ -607,7 +630,8 @@ static std::vector<Instr> consume_code(Module const &m, std::span<const uint8_t>
   if (instr.empty() || instr.back().get_code() != InstrCode::END)
     throw std::runtime_error("code does not end with OP::END");
 
-  return instr;
+  fn.set_locals(std::move(locals));
+  fn.set_instr(std::move(instr));
 }
 
 static void parse_code_section(Module &m, std::span<const uint8_t> binary) {
@@ -622,7 +646,9 @@ static void parse_code_section(Module &m, std::span<const uint8_t> binary) {
     uint32_t const size = consume_leb128<uint32_t>(binary);
     std::span<const uint8_t> code_binary = binary.subspan(0, size);
 
-    m.m_functions[importFuncNumber + i]->set_instr(consume_code(m, code_binary));
+    Function &fn = *m.m_functions[importFuncNumber + i];
+    consume_code(m, fn, code_binary);
+    fn.set_encoded_body({code_binary.begin(), code_binary.end()});
 
     binary = binary.subspan(size);
   }
@@ -641,6 +667,17 @@ Module Parser::parse() {
 
   while (!binary.empty()) {
     auto const [kind, span] = consume_section(binary);
+    Section &section = m.m_sections.emplace_back(static_cast<uint8_t>(kind));
+    switch (kind) {
+    case SectionKind::TypeSection:
+    case SectionKind::ImportSection:
+    case SectionKind::FunctionSection:
+    case SectionKind::CodeSection:
+      break;
+    default:
+      section.m_content.assign(span.begin(), span.end());
+      break;
+    }
     switch (kind) {
     case SectionKind::TypeSection:
       parse_type_section(m, span);
@@ -663,6 +700,9 @@ Module Parser::parse() {
     case SectionKind::ExportSection:
       parse_export_section(m, span);
       break;
+    case SectionKind::StartSection:
+      parse_start_section(m, span);
+      break;
     case SectionKind::ElementSection:
       parse_element_section(m, span);
       break;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "module.hpp"
+#include <cstdint>
 #include <vector>
 
 namespace wa {
@@ -12,6 +13,8 @@ public:
   Parser(const char *path);
 
   Module parse();
+
+  std::vector<uint8_t> const &get_binary() const { return m_binary; }
 };
 
 } // namespace wa
@@ -0,0 +1,245 @@
+#include "pattern_file.hpp"
+#include "adt/string.hpp"
+#include "high_frequency_sub_expr.hpp"
+#include "instruction.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace wa {
+
+static constexpr std::array<char, 4U> magic{'W', 'A', 'P', 'S'};
+static constexpr uint32_t version = 1U;
+
+static void write_uleb(std::ostream &os, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7FU;
+    value >>= 7U;
+    if (value != 0U) {
+      byte |= 0x80U;
+    }
+    os.put(static_cast<char>(byte));
+  } while (value != 0U);
+}
+
+static uint8_t read_byte(std::istream &is) {
+  std::istream::int_type const byte = is.rdbuf()->sbumpc();
+  if (byte == std::istream::traits_type::eof()) {
+    throw std::runtime_error("invalid pattern file: unexpected end");
+  }
+  return static_cast<uint8_t>(byte);
+}
+
+static uint64_t read_uleb(std::istream &is) {
+  uint64_t value = 0U;
+  for (uint32_t shift = 0U; shift < 64U; shift += 7U) {
+    uint8_t const byte = read_byte(is);
+    value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+    if ((byte & 0x80U) == 0U) {
+      return value;
+    }
+  }
+  throw std::runtime_error("invalid pattern file: leb128 too long");
+}
+
+static ImmediateClass read_immediate_class(std::istream &is) {
+  ImmediateClass const immediate_class = static_cast<ImmediateClass>(read_byte(is));
+  if (immediate_class > ImmediateClass::MemArgClass) {
+    throw std::runtime_error("invalid pattern file: bad immediate class");
+  }
+  return immediate_class;
+}
+
+PatternFileWriter::PatternFileWriter(std::ostream &os, PatternFileSettings const &settings, uint64_t total_instr_num)
+    : m_os(os) {
+  m_os.write(magic.data(), magic.size());
+  for (uint32_t i = 0; i < 4U; i++) {
+    m_os.put(static_cast<char>((version >> (8U * i)) & 0xFFU));
+  }
+  write_uleb(m_os, settings.m_depth);
+  for (ImmediateClass const immediate_class :
+       {settings.m_const, settings.m_local, settings.m_memarg, settings.m_index}) {
+    m_os.put(static_cast<char>(immediate_class));
+  }
+  m_os.put(static_cast<char>(settings.m_weight));
+  write_uleb(m_os, settings.m_loop_base);
+  write_uleb(m_os, total_instr_num);
+}
+
+void PatternFileWriter::write(std::span<PatternKey const> path, uint64_t count) {
+  if (path.empty() || !std::ranges::lexicographical_compare(m_last_path, path)) {
+    throw std::invalid_argument("pattern file: paths must be non-empty and strictly increasing");
+  }
+  size_t const prefix = static_cast<size_t>(std::ranges::mismatch(m_last_path, path).in2 - path.begin());
+  write_uleb(m_os, prefix);
+  write_uleb(m_os, path.size() - prefix);
+  for (PatternKey const &key : path.subspan(prefix)) {
+    write_uleb(m_os, static_cast<uint64_t>(key.m_code));
+    m_os.put(static_cast<char>(key.m_class));
+    if (key.m_class != ImmediateClass::None) {
+      write_uleb(m_os, key.m_value);
+    }
+  }
+  write_uleb(m_os, count);
+  m_last_path.assign(path.begin(), path.end());
+}
+
+void PatternFileWriter::finish() {
+  write_uleb(m_os, 0U);
+  write_uleb(m_os, 0U);
+  m_os.flush();
+}
+
+PatternFileReader::PatternFileReader(std::istream &is) : m_is(is) {
+  std::array<char, 4U> file_magic{};
+  for (char &c : file_magic) {
+    c = static_cast<char>(read_byte(m_is));
+  }
+  uint32_t file_version = 0U;
+  for (uint32_t i = 0; i < 4U; i++) {
+    file_version |= static_cast<uint32_t>(read_byte(m_is)) << (8U * i);
+  }
+  if (file_magic != magic || file_version != version) {
+    throw std::runtime_error("invalid pattern file: bad magic or version");
+  }
+  m_settings.m_depth = read_uleb(m_is);
+  m_settings.m_const = read_immediate_class(m_is);
+  m_settings.m_local = read_immediate_class(m_is);
+  m_settings.m_memarg = read_immediate_class(m_is);
+  m_settings.m_index = read_immediate_class(m_is);
+  m_settings.m_weight = static_cast<BlockWeightKind>(read_byte(m_is));
+  if (m_settings.m_weight > BlockWeightKind::Profile) {
+    throw std::runtime_error("invalid pattern file: bad block weight kind");
+  }
+  m_settings.m_loop_base = read_uleb(m_is);
+  m_total_instr_num = read_uleb(m_is);
+}
+
+bool PatternFileReader::next() {
+  uint64_t const prefix = read_uleb(m_is);
+  uint64_t const suffix = read_uleb(m_is);
+  if (suffix == 0U) {
+    return false;
+  }
+  if (prefix > m_path.size()) {
+    throw std::runtime_error("invalid pattern file: bad prefix length");
+  }
+  m_path.resize(prefix);
+  for (uint64_t i = 0; i < suffix; i++) {
+    PatternKey key{.m_code = static_cast<InstrCode>(read_uleb(m_is))};
+    key.m_class = read_immediate_class(m_is);
+    if (key.m_class != ImmediateClass::None) {
+      key.m_value = read_uleb(m_is);
+    }
+    m_path.push_back(key);
+  }
+  m_count = read_uleb(m_is);
+  return true;
+}
+
+void merge_pattern_files(std::vector<std::string> const &inputs, std::string const &output, size_t num) {
+  std::vector<std::unique_ptr<std::ifstream>> files{};
+  std::vector<PatternFileReader> readers{};
+  readers.reserve(inputs.size());
+  uint64_t total_instr_num = 0U;
+  for (std::string const &input : inputs) {
+    files.push_back(std::make_unique<std::ifstream>(input, std::ios::binary | std::ios::in));
+    if (!files.back()->is_open()) {
+      throw std::runtime_error("cannot open " + input);
+    }
+    readers.emplace_back(*files.back());
+    if (readers.back().get_settings() != readers.front().get_settings()) {
+      throw std::runtime_error("cannot merge " + input + " into " + inputs.front() +
+                               ": mined with different --HighFrequencySubExpr.depth, immediate modes or weight");
+    }
+    total_instr_num += readers.back().get_total_instr_num();
+  }
+
+  std::ofstream output_file{};
+  std::unique_ptr<PatternFileWriter> writer = nullptr;
+  if (!output.empty()) {
+    output_file.open(output, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!output_file.is_open()) {
+      throw std::runtime_error("cannot open " + output);
+    }
+    writer = std::make_unique<PatternFileWriter>(output_file, readers.front().get_settings(), total_instr_num);
+  }
+
+  // readers with a pending record, the smallest path on the top
+  auto const reader_greater = [&readers](size_t l, size_t r) { return readers[r].get_path() < readers[l].get_path(); };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(reader_greater)> pending{reader_greater};
+  for (size_t i = 0; i < readers.size(); i++) {
+    if (readers[i].next()) {
+      pending.push(i);
+    }
+  }
+
+  // same ranking as HighFrequencySubExpr::get_top_patterns: count, then lexicographic order which is the merge order
+  struct Candidate {
+    uint64_t m_count;
+    size_t m_order;
+    std::vector<PatternKey> m_path;
+    bool operator<(Candidate const &o) const {
+      return m_count != o.m_count ? m_count > o.m_count : m_order < o.m_order;
+    }
+  };
+  std::priority_queue<Candidate> top{};
+  size_t order = 0U;
+  std::vector<PatternKey> path{};
+  while (!pending.empty()) {
+    size_t const first = pending.top();
+    pending.pop();
+    path = readers[first].get_path();
+    uint64_t count = readers[first].get_count();
+    if (readers[first].next()) {
+      pending.push(first);
+    }
+    while (!pending.empty() && readers[pending.top()].get_path() == path) {
+      size_t const same = pending.top();
+      pending.pop();
+      count += readers[same].get_count();
+      if (readers[same].next()) {
+        pending.push(same);
+      }
+    }
+    if (writer != nullptr) {
+      writer->write(path, count);
+    }
+    if (num > 0U && (top.size() < num || count > top.top().m_count)) {
+      top.push(Candidate{.m_count = count, .m_order = order, .m_path = path});
+      if (top.size() > num) {
+        top.pop();
+      }
+    }
+    order++;
+  }
+  if (writer != nullptr) {
+    writer->finish();
+  }
+
+  std::vector<Candidate> results{};
+  while (!top.empty()) {
+    results.push_back(top.top());
+    top.pop();
+  }
+  for (Candidate const &result : results | std::views::reverse) {
+    std::cout << StringOperator::join(result.m_path, ", ") << ": "
+              << (static_cast<double>(result.m_count) / static_cast<double>(total_instr_num) * 100) << "%\n";
+  }
+}
+
+} // namespace wa
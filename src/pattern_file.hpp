@@ -0,0 +1,68 @@
+#pragma once
+
+#include "high_frequency_sub_expr.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wa {
+
+/// HighFrequencySubExpr options which decide the paths, keys and count weights of a pattern file. counts mined with
+/// different settings do not describe the same patterns, so only files with equal settings are merged.
+struct PatternFileSettings {
+  uint64_t m_depth;
+  ImmediateClass m_const;
+  ImmediateClass m_local;
+  ImmediateClass m_memarg;
+  ImmediateClass m_index;
+  BlockWeightKind m_weight;
+  uint64_t m_loop_base; // 0 if the blocks are not weighted
+
+  bool operator==(PatternFileSettings const &o) const = default;
+};
+
+/// binary file of n-gram counts.
+///   header: magic "WAPS", u32 version, uleb depth, u8 immediate class of const / local / memarg / index,
+///           u8 block weight kind, uleb loop base, uleb total instruction number (weighted like the counts)
+///   records in strictly increasing lexicographic order of the path:
+///     uleb shared prefix length with the previous path, uleb suffix length, suffix keys, uleb count
+///     key: uleb instruction code, u8 immediate class, uleb immediate value unless the class is None
+///   end: a record with empty suffix
+class PatternFileWriter {
+  std::ostream &m_os;
+  std::vector<PatternKey> m_last_path{};
+
+public:
+  PatternFileWriter(std::ostream &os, PatternFileSettings const &settings, uint64_t total_instr_num);
+
+  void write(std::span<PatternKey const> path, uint64_t count);
+  void finish();
+};
+
+class PatternFileReader {
+  std::istream &m_is;
+  PatternFileSettings m_settings;
+  uint64_t m_total_instr_num;
+  std::vector<PatternKey> m_path{};
+  uint64_t m_count = 0U;
+
+public:
+  explicit PatternFileReader(std::istream &is);
+
+  PatternFileSettings const &get_settings() const { return m_settings; }
+  uint64_t get_total_instr_num() const { return m_total_instr_num; }
+  /// move to the next record, false at the end of the file
+  bool next();
+  std::vector<PatternKey> const &get_path() const { return m_path; }
+  uint64_t get_count() const { return m_count; }
+};
+
+/// streaming k-way merge of pattern files with equal settings. the merged counts are written to `output` unless it
+/// is empty, and the `num` most frequent patterns are printed.
+void merge_pattern_files(std::vector<std::string> const &inputs, std::string const &output, size_t num);
+
+} // namespace wa
@@ -0,0 +1,310 @@
+#include "peephole.hpp"
+#include "adt/flat_trie.hpp"
+#include "analyzer.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <set>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+/// condition on the immediates of the matched instructions
+enum class Condition : uint8_t {
+  None,
+  SameLocal, // instruction 0 and 1 access the same local
+  Zero,      // constant of instruction 0 is 0
+  One,       // constant of instruction 0 is 1
+  AllOnes,   // constant of instruction 0 is -1
+};
+
+/// instruction of a replacement, copy of the matched instruction at m_source with the opcode changed to m_code
+struct Emit {
+  InstrCode m_code;
+  size_t m_source;
+};
+
+struct Rule {
+  std::string_view m_name;
+  std::vector<InstrCode> m_pattern;
+  Condition m_condition;
+  std::vector<Emit> m_replacement; // every rule is shorter than its pattern, so rewriting terminates
+};
+
+std::vector<Rule> const &get_rules() {
+  using enum InstrCode;
+  static std::vector<Rule> const rules{
+      {"local.set x; local.get x -> local.tee x", {LOCAL_SET, LOCAL_GET}, Condition::SameLocal, {{LOCAL_TEE, 0U}}},
+      {"local.tee x; drop -> local.set x", {LOCAL_TEE, DROP}, Condition::None, {{LOCAL_SET, 0U}}},
+      {"local.get x; local.set x -> (none)", {LOCAL_GET, LOCAL_SET}, Condition::SameLocal, {}},
+      {"local.get; drop -> (none)", {LOCAL_GET, DROP}, Condition::None, {}},
+      {"i32.const; drop -> (none)", {I32_CONST, DROP}, Condition::None, {}},
+      {"i64.const; drop -> (none)", {I64_CONST, DROP}, Condition::None, {}},
+      {"f32.const; drop -> (none)", {F32_CONST, DROP}, Condition::None, {}},
+      {"f64.const; drop -> (none)", {F64_CONST, DROP}, Condition::None, {}},
+      {"i32.const 0; i32.add -> (none)", {I32_CONST, I32_ADD}, Condition::Zero, {}},
+      {"i32.const 0; i32.sub -> (none)", {I32_CONST, I32_SUB}, Condition::Zero, {}},
+      {"i32.const 0; i32.or -> (none)", {I32_CONST, I32_OR}, Condition::Zero, {}},
+      {"i32.const 0; i32.xor -> (none)", {I32_CONST, I32_XOR}, Condition::Zero, {}},
+      {"i32.const 0; i32.shl -> (none)", {I32_CONST, I32_SHL}, Condition::Zero, {}},
+      {"i32.const 0; i32.shr_s -> (none)", {I32_CONST, I32_SHR_S}, Condition::Zero, {}},
+      {"i32.const 0; i32.shr_u -> (none)", {I32_CONST, I32_SHR_U}, Condition::Zero, {}},
+      {"i32.const 1; i32.mul -> (none)", {I32_CONST, I32_MUL}, Condition::One, {}},
+      {"i32.const 1; i32.div_s -> (none)", {I32_CONST, I32_DIV_S}, Condition::One, {}},
+      {"i32.const 1; i32.div_u -> (none)", {I32_CONST, I32_DIV_U}, Condition::One, {}},
+      {"i32.const -1; i32.and -> (none)", {I32_CONST, I32_AND}, Condition::AllOnes, {}},
+      {"i64.const 0; i64.add -> (none)", {I64_CONST, I64_ADD}, Condition::Zero, {}},
+      {"i64.const 0; i64.sub -> (none)", {I64_CONST, I64_SUB}, Condition::Zero, {}},
+      {"i64.const 0; i64.or -> (none)", {I64_CONST, I64_OR}, Condition::Zero, {}},
+      {"i64.const 0; i64.xor -> (none)", {I64_CONST, I64_XOR}, Condition::Zero, {}},
+      {"i64.const 0; i64.shl -> (none)", {I64_CONST, I64_SHL}, Condition::Zero, {}},
+      {"i64.const 0; i64.shr_s -> (none)", {I64_CONST, I64_SHR_S}, Condition::Zero, {}},
+      {"i64.const 0; i64.shr_u -> (none)", {I64_CONST, I64_SHR_U}, Condition::Zero, {}},
+      {"i64.const 1; i64.mul -> (none)", {I64_CONST, I64_MUL}, Condition::One, {}},
+      {"i64.const 1; i64.div_s -> (none)", {I64_CONST, I64_DIV_S}, Condition::One, {}},
+      {"i64.const 1; i64.div_u -> (none)", {I64_CONST, I64_DIV_U}, Condition::One, {}},
+      {"i64.const -1; i64.and -> (none)", {I64_CONST, I64_AND}, Condition::AllOnes, {}},
+      {"i32.const 0; i32.eq -> i32.eqz", {I32_CONST, I32_EQ}, Condition::Zero, {{I32_EQZ, 1U}}},
+      {"i64.const 0; i64.eq -> i64.eqz", {I64_CONST, I64_EQ}, Condition::Zero, {{I64_EQZ, 1U}}},
+      {"i32.const 0; i32.ne; br_if -> br_if", {I32_CONST, I32_NE, BR_IF}, Condition::Zero, {{BR_IF, 2U}}},
+      {"i32.const 0; i32.ne; if -> if", {I32_CONST, I32_NE, IF}, Condition::Zero, {{IF, 2U}}},
+      {"i32.eqz; i32.eqz; br_if -> br_if", {I32_EQZ, I32_EQZ, BR_IF}, Condition::None, {{BR_IF, 2U}}},
+      {"i32.eqz; i32.eqz; if -> if", {I32_EQZ, I32_EQZ, IF}, Condition::None, {{IF, 2U}}},
+      {"i32.eqz; i32.eqz; select -> select", {I32_EQZ, I32_EQZ, SELECT}, Condition::None, {{SELECT, 2U}}},
+      {"nop -> (none)", {NOP}, Condition::None, {}},
+  };
+  return rules;
+}
+
+bool is_satisfied(Condition condition, Instr const *matched) {
+  auto get_constant = [](Instr const &instr) -> int64_t {
+    return instr.get_code() == InstrCode::I32_CONST ? instr.get_value<int32_t>() : instr.get_value<int64_t>();
+  };
+  switch (condition) {
+  case Condition::None:
+    return true;
+  case Condition::SameLocal:
+    return matched[0].get_index() == matched[1].get_index();
+  case Condition::Zero:
+    return get_constant(matched[0]) == 0;
+  case Condition::One:
+    return get_constant(matched[0]) == 1;
+  case Condition::AllOnes:
+    return get_constant(matched[0]) == -1;
+  }
+  return false;
+}
+
+/// block, loop, else and end start a new basic block and take no part in patterns
+bool is_block_delimiter(InstrCode code) {
+  return code == InstrCode::BLOCK || code == InstrCode::LOOP || code == InstrCode::ELSE || code == InstrCode::END;
+}
+
+/// branches end a basic block, they may end a pattern
+bool is_block_terminator(InstrCode code) {
+  switch (code) {
+  case InstrCode::UNREACHABLE:
+  case InstrCode::IF:
+  case InstrCode::BR:
+  case InstrCode::BR_IF:
+  case InstrCode::BR_TABLE:
+  case InstrCode::RETURN:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Aho-Corasick automaton of the rule patterns. the goto function is a trie of the patterns, the failure link of a
+/// state is the longest proper suffix of its path which is also a trie path.
+class RuleAutomaton {
+  using Trie = FlatTrie<InstrCode, std::vector<size_t>>;
+  using State = Trie::NodeIndex;
+
+  Trie m_trie{};
+  std::vector<State> m_fail{};
+  std::vector<State> m_output{}; // nearest state on the failure chain which ends a pattern
+
+public:
+  struct Match {
+    size_t m_start;
+    size_t m_rule;
+  };
+
+  explicit RuleAutomaton(std::vector<Rule> const &rules) {
+    for (size_t rule = 0; rule < rules.size(); rule++) {
+      State state = Trie::root;
+      for (InstrCode code : rules[rule].m_pattern) {
+        state = m_trie.get_or_insert_child(state, code);
+      }
+      std::optional<std::vector<size_t>> &value = m_trie.value(state);
+      if (!value.has_value()) {
+        value.emplace();
+      }
+      value->push_back(rule);
+    }
+    m_fail.assign(m_trie.size(), Trie::root);
+    m_output.assign(m_trie.size(), Trie::invalid_node);
+    // breadth first, the failure target of a state is shallower and therefore finished
+    std::queue<State> queue{};
+    m_trie.for_each_child(Trie::root, [&queue](InstrCode, State child) { queue.push(child); });
+    while (!queue.empty()) {
+      State const state = queue.front();
+      queue.pop();
+      m_trie.for_each_child(state, [&](InstrCode code, State child) {
+        State const fail = next(m_fail[state], code);
+        m_fail[child] = fail;
+        m_output[child] = m_trie.value(fail).has_value() ? fail : m_output[fail];
+        queue.push(child);
+      });
+    }
+  }
+
+  /// leftmost non-overlapping matches in `instr`, the longest satisfied rule wins among those ending at the same
+  /// instruction. `hits` is incremented per accepted match.
+  void find_matches(std::vector<Rule> const &rules, std::span<Instr const> instr, std::vector<Match> &matches,
+                    std::vector<uint64_t> &hits) const {
+    State state = Trie::root;
+    size_t matched_end = 0U; // matches may not overlap an accepted one
+    for (size_t i = 0; i < instr.size(); i++) {
+      InstrCode const code = instr[i].get_code();
+      if (is_block_delimiter(code)) {
+        state = Trie::root;
+        matched_end = i + 1U;
+        continue;
+      }
+      state = next(state, code);
+      for (State s = m_trie.value(state).has_value() ? state : m_output[state]; s != Trie::invalid_node;
+           s = m_output[s]) {
+        std::optional<size_t> const rule = find_rule(rules, instr, i, *m_trie.value(s), matched_end);
+        if (rule.has_value()) {
+          matches.push_back(Match{.m_start = i + 1U - rules[*rule].m_pattern.size(), .m_rule = *rule});
+          hits[*rule]++;
+          matched_end = i + 1U;
+          break;
+        }
+      }
+      if (is_block_terminator(code)) {
+        state = Trie::root;
+        matched_end = i + 1U;
+      }
+    }
+  }
+
+private:
+  State next(State state, InstrCode code) const {
+    while (true) {
+      State const child = m_trie.find_child(state, code);
+      if (child != Trie::invalid_node) {
+        return child;
+      }
+      if (state == Trie::root) {
+        return Trie::root;
+      }
+      state = m_fail[state];
+    }
+  }
+
+  static std::optional<size_t> find_rule(std::vector<Rule> const &rules, std::span<Instr const> instr, size_t last,
+                                         std::vector<size_t> const &candidates, size_t matched_end) {
+    for (size_t rule : candidates) {
+      size_t const length = rules[rule].m_pattern.size();
+      if (last + 1U < matched_end + length) {
+        // all candidates of a state have the same length
+        return std::nullopt;
+      }
+      if (is_satisfied(rules[rule].m_condition, &instr[last + 1U - length])) {
+        return rule;
+      }
+    }
+    return std::nullopt;
+  }
+};
+
+} // namespace
+
+PreservedAnalyses Peephole::run(Module &module, std::set<size_t> &changed_functions) {
+  std::vector<Rule> const &rules = get_rules();
+  RuleAutomaton const automaton{rules};
+
+  struct FunctionResult {
+    std::vector<uint64_t> m_hits;
+    size_t m_removed_instr_num = 0U;
+  };
+  std::vector<FunctionResult> results(module.m_functions.size(), FunctionResult{std::vector<uint64_t>(rules.size())});
+  ThreadPool::for_each(module.m_functions.size(), [&](size_t function_index) {
+    Function &fn = *module.m_functions[function_index];
+    if (fn.is_import()) {
+      return;
+    }
+    FunctionResult &result = results[function_index];
+    std::vector<RuleAutomaton::Match> matches{};
+    // a rewrite can expose new matches, e.g. `local.get; i32.const 0; i32.add; drop`
+    while (true) {
+      std::span<Instr const> const instr = fn.get_instr();
+      matches.clear();
+      automaton.find_matches(rules, instr, matches, result.m_hits);
+      if (matches.empty()) {
+        break;
+      }
+      std::vector<Instr> rewritten{};
+      rewritten.reserve(instr.size());
+      size_t position = 0U;
+      for (RuleAutomaton::Match const &match : matches) {
+        rewritten.insert(rewritten.end(), instr.begin() + position, instr.begin() + match.m_start);
+        for (Emit const &emit : rules[match.m_rule].m_replacement) {
+          rewritten.push_back(instr[match.m_start + emit.m_source]);
+          rewritten.back().set_code(emit.m_code);
+        }
+        position = match.m_start + rules[match.m_rule].m_pattern.size();
+      }
+      rewritten.insert(rewritten.end(), instr.begin() + position, instr.end());
+      result.m_removed_instr_num += instr.size() - rewritten.size();
+      fn.set_instr(std::move(rewritten));
+    }
+  });
+
+  m_hits.assign(rules.size(), 0U);
+  m_removed_instr_num = 0U;
+  for (size_t function_index = 0; function_index < results.size(); function_index++) {
+    FunctionResult const &result = results[function_index];
+    if (result.m_removed_instr_num == 0U) {
+      continue;
+    }
+    changed_functions.insert(function_index);
+    m_removed_instr_num += result.m_removed_instr_num;
+    std::ranges::transform(m_hits, result.m_hits, m_hits.begin(), std::plus<>{});
+  }
+  m_changed_function_num = changed_functions.size();
+  return PreservedAnalyses::none();
+}
+
+void Peephole::dump_result() const {
+  std::vector<Rule> const &rules = get_rules();
+  std::vector<size_t> order(m_hits.size());
+  std::iota(order.begin(), order.end(), 0U);
+  std::ranges::stable_sort(order, std::greater<>{}, [this](size_t rule) { return m_hits[rule]; });
+  for (size_t rule : order) {
+    std::cout << rules[rule].m_name << " hits=" << m_hits[rule] << "\n";
+  }
+  std::cout << "removed " << m_removed_instr_num << " instructions in " << m_changed_function_num << " functions\n";
+}
+
+std::shared_ptr<ITransform> createPeepholeTransform(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<Peephole>(new Peephole(context));
+}
+
+} // namespace wa
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "module.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+/// rewrites short wasteful instruction sequences inside basic blocks, e.g. `local.set x; local.get x` to
+/// `local.tee x`. all rules are compiled into one Aho-Corasick automaton over InstrCode, so each block is scanned
+/// once regardless of the number of rules. functions are rewritten until no rule matches.
+class Peephole : public ITransform {
+  std::vector<uint64_t> m_hits{}; // indexed by rule
+  size_t m_removed_instr_num = 0U;
+  size_t m_changed_function_num = 0U;
+
+public:
+  explicit Peephole(std::shared_ptr<AnalyzerContext> const &context) : ITransform(context) {}
+
+  PreservedAnalyses run(Module &module, std::set<size_t> &changed_functions) override;
+
+  void dump_result() const;
+};
+
+} // namespace wa
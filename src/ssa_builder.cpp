@@ -0,0 +1,431 @@
+#include "ssa_builder.hpp"
+#include "adt/scoped_hash_map.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "constant.hpp"
+#include "dataflow.hpp"
+#include "debug.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+/// immediate dominators by Cooper, Harvey and Kennedy over the reverse post order, indexed by position.
+/// only reachable positions have a dominator, the entry is its own dominator.
+std::vector<uint32_t> compute_idoms(BlockOrder const &order) {
+  constexpr uint32_t undefined = static_cast<uint32_t>(-1);
+  std::vector<uint32_t> idoms(order.m_reachable_size, undefined);
+  if (idoms.empty()) {
+    return idoms;
+  }
+  idoms[0] = 0U;
+  auto const intersect = [&idoms](uint32_t a, uint32_t b) {
+    while (a != b) {
+      while (a > b) {
+        a = idoms[a];
+      }
+      while (b > a) {
+        b = idoms[b];
+      }
+    }
+    return a;
+  };
+  bool is_changed = true;
+  while (is_changed) {
+    is_changed = false;
+    for (size_t position = 1; position < order.m_reachable_size; position++) {
+      uint32_t idom = undefined;
+      for (uint32_t pred : order.m_preds[position]) {
+        if (!order.is_reachable(pred) || idoms[pred] == undefined) {
+          continue;
+        }
+        idom = idom == undefined ? pred : intersect(pred, idom);
+      }
+      if (idoms[position] != idom) {
+        idoms[position] = idom;
+        is_changed = true;
+      }
+    }
+  }
+  return idoms;
+}
+
+/// dominance frontiers indexed by position, only join points can be in a frontier
+std::vector<std::vector<uint32_t>> compute_frontiers(BlockOrder const &order, std::vector<uint32_t> const &idoms) {
+  std::vector<std::vector<uint32_t>> frontiers(order.m_reachable_size);
+  for (size_t position = 0; position < order.m_reachable_size; position++) {
+    if (order.m_preds[position].size() < 2U) {
+      continue;
+    }
+    for (uint32_t pred : order.m_preds[position]) {
+      if (!order.is_reachable(pred)) {
+        continue;
+      }
+      for (uint32_t runner = pred; runner != idoms[position]; runner = idoms[runner]) {
+        if (frontiers[runner].empty() || frontiers[runner].back() != position) {
+          frontiers[runner].push_back(static_cast<uint32_t>(position));
+        }
+      }
+    }
+  }
+  return frontiers;
+}
+
+class SsaBuilderImpl {
+  Module const &m_module;
+  Cfg const &m_cfg;
+  Function const &m_function;
+  SsaFunction m_ssa{};
+  std::vector<SsaValueId> m_stack{};
+  ScopedHashMap<uint32_t, SsaValueId> m_locals{};
+
+public:
+  SsaBuilderImpl(Module const &module, Cfg const &cfg)
+      : m_module(module), m_cfg(cfg), m_function(*module.m_functions[cfg.m_function_index]) {}
+
+  SsaFunction build() {
+    m_ssa.m_function_index = m_cfg.m_function_index;
+    m_ssa.m_order = BlockOrder::create(m_cfg);
+    m_ssa.m_blocks.resize(m_ssa.m_order.size());
+    std::vector<uint32_t> const idoms = compute_idoms(m_ssa.m_order);
+    place_phis(compute_frontiers(m_ssa.m_order, idoms));
+    rename(idoms);
+    build_users();
+    return std::move(m_ssa);
+  }
+
+private:
+  BasicBlock const &get_block(size_t position) const {
+    return m_cfg.m_blocks.at(m_ssa.m_order.get_block_index(position));
+  }
+
+  SsaValueId create_value(SsaValue value, size_t operand_num) {
+    value.m_operand_begin = static_cast<uint32_t>(m_ssa.m_operands.size());
+    value.m_operand_num = static_cast<uint32_t>(operand_num);
+    m_ssa.m_operands.resize(m_ssa.m_operands.size() + operand_num);
+    m_ssa.m_values.push_back(value);
+    return static_cast<SsaValueId>(m_ssa.m_values.size() - 1U);
+  }
+
+  SsaValueId create_unknown(uint32_t block) {
+    return create_value(SsaValue{.m_kind = SsaValueKind::Unknown, .m_block = block}, 0U);
+  }
+
+  /// semi-pruned placement, locals which are set before every read in each block never need a phi
+  void place_phis(std::vector<std::vector<uint32_t>> const &frontiers) {
+    BlockOrder const &order = m_ssa.m_order;
+    size_t const local_num = m_function.get_local_num();
+    std::vector<std::vector<uint32_t>> def_blocks(local_num);
+    std::vector<bool> is_live_across(local_num, false);
+    std::vector<uint32_t> set_in_block(local_num, static_cast<uint32_t>(-1));
+    for (size_t position = 0; position < order.m_reachable_size; position++) {
+      for (Instr const *instr : get_block(position).m_instr) {
+        InstrCode const code = instr->get_code();
+        if (code == InstrCode::LOCAL_GET) {
+          is_live_across[instr->get_index()] = is_live_across[instr->get_index()] ||
+                                               set_in_block[instr->get_index()] != position;
+        } else if (code == InstrCode::LOCAL_SET || code == InstrCode::LOCAL_TEE) {
+          if (set_in_block[instr->get_index()] != position) {
+            set_in_block[instr->get_index()] = static_cast<uint32_t>(position);
+            def_blocks[instr->get_index()].push_back(static_cast<uint32_t>(position));
+          }
+        }
+      }
+    }
+
+    // marks are the local index + 1 of the last local which put the block into the work list or placed a phi
+    std::vector<uint32_t> has_phi(order.m_reachable_size, 0U);
+    std::vector<uint32_t> in_work_list(order.m_reachable_size, 0U);
+    std::vector<uint32_t> work_list{};
+    for (uint32_t local = 0; local < local_num; local++) {
+      if (!is_live_across[local]) {
+        continue;
+      }
+      uint32_t const mark = local + 1U;
+      work_list = def_blocks[local];
+      for (uint32_t position : work_list) {
+        in_work_list[position] = mark;
+      }
+      while (!work_list.empty()) {
+        uint32_t const position = work_list.back();
+        work_list.pop_back();
+        for (uint32_t frontier : frontiers[position]) {
+          if (has_phi[frontier] == mark) {
+            continue;
+          }
+          has_phi[frontier] = mark;
+          size_t const operand_num = order.m_preds[frontier].size();
+          m_ssa.m_blocks[frontier].m_phis.push_back(create_value(
+              SsaValue{.m_kind = SsaValueKind::Phi, .m_local = local, .m_block = frontier}, operand_num));
+          if (in_work_list[frontier] != mark) {
+            in_work_list[frontier] = mark;
+            work_list.push_back(frontier);
+          }
+        }
+      }
+    }
+  }
+
+  /// depth first walk of the dominator tree, each tree edge opens a new scope of the current local values
+  void rename(std::vector<uint32_t> const &idoms) {
+    BlockOrder const &order = m_ssa.m_order;
+    if (order.m_reachable_size == 0U) {
+      return;
+    }
+    std::vector<std::vector<uint32_t>> children(order.m_reachable_size);
+    for (uint32_t position = 1; position < order.m_reachable_size; position++) {
+      children[idoms[position]].push_back(position);
+    }
+    // operands of phis on edges from unreachable blocks
+    SsaValueId const unreachable = create_unknown(0U);
+    std::ranges::fill(m_ssa.m_operands, unreachable);
+
+    std::vector<WasmType> const &arguments = m_function.get_type()->get_arguments();
+    for (uint32_t local = 0; local < arguments.size(); local++) {
+      m_locals.insert_outermost(local, create_unknown(0U));
+    }
+    uint32_t local = static_cast<uint32_t>(arguments.size());
+    for (WasmType type : m_function.get_locals()) {
+      std::optional<Constant> const zero = get_zero(type);
+      SsaValueId const value =
+          zero.has_value() ? create_value(SsaValue{.m_kind = SsaValueKind::Constant, .m_constant = zero.value()}, 0U)
+                           : create_unknown(0U);
+      m_locals.insert_outermost(local++, value);
+    }
+
+    struct Frame {
+      uint32_t m_position;
+      size_t m_next_child = 0U;
+    };
+    std::vector<Frame> frames{};
+    auto const enter = [&](uint32_t position) {
+      m_locals.push_scope();
+      rename_block(position);
+      frames.push_back(Frame{.m_position = position});
+    };
+    enter(0U);
+    while (!frames.empty()) {
+      Frame &frame = frames.back();
+      if (frame.m_next_child == children[frame.m_position].size()) {
+        m_locals.pop_scope();
+        frames.pop_back();
+        continue;
+      }
+      enter(children[frame.m_position][frame.m_next_child++]);
+    }
+  }
+
+  static std::optional<Constant> get_zero(WasmType type) {
+    switch (type) {
+    case WasmType::I32:
+      return Constant::from_i32(0U);
+    case WasmType::I64:
+      return Constant::from_i64(0U);
+    case WasmType::F32:
+      return Constant::from_f32(0.0F);
+    case WasmType::F64:
+      return Constant::from_f64(0.0);
+    default:
+      return std::nullopt;
+    }
+  }
+
+  SsaValueId pop(uint32_t block) {
+    if (m_stack.empty()) {
+      // produced in another block
+      return create_unknown(block);
+    }
+    SsaValueId const value = m_stack.back();
+    m_stack.pop_back();
+    return value;
+  }
+
+  void pop(uint32_t block, size_t num) {
+    for (size_t i = 0; i < num; i++) {
+      pop(block);
+    }
+  }
+
+  void push_unknown(uint32_t block, size_t num) {
+    for (size_t i = 0; i < num; i++) {
+      m_stack.push_back(create_unknown(block));
+    }
+  }
+
+  void push_instr(Instr const &instr, uint32_t block) {
+    size_t const operand_num = instr.get_operand_count();
+    SsaValue const ssa_value{.m_kind = SsaValueKind::Instr, .m_code = instr.get_code(), .m_block = block};
+    SsaValueId const value = create_value(ssa_value, operand_num);
+    uint32_t const begin = m_ssa.m_values[value].m_operand_begin;
+    for (size_t i = operand_num; i > 0; i--) {
+      SsaValueId const operand = pop(block);
+      m_ssa.m_operands[begin + i - 1U] = operand;
+    }
+    m_ssa.m_blocks[block].m_values.push_back(value);
+    m_stack.push_back(value);
+  }
+
+  void call(FunctionType const &type, uint32_t block) {
+    pop(block, type.get_arguments().size());
+    push_unknown(block, type.get_results().size());
+  }
+
+  void rename_block(uint32_t position) {
+    SsaBlock &block = m_ssa.m_blocks[position];
+    for (SsaValueId phi : block.m_phis) {
+      m_locals.insert_or_assign(m_ssa.m_values[phi].m_local, phi);
+    }
+    m_stack.clear();
+    for (Instr const *instr : get_block(position).m_instr) {
+      InstrCode const code = instr->get_code();
+      switch (code) {
+      case InstrCode::NOP:
+      case InstrCode::BLOCK:
+      case InstrCode::LOOP:
+      case InstrCode::ELSE:
+      case InstrCode::END:
+        break;
+      case InstrCode::UNREACHABLE:
+      case InstrCode::RETURN:
+      case InstrCode::BR:
+        m_stack.clear();
+        break;
+      case InstrCode::IF:
+      case InstrCode::BR_IF:
+        m_ssa.m_blocks[position].m_condition = pop(position);
+        break;
+      case InstrCode::BR_TABLE:
+      case InstrCode::DROP:
+      case InstrCode::GLOBAL_SET:
+        pop(position);
+        break;
+      case InstrCode::I32_CONST:
+      case InstrCode::I64_CONST:
+      case InstrCode::F32_CONST:
+      case InstrCode::F64_CONST: {
+        SsaValueId const value = create_value(
+            SsaValue{.m_kind = SsaValueKind::Constant, .m_block = position, .m_constant = get_constant(*instr).value()},
+            0U);
+        m_ssa.m_blocks[position].m_values.push_back(value);
+        m_stack.push_back(value);
+        break;
+      }
+      case InstrCode::LOCAL_GET: {
+        SsaValueId const value = *m_locals.find(instr->get_index());
+        m_ssa.m_local_gets.push_back(
+            SsaLocalAccess{.m_local = instr->get_index(), .m_block = position, .m_value = value});
+        m_stack.push_back(value);
+        break;
+      }
+      case InstrCode::LOCAL_SET:
+      case InstrCode::LOCAL_TEE: {
+        SsaValueId const value = pop(position);
+        m_locals.insert_or_assign(instr->get_index(), value);
+        m_ssa.m_local_sets.push_back(
+            SsaLocalAccess{.m_local = instr->get_index(), .m_block = position, .m_value = value});
+        if (code == InstrCode::LOCAL_TEE) {
+          m_stack.push_back(value);
+        }
+        break;
+      }
+      case InstrCode::CALL:
+        call(*m_module.m_functions.at(instr->get_index())->get_type(), position);
+        break;
+      case InstrCode::CALL_INDIRECT:
+        pop(position);
+        call(*instr->get_function_type(), position);
+        break;
+      default:
+        if (is_load(code) || is_store(code) || code == InstrCode::GLOBAL_GET || code == InstrCode::MEMORY_SIZE ||
+            code == InstrCode::MEMORY_GROW || instr->get_result_count() != 1U) {
+          pop(position, instr->get_operand_count());
+          push_unknown(position, instr->get_result_count());
+        } else {
+          push_instr(*instr, position);
+        }
+        break;
+      }
+    }
+    // current local values flow into the phis of the successors
+    BlockOrder const &order = m_ssa.m_order;
+    for (uint32_t succ : order.m_succs[position]) {
+      std::vector<uint32_t> const &preds = order.m_preds[succ];
+      size_t const pred_index = static_cast<size_t>(std::ranges::find(preds, position) - preds.begin());
+      for (SsaValueId phi : m_ssa.m_blocks[succ].m_phis) {
+        SsaValue const &phi_value = m_ssa.m_values[phi];
+        m_ssa.m_operands[phi_value.m_operand_begin + pred_index] = *m_locals.find(phi_value.m_local);
+      }
+    }
+  }
+
+  /// def-use chains in compressed rows
+  void build_users() {
+    size_t const value_num = m_ssa.m_values.size();
+    m_ssa.m_user_begins.assign(value_num + 1U, 0U);
+    for (SsaValueId operand : m_ssa.m_operands) {
+      m_ssa.m_user_begins[operand + 1U]++;
+    }
+    for (size_t value = 0; value < value_num; value++) {
+      m_ssa.m_user_begins[value + 1U] += m_ssa.m_user_begins[value];
+    }
+    m_ssa.m_users.resize(m_ssa.m_operands.size());
+    std::vector<uint32_t> next(m_ssa.m_user_begins.begin(), m_ssa.m_user_begins.end() - 1);
+    for (SsaValueId value = 0; value < value_num; value++) {
+      for (SsaValueId operand : m_ssa.get_operands(value)) {
+        m_ssa.m_users[next[operand]++] = value;
+      }
+    }
+  }
+};
+
+} // namespace
+
+void SsaBuilder::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    m_functions[cfg_index] = SsaBuilderImpl{module, cfgs[cfg_index]}.build();
+  });
+
+  if (Debug::is_debug_mode()) {
+    for (SsaFunction const &ssa : m_functions) {
+      size_t phi_num = 0U;
+      for (SsaBlock const &block : ssa.m_blocks) {
+        phi_num += block.m_phis.size();
+      }
+      std::cout << "ssa of function[" << ssa.m_function_index << "]: values=" << ssa.m_values.size()
+                << " phis=" << phi_num << "\n";
+    }
+  }
+}
+
+void SsaBuilder::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = SsaBuilderImpl{module, cfg}.build();
+  });
+}
+
+std::shared_ptr<IAnalyzer> createSsaBuilderAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<SsaBuilder>(new SsaBuilder(context));
+}
+
+} // namespace wa
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include "constant.hpp"
+#include "dataflow.hpp"
+#include "instruction.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <set>
+#include <span>
+#include <vector>
+
+namespace wa {
+
+/// index in SsaFunction::m_values
+using SsaValueId = uint32_t;
+
+enum class SsaValueKind : uint8_t {
+  Unknown,  // argument, or produced by memory, globals, calls or the operand stack of another block
+  Constant, // const instruction, or the zero of a declared local at function entry
+  Instr,    // pure instruction of m_code over the operands
+  Phi,      // local m_local at the entry of m_block, operands in the order of the block predecessors
+};
+
+struct SsaValue {
+  SsaValueKind m_kind;
+  InstrCode m_code = InstrCode::NOP;
+  uint32_t m_local = 0U;
+  uint32_t m_block = 0U; // position in SsaFunction::m_order
+  uint32_t m_operand_begin = 0U;
+  uint32_t m_operand_num = 0U;
+  Constant m_constant{.m_type = WasmType::I32, .m_bits = 0U};
+};
+
+struct SsaBlock {
+  static constexpr SsaValueId no_condition = std::numeric_limits<SsaValueId>::max();
+
+  std::vector<SsaValueId> m_phis{};
+  std::vector<SsaValueId> m_values{}; // non phi values in instruction order
+  SsaValueId m_condition = no_condition; // operand of a trailing `if` / `br_if`
+};
+
+/// local.get or local.set / local.tee of `m_local` in `m_block`, `m_value` is the value read or written
+struct SsaLocalAccess {
+  uint32_t m_local;
+  uint32_t m_block;
+  SsaValueId m_value;
+};
+
+/// ssa form of the locals of one function. values on the operand stack are already in ssa form, only locals need
+/// phis. blocks which are not reachable from the entry have no values.
+struct SsaFunction {
+  size_t m_function_index = 0U;
+  BlockOrder m_order{};
+  std::vector<SsaBlock> m_blocks{}; // indexed by position
+  std::vector<SsaValue> m_values{};
+  std::vector<SsaValueId> m_operands{};
+  std::vector<uint32_t> m_user_begins{}; // users of value v are m_users[m_user_begins[v], m_user_begins[v + 1])
+  std::vector<SsaValueId> m_users{};
+  std::vector<SsaLocalAccess> m_local_gets{};
+  std::vector<SsaLocalAccess> m_local_sets{};
+
+  std::span<SsaValueId const> get_operands(SsaValueId value) const {
+    return std::span{m_operands}.subspan(m_values[value].m_operand_begin, m_values[value].m_operand_num);
+  }
+  std::span<SsaValueId const> get_users(SsaValueId value) const {
+    return std::span{m_users}.subspan(m_user_begins[value], m_user_begins[value + 1U] - m_user_begins[value]);
+  }
+};
+
+/// builds semi-pruned ssa for wasm locals. phis are placed at the iterated dominance frontiers of the blocks which
+/// set a local, for locals which are read before being set in some block.
+class SsaBuilder : public IAnalyzer {
+  std::vector<SsaFunction> m_functions{}; // indexed by cfg index
+
+public:
+  explicit SsaBuilder(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  SsaFunction const &get_ssa(size_t cfg_index) const { return m_functions.at(cfg_index); }
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
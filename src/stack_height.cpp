@@ -0,0 +1,207 @@
+#include "stack_height.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "debug.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+struct ControlFrame {
+  size_t m_param_num;
+  size_t m_result_num;
+  size_t m_height; // operand stack height below the parameters
+  bool m_is_unreachable = false;
+};
+
+class StackHeightImpl {
+  Module const &m_module;
+  std::vector<ControlFrame> m_frames{};
+  size_t m_height = 0U;
+  size_t m_max_height = 0U;
+
+public:
+  explicit StackHeightImpl(Module const &module) : m_module(module) {}
+
+  FunctionStackHeight get(Function &fn) {
+    FunctionStackHeight result{};
+    std::span<Instr> instrs = fn.get_instr();
+    result.m_instr_heights.reserve(instrs.size());
+    m_frames.push_back(
+        ControlFrame{.m_param_num = 0U, .m_result_num = fn.get_type()->get_results().size(), .m_height = 0U});
+    for (Instr const &instr : instrs) {
+      result.m_instr_heights.push_back(static_cast<uint32_t>(m_height));
+      step(instr);
+    }
+    if (!m_frames.empty()) {
+      throw std::runtime_error("unbalanced control frames");
+    }
+    result.m_max_height = m_max_height;
+    return result;
+  }
+
+private:
+  void push(size_t n) {
+    m_height += n;
+    m_max_height = std::max(m_max_height, m_height);
+  }
+  void pop(size_t n) {
+    ControlFrame const &frame = m_frames.back();
+    if (m_height >= frame.m_height + n) {
+      m_height -= n;
+      return;
+    }
+    // operands of unreachable code can come from the polymorphic stack
+    if (!frame.m_is_unreachable) {
+      throw std::runtime_error("operand stack underflow");
+    }
+    m_height = frame.m_height;
+  }
+  void set_unreachable() {
+    m_height = m_frames.back().m_height;
+    m_frames.back().m_is_unreachable = true;
+  }
+  void enter(FunctionType const &type) {
+    size_t const param_num = type.get_arguments().size();
+    pop(param_num);
+    m_frames.push_back(
+        ControlFrame{.m_param_num = param_num, .m_result_num = type.get_results().size(), .m_height = m_height});
+    push(param_num);
+  }
+  void call(FunctionType const &type) {
+    pop(type.get_arguments().size());
+    push(type.get_results().size());
+  }
+
+  void step(Instr const &instr) {
+    switch (instr.get_code()) {
+    case InstrCode::UNREACHABLE:
+    case InstrCode::RETURN:
+    case InstrCode::BR:
+      set_unreachable();
+      break;
+    case InstrCode::BR_TABLE:
+      pop(1U);
+      set_unreachable();
+      break;
+    case InstrCode::BR_IF:
+      // values of the label stay on the stack when the branch is not taken
+      pop(1U);
+      break;
+    case InstrCode::BLOCK:
+    case InstrCode::LOOP:
+      enter(*instr.get_function_type());
+      break;
+    case InstrCode::IF:
+      pop(1U);
+      enter(*instr.get_function_type());
+      break;
+    case InstrCode::ELSE: {
+      ControlFrame &frame = m_frames.back();
+      m_height = frame.m_height;
+      frame.m_is_unreachable = false;
+      push(frame.m_param_num);
+      break;
+    }
+    case InstrCode::END: {
+      ControlFrame const frame = m_frames.back();
+      m_frames.pop_back();
+      m_height = frame.m_height;
+      push(frame.m_result_num);
+      break;
+    }
+    case InstrCode::CALL:
+      call(*m_module.m_functions.at(instr.get_index())->get_type());
+      break;
+    case InstrCode::CALL_INDIRECT:
+      pop(1U);
+      call(*instr.get_function_type());
+      break;
+    default:
+      pop(instr.get_operand_count());
+      push(instr.get_result_count());
+      break;
+    }
+  }
+};
+
+} // namespace
+
+static FunctionStackHeight analyze_function(Module const &module, Cfg const &cfg) {
+  Function &fn = *module.m_functions[cfg.m_function_index];
+  FunctionStackHeight result = StackHeightImpl{module}.get(fn);
+  result.m_function_index = cfg.m_function_index;
+
+  Instr const *const first_instr = fn.get_instr().data();
+  for (auto const &[block_index, block] : cfg.m_blocks) {
+    if (block.m_instr.empty()) {
+      continue;
+    }
+    size_t const first = static_cast<size_t>(block.m_instr.front() - first_instr);
+    size_t const last = static_cast<size_t>(block.m_instr.back() - first_instr);
+    // height after the last instruction is the height before the next one, the function always ends with `end`
+    result.m_blocks.push_back(BlockStackHeight{.m_block_index = block_index,
+                                               .m_entry_height = result.m_instr_heights[first],
+                                               .m_exit_height = result.m_instr_heights[last + 1U]});
+  }
+  return result;
+}
+
+void StackHeight::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(),
+                       [&](size_t cfg_index) { m_functions[cfg_index] = analyze_function(module, cfgs[cfg_index]); });
+
+  if (Debug::is_debug_mode()) {
+    for (FunctionStackHeight const &result : m_functions) {
+      std::span<Instr> instrs = module.m_functions[result.m_function_index]->get_instr();
+      std::cout << "stack height of function[" << result.m_function_index << "]\n";
+      for (size_t i = 0; i < instrs.size(); i++) {
+        std::cout << "  [" << result.m_instr_heights[i] << "] " << instrs[i] << "\n";
+      }
+    }
+  }
+}
+
+void StackHeight::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = analyze_function(module, cfg);
+  });
+}
+
+void StackHeight::dump_result() const {
+  for (FunctionStackHeight const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] max_stack=" << result.m_max_height << "\n";
+    for (BlockStackHeight const &block : result.m_blocks) {
+      std::cout << "  BB[" << block.m_block_index << "] entry=" << block.m_entry_height
+                << " exit=" << block.m_exit_height << "\n";
+    }
+  }
+}
+
+std::shared_ptr<IAnalyzer> createStackHeightAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<StackHeight>(new StackHeight(context));
+}
+
+} // namespace wa
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct BlockStackHeight {
+  size_t m_block_index;
+  size_t m_entry_height;
+  size_t m_exit_height;
+};
+
+struct FunctionStackHeight {
+  size_t m_function_index;
+  size_t m_max_height = 0U;
+  std::vector<uint32_t> m_instr_heights{}; // operand stack height before each instruction
+  std::vector<BlockStackHeight> m_blocks{};
+};
+
+/// operand stack height at each instruction and maximum operand stack depth per function, in values.
+class StackHeight : public IAnalyzer {
+  std::vector<FunctionStackHeight> m_functions{};
+
+public:
+  explicit StackHeight(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<FunctionStackHeight> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
@@ -0,0 +1,117 @@
+#include "thread_pool.hpp"
+#include "args.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace wa {
+
+static const Arg<size_t> jobs{"--jobs", 0U};
+
+static thread_local bool is_inside_job = false;
+
+ThreadPool::ThreadPool(size_t thread_num) {
+  // the caller is one of the threads
+  for (size_t i = 1; i < thread_num; i++) {
+    m_workers.emplace_back([this]() { worker_loop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_is_stopped = true;
+  }
+  m_job_cv.notify_all();
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::get() {
+  static ThreadPool pool{get_thread_num()};
+  return pool;
+}
+
+size_t ThreadPool::get_thread_num() {
+  if (jobs != 0U) {
+    return jobs;
+  }
+  return std::max<size_t>(1U, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::run(Job &job) {
+  is_inside_job = true;
+  while (true) {
+    size_t const index = job.m_next.fetch_add(1U);
+    if (index >= job.m_size) {
+      break;
+    }
+    try {
+      (*job.m_fn)(index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{job.m_error_mutex};
+      if (job.m_error == nullptr) {
+        job.m_error = std::current_exception();
+      }
+    }
+  }
+  is_inside_job = false;
+}
+
+void ThreadPool::worker_loop() {
+  size_t seen_generation = 0U;
+  while (true) {
+    Job *job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock{m_mutex};
+      m_job_cv.wait(lock, [&]() { return m_is_stopped || (m_job != nullptr && m_job_generation != seen_generation); });
+      if (m_is_stopped) {
+        return;
+      }
+      seen_generation = m_job_generation;
+      job = m_job;
+      m_active_worker_num++;
+    }
+    run(*job);
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_active_worker_num--;
+    }
+    m_done_cv.notify_all();
+  }
+}
+
+void ThreadPool::parallel_for(size_t size, std::function<void(size_t)> const &fn) {
+  if (size == 0U) {
+    return;
+  }
+  if (m_workers.empty() || size == 1U || is_inside_job) {
+    for (size_t i = 0; i < size; i++) {
+      fn(i);
+    }
+    return;
+  }
+  Job job{.m_fn = &fn, .m_size = size};
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_job = &job;
+    m_job_generation++;
+  }
+  m_job_cv.notify_all();
+  run(job);
+  {
+    // every index is claimed now, stop new workers from joining and wait for the running ones.
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_job = nullptr;
+    m_done_cv.wait(lock, [&]() { return m_active_worker_num == 0U; });
+  }
+  if (job.m_error != nullptr) {
+    std::rethrow_exception(job.m_error);
+  }
+}
+
+} // namespace wa
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "concept.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wa {
+
+/// persistent worker threads shared by all analyzers.
+/// the calling thread takes part in every job, so a nested parallel_for degrades to a serial loop instead of
+/// dead-locking.
+class ThreadPool {
+  struct Job {
+    std::function<void(size_t)> const *m_fn = nullptr;
+    size_t m_size = 0U;
+    std::atomic<size_t> m_next{0U};
+    std::exception_ptr m_error = nullptr;
+    std::mutex m_error_mutex{};
+  };
+
+  std::vector<std::thread> m_workers{};
+  std::mutex m_mutex{};
+  std::condition_variable m_job_cv{};
+  std::condition_variable m_done_cv{};
+  Job *m_job = nullptr;
+  size_t m_active_worker_num = 0U;
+  size_t m_job_generation = 0U;
+  bool m_is_stopped = false;
+
+  explicit ThreadPool(size_t thread_num);
+  void worker_loop();
+  void run(Job &job);
+
+public:
+  ~ThreadPool();
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  static ThreadPool &get();
+  static size_t get_thread_num();
+
+  void parallel_for(size_t size, std::function<void(size_t)> const &fn);
+
+  template <Callable<void, size_t> Fn> static void for_each(size_t size, Fn const &fn) {
+    get().parallel_for(size, std::function<void(size_t)>{fn});
+  }
+};
+
+} // namespace wa
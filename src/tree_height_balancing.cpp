@@ -1,255 +1,400 @@
 #include "tree_height_balancing.hpp"
-#include "adt/binary_tree.hpp"
-#include "adt/range.hpp"
-#include "adt/y_combinator.hpp"
 #include "analyzer.hpp"
+#include "args.hpp"
 #include "basic_block_builder.hpp"
 #include "cfg.hpp"
 #include "debug.hpp"
-#include "error.hpp"
 #include "instruction.hpp"
 #include "module.hpp"
 #include <algorithm>
-#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <ostream>
 #include <ranges>
 #include <set>
-#include <stack>
-#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace wa {
 
+static const Arg<bool> fast_math{"--TreeHeightBalancing.fast_math", false}; // reassociate float add/mul/min/max
+
+static bool is_reassociable(InstrCode code) { return is_commutative(code) && is_associative(code, fast_math); }
+
 namespace {
 
-struct TreeVec {
-  std::vector<Instr const *> m_instructions{};
-};
+using NodeIndex = uint32_t;
+constexpr NodeIndex invalid_node = std::numeric_limits<NodeIndex>::max();
 
-struct TreeInfo {
-  Instr const *m_instr;
+struct TreeNode {
+  Instr const *m_instr; // nullptr for a value which enters the block on the operand stack
+  // ready time of the value. leaves know it from the block, operators get it from balancing and are -1 before.
   int32_t m_rank;
-};
+  NodeIndex m_l = invalid_node; // operands of operators
+  NodeIndex m_r = invalid_node;
 
-} // namespace
+  bool is_operator() const { return m_l != invalid_node; }
+  bool is_balanced() const { return m_rank >= 0; }
+};
 
-static void dump_tree(BinaryTree<TreeInfo> const &tree) {
-  make_y_combinator([&tree](auto self, size_t index, size_t indent) -> void {
-    TreeNode<TreeInfo> const &node = tree.at(index);
-    bool const has_l = node.m_l != tree_node_invalid_value;
-    bool const has_r = node.m_r != tree_node_invalid_value;
-    for (size_t i : Range{indent})
-      std::cout << "  ";
-    std::cout << *node.m_value.m_instr << "\n";
-    if (has_l)
-      self(node.m_l, indent + 1);
-    if (has_r)
-      self(node.m_r, indent + 1);
-  })(tree.get_root(), 0);
-
-  size_t height = make_y_combinator([&tree](auto self, size_t index) -> size_t {
-    TreeNode<TreeInfo> const &node = tree.at(index);
-    bool const has_l = node.m_l != tree_node_invalid_value;
-    bool const has_r = node.m_r != tree_node_invalid_value;
-    return 1U + std::max(has_l ? self(node.m_l) : 0, has_r ? self(node.m_r) : 0);
-  })(tree.get_root());
-  std::cout << "tree height is " << height << "\n";
+std::ostream &operator<<(std::ostream &os, TreeNode const &node) {
+  if (node.m_instr == nullptr) {
+    return os << "<block input>";
+  }
+  return os << *node.m_instr;
 }
-static auto transformer(TreeVec const &vec) -> BinaryTree<TreeInfo> {
-  assert(!vec.m_instructions.empty());
-  BinaryTree<TreeInfo> tree{};
-  size_t const root = tree.create_root(TreeInfo{.m_instr = vec.m_instructions.back(), .m_rank = -1});
-  struct StackElement {
-    size_t m_missed_operand_count;
-    size_t m_result_count;
-    size_t m_tree_index;
-
-    explicit StackElement(Instr const *instr, size_t tree_index)
-        : m_missed_operand_count(instr->get_operand_count()), m_result_count(instr->get_result_count()),
-          m_tree_index(tree_index) {}
+
+/// every expression tree of a block lives in one arena, nodes refer to each other by index.
+/// balancing is iterative and only uses scratch buffers which keep their capacity across trees and blocks.
+class TreeArena {
+  struct WorkItem {
+    NodeIndex m_node;
+    Instr const *m_parent;
   };
-  std::stack<StackElement> missed_operand_count_stack{};
-  missed_operand_count_stack.push(StackElement{vec.m_instructions.back(), root});
-  for (Instr const *instr : vec.m_instructions | std::views::reverse | std::views::drop(1)) {
-    auto const get_direction = [](size_t missed_operand_count) -> BinaryTree<TreeInfo>::Direction {
-      switch (missed_operand_count) {
-      case 1:
-        return BinaryTree<TreeInfo>::Direction::R;
-      case 2:
-        return BinaryTree<TreeInfo>::Direction::L;
-      default:
-        throw std::runtime_error(__PRETTY_FUNCTION__);
+
+  std::vector<TreeNode> m_nodes{};
+  // scratch buffers
+  std::vector<WorkItem> m_work_list{};
+  std::vector<NodeIndex> m_roots{};
+  std::vector<NodeIndex> m_operands{};   // min-heap on rank
+  std::vector<NodeIndex> m_free_slots{}; // operator nodes which can be relinked
+  std::vector<int32_t> m_heights{};
+
+public:
+  void clear() { m_nodes.clear(); }
+
+  TreeNode const &at(NodeIndex index) const { return m_nodes[index]; }
+
+  NodeIndex create_leaf(Instr const *instr, int32_t rank) {
+    m_nodes.push_back(TreeNode{.m_instr = instr, .m_rank = rank});
+    return static_cast<NodeIndex>(m_nodes.size() - 1U);
+  }
+  NodeIndex create_operator(Instr const *instr, NodeIndex l, NodeIndex r) {
+    m_nodes.push_back(TreeNode{.m_instr = instr, .m_rank = -1, .m_l = l, .m_r = r});
+    return static_cast<NodeIndex>(m_nodes.size() - 1U);
+  }
+
+  /// relink the unbalanced tree of `root` with minimal height and return the ready time of the root
+  int32_t balance(NodeIndex root) {
+    if (Debug::is_debug_mode()) {
+      std::cout << "========================= BEFORE TREE HEIGHT BALANCING =============================\n";
+      dump(root, get_unbalanced_height(root));
+      std::cout << "========================= ============================ =============================\n";
+    }
+    // an operator whose parent is a different operator roots its own tree. reversed pre order rebuilds every such
+    // tree before the tree using it as an operand.
+    m_roots.clear();
+    m_work_list.assign(1U, WorkItem{.m_node = root, .m_parent = nullptr});
+    while (!m_work_list.empty()) {
+      WorkItem const item = m_work_list.back();
+      m_work_list.pop_back();
+      TreeNode const &node = m_nodes[item.m_node];
+      if (!node.is_operator() || node.is_balanced()) {
+        continue;
       }
-    };
-    auto top = [&]() -> StackElement & { return missed_operand_count_stack.top(); };
-    size_t const index = tree.create_node(TreeInfo{.m_instr = instr, .m_rank = -1}, top().m_tree_index,
-                                          get_direction(top().m_missed_operand_count));
-    top().m_missed_operand_count -= instr->get_result_count();
-    while (!missed_operand_count_stack.empty() && top().m_missed_operand_count == 0) {
-      missed_operand_count_stack.pop();
+      if (item.m_parent == nullptr || item.m_parent->get_code() != node.m_instr->get_code()) {
+        m_roots.push_back(item.m_node);
+      }
+      m_work_list.push_back(WorkItem{.m_node = node.m_r, .m_parent = node.m_instr});
+      m_work_list.push_back(WorkItem{.m_node = node.m_l, .m_parent = node.m_instr});
     }
-    if (instr->get_operand_count() != 0) {
-      missed_operand_count_stack.push(StackElement{instr, index});
+    for (NodeIndex const tree_root : m_roots | std::views::reverse) {
+      rebuild(tree_root);
     }
+    if (Debug::is_debug_mode()) {
+      std::cout << "========================== AFTER TREE HEIGHT BALANCING =============================\n";
+      dump(root, m_nodes[root].m_rank);
+      std::cout << "========================== =========================== =============================\n";
+    }
+    return m_nodes[root].m_rank;
   }
-  assert(missed_operand_count_stack.empty());
-  if (Debug::is_debug_mode()) {
-    std::cout << "========================= BEFORE TREE HEIGHT BALANCING =============================\n";
-    dump_tree(tree);
-    std::cout << "========================= ============================ =============================\n";
-  }
-  return tree;
-}
 
-static auto convert(BasicBlock const &block) -> std::vector<BinaryTree<TreeInfo>> {
-  // FIXME(full support)
-  static const std::set<InstrCode> tree_node{// value
-                                             InstrCode::GLOBAL_GET, InstrCode::I32_CONST,
-                                             // operator
-                                             InstrCode::I32_MUL, InstrCode::I32_ADD};
-  std::vector<TreeVec> tree_vectors{};
-  tree_vectors.push_back({});
-  for (Instr const *instr : block.m_instr) {
-    if (tree_node.contains(instr->get_code())) {
-      tree_vectors.back().m_instructions.push_back(instr);
-    } else {
-      if (!tree_vectors.back().m_instructions.empty()) {
-        tree_vectors.push_back({});
+private:
+  /// collect the operands of the operator chain below `root` and combine the two earliest ready ones until one is
+  /// left, which gives the minimal ready time of the root. the operator nodes of the chain are reused.
+  void rebuild(NodeIndex root) {
+    InstrCode const code = m_nodes[root].m_instr->get_code();
+    m_operands.clear();
+    m_free_slots.clear();
+    m_work_list.clear();
+    m_work_list.push_back(WorkItem{.m_node = m_nodes[root].m_r, .m_parent = nullptr});
+    m_work_list.push_back(WorkItem{.m_node = m_nodes[root].m_l, .m_parent = nullptr});
+    while (!m_work_list.empty()) {
+      NodeIndex const index = m_work_list.back().m_node;
+      m_work_list.pop_back();
+      TreeNode const &node = m_nodes[index];
+      if (node.is_operator() && !node.is_balanced() && node.m_instr->get_code() == code) {
+        m_free_slots.push_back(index);
+        m_work_list.push_back(WorkItem{.m_node = node.m_r, .m_parent = nullptr});
+        m_work_list.push_back(WorkItem{.m_node = node.m_l, .m_parent = nullptr});
+      } else {
+        // leaves and trees of other operators, which are already rebuilt
+        m_operands.push_back(index);
+      }
+    }
+    auto const is_later = [this](NodeIndex a, NodeIndex b) { return m_nodes[a].m_rank > m_nodes[b].m_rank; };
+    auto const pop = [&]() {
+      std::ranges::pop_heap(m_operands, is_later);
+      NodeIndex const index = m_operands.back();
+      m_operands.pop_back();
+      return index;
+    };
+    std::ranges::make_heap(m_operands, is_later);
+    while (true) {
+      NodeIndex const l = pop();
+      NodeIndex const r = pop();
+      if (Debug::is_debug_mode()) {
+        std::cout << "combine " << m_nodes[l] << " " << m_nodes[r] << "\n";
+      }
+      NodeIndex const slot = m_operands.empty() ? root : m_free_slots.back();
+      m_nodes[slot].m_l = l;
+      m_nodes[slot].m_r = r;
+      m_nodes[slot].m_rank = 1 + std::max(m_nodes[l].m_rank, m_nodes[r].m_rank);
+      if (slot == root) {
+        return;
       }
+      m_free_slots.pop_back();
+      m_operands.push_back(slot);
+      std::ranges::push_heap(m_operands, is_later);
     }
   }
-  return tree_vectors | std::views::filter([](TreeVec const &vec) -> bool { return !vec.m_instructions.empty(); }) |
-         std::views::transform(transformer) | std::ranges::to<std::vector>();
-}
 
-namespace {
-struct ScalePriorityComparison {
-  static bool operator()(size_t a, size_t b) {
-    // To avoid nest recursive, here smaller scale root should be process firstly.
-    // we assume index less means scale larger.
-    bool const is_scale_a_larger_than_b = a < b;
-    bool const is_swap_a_b = is_scale_a_larger_than_b;
-    return is_swap_a_b;
+  int32_t get_unbalanced_height(NodeIndex root) {
+    // operands are created before their operators, so increasing indices visit operands first
+    m_heights.assign(root + 1U, 0);
+    for (NodeIndex index = 0; index <= root; index++) {
+      TreeNode const &node = m_nodes[index];
+      m_heights[index] = node.is_operator() && !node.is_balanced()
+                             ? 1 + std::max(m_heights[node.m_l], m_heights[node.m_r])
+                             : std::max(node.m_rank, 0);
+    }
+    return m_heights[root];
+  }
+
+  void dump(NodeIndex root, int32_t height) const {
+    std::vector<std::pair<NodeIndex, size_t>> work_list{{root, 0U}};
+    while (!work_list.empty()) {
+      auto const [index, indent] = work_list.back();
+      work_list.pop_back();
+      std::cout << std::string(indent * 2U, ' ') << m_nodes[index] << "\n";
+      if (m_nodes[index].is_operator()) {
+        work_list.emplace_back(m_nodes[index].m_r, indent + 1U);
+        work_list.emplace_back(m_nodes[index].m_l, indent + 1U);
+      }
+    }
+    std::cout << "tree height is " << height << "\n";
   }
 };
-using NodeIndex = size_t;
-using RootsQueue = std::priority_queue<NodeIndex, std::vector<NodeIndex>, ScalePriorityComparison>;
-struct RankPriorityComparison {
-  BinaryTree<TreeInfo> const &m_tree;
-  static int32_t get_value_rank(size_t index, BinaryTree<TreeInfo> const &tree) {
-    InstrCode code = tree.get_value(index).m_instr->get_code();
-    if (code == InstrCode::I32_CONST)
-      return 0;
-    if (code == InstrCode::LOCAL_GET)
-      return 1;
-    if (code == InstrCode::GLOBAL_GET)
-      return 2;
-    throw Todo(__PRETTY_FUNCTION__);
+
+/// value on the operand stack of a block
+struct StackValue {
+  NodeIndex m_node;
+  int32_t m_before; // ready time without balancing
+};
+
+struct ReadyTime {
+  int32_t m_before = 0;
+  int32_t m_after = 0;
+};
+
+/// simulate the operand stack of a block with unit latency. constants, local.get, global.get and block inputs are
+/// ready at 0, every other instruction one step after its last operand; local.tee forwards its operand.
+/// values consumed by anything but a reassociable operator (loads, calls, local.set, ...) end an expression tree,
+/// which is balanced at that point and becomes an opaque leaf of the following trees.
+/// leaves may be reordered freely, the result is the potential of balancing rather than a valid transformation.
+/// one instance is reused for many blocks to keep the capacity of its buffers.
+class BlockBalancer {
+  Module const &m_module;
+  TreeArena m_arena{};
+  std::vector<StackValue> m_stack{};
+  BlockCriticalPath *m_result = nullptr;
+
+public:
+  explicit BlockBalancer(Module const &module) : m_module(module) {}
+
+  void run(BasicBlock const &block, BlockCriticalPath &result) {
+    m_result = &result;
+    m_arena.clear();
+    m_stack.clear();
+    for (Instr const *instr : block.m_instr) {
+      step(*instr);
+    }
+    consume(m_stack.size());
+  }
+
+private:
+  StackValue pop() {
+    if (m_stack.empty()) {
+      return StackValue{.m_node = m_arena.create_leaf(nullptr, 0), .m_before = 0};
+    }
+    StackValue const value = m_stack.back();
+    m_stack.pop_back();
+    return value;
   }
-  int32_t get_rank(size_t index) const { return m_tree.get_value(index).m_rank; }
-  bool operator()(size_t a, size_t b) const {
-    bool const is_rank_a_larger_then_b = get_rank(a) > get_rank(b);
-    bool const is_swap_a_b = is_rank_a_larger_then_b;
-    return is_swap_a_b;
+  void push_leaf(Instr const &instr, ReadyTime ready) {
+    m_stack.push_back(StackValue{.m_node = m_arena.create_leaf(&instr, ready.m_after), .m_before = ready.m_before});
+  }
+  void record(ReadyTime ready) {
+    m_result->m_before = std::max(m_result->m_before, static_cast<size_t>(ready.m_before));
+    m_result->m_after = std::max(m_result->m_after, static_cast<size_t>(ready.m_after));
+  }
+
+  /// balance the tree of `value` and return its ready time after balancing
+  int32_t finalize(StackValue const &value) {
+    TreeNode const &node = m_arena.at(value.m_node);
+    if (node.is_balanced()) {
+      return node.m_rank;
+    }
+    m_result->m_tree_num++;
+    return m_arena.balance(value.m_node);
+  }
+
+  ReadyTime consume(size_t operand_num) {
+    ReadyTime ready{};
+    for (size_t i = 0; i < operand_num; i++) {
+      StackValue const value = pop();
+      ready.m_before = std::max(ready.m_before, value.m_before);
+      ready.m_after = std::max(ready.m_after, finalize(value));
+    }
+    record(ready);
+    return ready;
+  }
+
+  /// `instr` consumes `operand_num` values and produces `result_num` opaque values one step later
+  void compute(Instr const &instr, size_t operand_num, size_t result_num) {
+    ReadyTime ready = consume(operand_num);
+    ready.m_before++;
+    ready.m_after++;
+    record(ready);
+    for (size_t i = 0; i < result_num; i++) {
+      push_leaf(instr, ready);
+    }
+  }
+
+  void call(Instr const &instr, FunctionType const &type, size_t extra_operand_num) {
+    compute(instr, type.get_arguments().size() + extra_operand_num, type.get_results().size());
+  }
+
+  void step(Instr const &instr) {
+    InstrCode const code = instr.get_code();
+    switch (code) {
+    case InstrCode::NOP:
+    case InstrCode::BLOCK:
+    case InstrCode::LOOP:
+    case InstrCode::ELSE:
+    case InstrCode::END:
+      break;
+    case InstrCode::UNREACHABLE:
+    case InstrCode::RETURN:
+    case InstrCode::BR:
+      consume(m_stack.size());
+      break;
+    case InstrCode::IF:
+    case InstrCode::BR_IF:
+    case InstrCode::BR_TABLE:
+      compute(instr, 1U, 0U);
+      break;
+    case InstrCode::I32_CONST:
+    case InstrCode::I64_CONST:
+    case InstrCode::F32_CONST:
+    case InstrCode::F64_CONST:
+    case InstrCode::LOCAL_GET:
+    case InstrCode::GLOBAL_GET:
+      push_leaf(instr, ReadyTime{});
+      break;
+    case InstrCode::LOCAL_TEE: {
+      StackValue const value = pop();
+      push_leaf(instr, ReadyTime{.m_before = value.m_before, .m_after = finalize(value)});
+      break;
+    }
+    case InstrCode::CALL:
+      call(instr, *m_module.m_functions.at(instr.get_index())->get_type(), 0U);
+      break;
+    case InstrCode::CALL_INDIRECT:
+      call(instr, *instr.get_function_type(), 1U);
+      break;
+    default:
+      if (is_reassociable(code)) {
+        StackValue const r = pop();
+        StackValue const l = pop();
+        StackValue const value{.m_node = m_arena.create_operator(&instr, l.m_node, r.m_node),
+                               .m_before = 1 + std::max(l.m_before, r.m_before)};
+        m_result->m_before = std::max(m_result->m_before, static_cast<size_t>(value.m_before));
+        m_stack.push_back(value);
+      } else {
+        compute(instr, instr.get_operand_count(), instr.get_result_count());
+      }
+      break;
+    }
   }
 };
-using RankQueue = std::priority_queue<NodeIndex, std::vector<NodeIndex>, RankPriorityComparison>;
+
 } // namespace
 
-static bool is_root(BinaryTree<TreeInfo> const &tree, size_t index) {
-  TreeNode<TreeInfo> const &node = tree.at(index);
-  // FIXME operator should be commutative and associative
-  return node.has_children() && tree.get_value(node.m_parent).m_instr->get_code() != node.m_value.m_instr->get_code();
-}
-static auto mark_root(BinaryTree<TreeInfo> const &tree) -> RootsQueue {
-  RootsQueue roots{};
-  roots.push(tree.get_root());
-  for (size_t i : Range{1, tree.get_nodes().size()}) {
-    if (is_root(tree, i))
-      roots.push(i);
+static void balance_function(BlockBalancer &balancer, Cfg const &cfg, std::vector<BlockCriticalPath> &results) {
+  for (auto const &[block_index, block] : cfg.m_blocks) {
+    BlockCriticalPath result{.m_function_index = cfg.m_function_index,
+                             .m_block_index = block_index,
+                             .m_before = 0U,
+                             .m_after = 0U,
+                             .m_tree_num = 0U};
+    balancer.run(block, result);
+    results.push_back(result);
   }
-  return roots;
 }
-static auto balance(size_t root_index, BinaryTree<TreeInfo> &tree) -> void;
-static auto flatten(size_t node_index, RankQueue &rank_queue, BinaryTree<TreeInfo> &tree) -> std::set<size_t> {
-  std::set<size_t> available_op_slot{};
-  TreeNode<TreeInfo> &node = tree.at(node_index);
-  if (!node.has_children()) {
-    node.m_value.m_rank = RankPriorityComparison::get_value_rank(node_index, tree);
-    rank_queue.push(node_index);
-    // return node.m_value.m_rank;
-  } else if (is_root(tree, node_index)) {
-    balance(node_index, tree);
-    rank_queue.push(node_index);
-    // return node.m_value.m_rank;
-  } else {
-    assert(node.m_l != tree_node_invalid_value);
-    assert(node.m_r != tree_node_invalid_value);
-    available_op_slot.insert(node_index);
-    available_op_slot.insert_range(flatten(node.m_l, rank_queue, tree));
-    available_op_slot.insert_range(flatten(node.m_r, rank_queue, tree));
+
+void TreeHeightBalancing::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  m_blocks.clear();
+  BlockBalancer balancer{module};
+  for (Cfg const &cfg : cfg_builder->get_cfgs()) {
+    balance_function(balancer, cfg, m_blocks);
   }
-  return available_op_slot;
 }
-static auto rebuild(size_t root_index, std::set<size_t> available_op_slot, RankQueue &rank_queue,
-                    BinaryTree<TreeInfo> &tree) {
-  while (true) {
-    size_t l = rank_queue.top();
-    rank_queue.pop();
-    size_t r = rank_queue.top();
-    rank_queue.pop();
-    if (Debug::is_debug_mode()) {
-      std::cout << "combine " << *tree.get_value(l).m_instr << " " << *tree.get_value(r).m_instr << "\n";
-    }
-    if (rank_queue.empty()) {
-      tree.link(root_index, l, BinaryTree<TreeInfo>::Direction::L);
-      tree.link(root_index, r, BinaryTree<TreeInfo>::Direction::R);
-      tree.get_value(root_index).m_rank = tree.get_value(l).m_rank + tree.get_value(r).m_rank;
-      return;
+
+void TreeHeightBalancing::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  // blocks are grouped by function in cfg order, the groups of the changed functions are replaced
+  std::vector<BlockCriticalPath> blocks{};
+  blocks.reserve(m_blocks.size());
+  BlockBalancer balancer{module};
+  auto group_begin = m_blocks.cbegin();
+  for (Cfg const &cfg : cfg_builder->get_cfgs()) {
+    auto const group_end = std::find_if(group_begin, m_blocks.cend(), [&cfg](BlockCriticalPath const &block) {
+      return block.m_function_index != cfg.m_function_index;
+    });
+    if (function_indexes.contains(cfg.m_function_index)) {
+      balance_function(balancer, cfg, blocks);
     } else {
-      assert(!available_op_slot.empty());
-      size_t operator_node_index = *available_op_slot.begin();
-      available_op_slot.erase(operator_node_index);
-      tree.link(operator_node_index, l, BinaryTree<TreeInfo>::Direction::L);
-      tree.link(operator_node_index, r, BinaryTree<TreeInfo>::Direction::R);
-      tree.get_value(operator_node_index).m_rank = tree.get_value(l).m_rank + tree.get_value(r).m_rank;
-      rank_queue.push(operator_node_index);
+      blocks.insert(blocks.end(), group_begin, group_end);
     }
+    group_begin = group_end;
   }
-}
-static auto balance(size_t root_index, BinaryTree<TreeInfo> &tree) -> void {
-  TreeNode<TreeInfo> &root_node = tree.at(root_index);
-  if (root_node.m_value.m_rank >= 0)
-    return;
-  RankQueue rank_queue{RankPriorityComparison{.m_tree = tree}};
-  std::set<size_t> available_op_slot{};
-  available_op_slot.insert_range(flatten(root_node.m_l, rank_queue, tree));
-  available_op_slot.insert_range(flatten(root_node.m_r, rank_queue, tree));
-  rebuild(root_index, available_op_slot, rank_queue, tree);
+  m_blocks = std::move(blocks);
 }
 
-void TreeHeightBalancing::analyze_impl(Module &module) {
-  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
-  cfg_builder->analyze(module);
-  for (BasicBlock const &block : cfg_builder->get_all_blocks()) {
-    std::vector<BinaryTree<TreeInfo>> trees = convert(block);
-    for (BinaryTree<TreeInfo> &tree : trees) {
-      RootsQueue roots = mark_root(tree);
-      while (!roots.empty()) {
-        balance(roots.top(), tree);
-        roots.pop();
-      }
-      if (Debug::is_debug_mode()) {
-        std::cout << "========================== AFTER TREE HEIGHT BALANCING =============================\n";
-        dump_tree(tree);
-        std::cout << "========================== =========================== =============================\n";
-      }
+void TreeHeightBalancing::dump_result() const {
+  size_t before = 0U;
+  size_t after = 0U;
+  size_t reduced_num = 0U;
+  for (BlockCriticalPath const &block : m_blocks) {
+    before += block.m_before;
+    after += block.m_after;
+    if (block.m_after < block.m_before) {
+      reduced_num++;
+      std::cout << "function[" << block.m_function_index << "] BB[" << block.m_block_index
+                << "] critical_path=" << block.m_before << " -> " << block.m_after << " trees=" << block.m_tree_num
+                << "\n";
     }
   }
+  std::cout << "reduced " << reduced_num << " of " << m_blocks.size() << " blocks, sum of critical paths " << before
+            << " -> " << after << "\n";
 }
 
 std::shared_ptr<IAnalyzer> createTreeHeightBalancingAnalyzer(std::shared_ptr<AnalyzerContext> context) {
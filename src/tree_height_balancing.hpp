@@ -1,15 +1,35 @@
 #pragma once
 
 #include "analyzer.hpp"
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
 
 namespace wa {
 
+/// longest dependence chain of a block in instructions, before and after balancing its expression trees
+struct BlockCriticalPath {
+  size_t m_function_index;
+  size_t m_block_index;
+  size_t m_before;
+  size_t m_after;
+  size_t m_tree_num; // balanced expression trees
+};
+
 class TreeHeightBalancing : public IAnalyzer {
+  std::vector<BlockCriticalPath> m_blocks{};
+
 public:
   explicit TreeHeightBalancing(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
 
+  std::vector<BlockCriticalPath> const &get_results() const { return m_blocks; }
+
+  void dump_result() const;
+
 private:
-  virtual void analyze_impl(Module &module);
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
 };
 
 } // namespace wa
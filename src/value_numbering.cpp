@@ -0,0 +1,384 @@
+#include "value_numbering.hpp"
+#include "adt/scoped_hash_map.hpp"
+#include "analyzer.hpp"
+#include "basic_block_builder.hpp"
+#include "cfg.hpp"
+#include "extend_basic_block_builder.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+using ValueNumber = uint32_t;
+
+struct ValueKey {
+  InstrCode m_code;
+  uint64_t m_immediate;
+  uint32_t m_epoch; // memory or global state the value was read from
+  std::array<ValueNumber, 3U> m_operands;
+
+  bool operator==(ValueKey const &o) const = default;
+};
+
+struct ValueKeyHash {
+  size_t operator()(ValueKey const &key) const {
+    uint64_t h = static_cast<uint64_t>(key.m_code) * 0x9E3779B97F4A7C15ULL;
+    auto const mix = [&h](uint64_t v) {
+      h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6U) + (h >> 2U);
+    };
+    mix(key.m_immediate);
+    mix(key.m_epoch);
+    for (ValueNumber operand : key.m_operands)
+      mix(operand);
+    return static_cast<size_t>(h);
+  }
+};
+
+struct StackValue {
+  ValueNumber m_vn;
+  size_t m_size = 0U;              // instructions in this block which compute the value
+  size_t m_inner_saving = 0U;      // savings already counted for redundant sub expressions
+  size_t m_inner_redundant_num = 0U;
+};
+
+static uint64_t get_immediate(Instr const &instr) {
+  InstrCode const code = instr.get_code();
+  switch (code) {
+  case InstrCode::I32_CONST:
+    return std::bit_cast<uint32_t>(instr.get_value<int32_t>());
+  case InstrCode::I64_CONST:
+    return std::bit_cast<uint64_t>(instr.get_value<int64_t>());
+  case InstrCode::F32_CONST:
+    return std::bit_cast<uint32_t>(instr.get_value<float>());
+  case InstrCode::F64_CONST:
+    return std::bit_cast<uint64_t>(instr.get_value<double>());
+  case InstrCode::GLOBAL_GET:
+    return instr.get_index();
+  default:
+    break;
+  }
+  if (is_load(code)) {
+    MemArg const &mem_arg = instr.get_mem_arg();
+    return (static_cast<uint64_t>(mem_arg.m_offset) << 32U) | mem_arg.m_align;
+  }
+  return 0U;
+}
+
+class ValueNumberingImpl {
+  Module const &m_module;
+  ValueNumber m_next_vn = 0U;
+  uint32_t m_next_epoch = 0U;
+  ScopedHashMap<ValueKey, ValueNumber, ValueKeyHash> m_values{};
+  ScopedHashMap<uint32_t, ValueNumber> m_locals{};
+  uint32_t m_memory_epoch = 0U;
+  uint32_t m_global_epoch = 0U;
+  std::vector<StackValue> m_stack{};
+  RedundancyStat m_stat{};
+
+public:
+  explicit ValueNumberingImpl(Module const &module) : m_module(module) {}
+
+  RedundancyStat run_local(Cfg const &cfg) {
+    m_stat = {};
+    for (auto const &[_, block] : cfg.m_blocks) {
+      reset();
+      number_block(block);
+    }
+    return m_stat;
+  }
+
+  RedundancyStat run_superlocal(Cfg const &cfg, ExtendCfg const &extend_cfg) {
+    m_stat = {};
+    for (ExtendBasicBlock const &extend_block : extend_cfg.m_extend_blocks) {
+      reset();
+      number_tree(cfg, extend_block);
+    }
+    return m_stat;
+  }
+
+private:
+  void reset() {
+    m_values.clear();
+    m_locals.clear();
+    m_stack.clear();
+    m_memory_epoch = m_next_epoch++;
+    m_global_epoch = m_next_epoch++;
+  }
+
+  /// depth first walk of the extended basic block tree, each tree edge opens a new scope
+  void number_tree(Cfg const &cfg, ExtendBasicBlock const &extend_block) {
+    struct Frame {
+      BasicBlock const *m_block;
+      std::vector<size_t> m_children{};
+      size_t m_next_child = 0U;
+      std::vector<StackValue> m_stack{};
+      uint32_t m_memory_epoch;
+      uint32_t m_global_epoch;
+    };
+    std::vector<Frame> frames{};
+    auto const enter = [&](size_t block_index) {
+      m_values.push_scope();
+      m_locals.push_scope();
+      BasicBlock const &block = cfg.m_blocks.at(block_index);
+      number_block(block);
+      Frame frame{.m_block = &block, .m_memory_epoch = m_memory_epoch, .m_global_epoch = m_global_epoch};
+      for (size_t back : block.m_backs) {
+        if (back != extend_block.m_first && extend_block.m_blocks.contains(back)) {
+          frame.m_children.push_back(back);
+        }
+      }
+      // values flowing into the children are computed once in this block, children cannot remove them
+      frame.m_stack = m_stack;
+      for (StackValue &value : frame.m_stack) {
+        value = StackValue{.m_vn = value.m_vn};
+      }
+      frames.push_back(std::move(frame));
+    };
+    enter(extend_block.m_first);
+    while (!frames.empty()) {
+      Frame &frame = frames.back();
+      if (frame.m_next_child == frame.m_children.size()) {
+        m_values.pop_scope();
+        m_locals.pop_scope();
+        frames.pop_back();
+        continue;
+      }
+      size_t const child = frame.m_children[frame.m_next_child++];
+      if (frame.m_block->is_fall_through(child)) {
+        m_stack = frame.m_stack;
+      } else {
+        m_stack.clear();
+      }
+      m_memory_epoch = frame.m_memory_epoch;
+      m_global_epoch = frame.m_global_epoch;
+      enter(child);
+    }
+  }
+
+  ValueNumber create_value() { return m_next_vn++; }
+
+  StackValue pop() {
+    if (m_stack.empty()) {
+      // produced before this block
+      return StackValue{.m_vn = create_value()};
+    }
+    StackValue value = m_stack.back();
+    m_stack.pop_back();
+    return value;
+  }
+
+  ValueNumber get_local(uint32_t local_index) {
+    if (ValueNumber const *vn = m_locals.find(local_index)) {
+      return *vn;
+    }
+    // value at the entry of the tree, visible for every block in it
+    ValueNumber const vn = create_value();
+    m_locals.insert_outermost(local_index, vn);
+    return vn;
+  }
+
+  void push_leaf(ValueKey const &key) {
+    ValueNumber vn;
+    if (ValueNumber const *found = m_values.find(key)) {
+      vn = *found;
+    } else {
+      vn = create_value();
+      m_values.insert_or_assign(key, vn);
+    }
+    m_stack.push_back(StackValue{.m_vn = vn, .m_size = 1U});
+  }
+
+  void push_computation(Instr const &instr, size_t operand_num, uint32_t epoch) {
+    ValueKey key{.m_code = instr.get_code(), .m_immediate = get_immediate(instr), .m_epoch = epoch, .m_operands = {}};
+    StackValue value{.m_vn = 0U, .m_size = 1U};
+    for (size_t i = operand_num; i > 0; i--) {
+      StackValue const operand = pop();
+      key.m_operands[i - 1U] = operand.m_vn;
+      value.m_size += operand.m_size;
+      value.m_inner_saving += operand.m_inner_saving;
+      value.m_inner_redundant_num += operand.m_inner_redundant_num;
+    }
+    if (ValueNumber const *found = m_values.find(key)) {
+      // only the maximal redundant expression is counted, savings of its sub expressions are replaced
+      size_t const saving = value.m_size - 1U;
+      m_stat.m_saved_instr_num += saving - value.m_inner_saving;
+      m_stat.m_redundant_num += 1U - value.m_inner_redundant_num;
+      value.m_vn = *found;
+      value.m_inner_saving = saving;
+      value.m_inner_redundant_num = 1U;
+    } else {
+      value.m_vn = create_value();
+      m_values.insert_or_assign(key, value.m_vn);
+    }
+    m_stack.push_back(value);
+  }
+
+  void push_opaque(size_t result_num) {
+    for (size_t i = 0; i < result_num; i++) {
+      m_stack.push_back(StackValue{.m_vn = create_value()});
+    }
+  }
+
+  void call(FunctionType const &type) {
+    for (size_t i = 0; i < type.get_arguments().size(); i++) {
+      pop();
+    }
+    m_memory_epoch = m_next_epoch++;
+    m_global_epoch = m_next_epoch++;
+    push_opaque(type.get_results().size());
+  }
+
+  void number_block(BasicBlock const &block) {
+    for (Instr const *instr : block.m_instr) {
+      InstrCode const code = instr->get_code();
+      switch (code) {
+      case InstrCode::NOP:
+      case InstrCode::BLOCK:
+      case InstrCode::LOOP:
+      case InstrCode::ELSE:
+      case InstrCode::END:
+        break;
+      case InstrCode::UNREACHABLE:
+      case InstrCode::RETURN:
+      case InstrCode::BR:
+        m_stack.clear();
+        break;
+      case InstrCode::IF:
+      case InstrCode::BR_IF:
+      case InstrCode::BR_TABLE:
+      case InstrCode::DROP:
+        pop();
+        break;
+      case InstrCode::I32_CONST:
+      case InstrCode::I64_CONST:
+      case InstrCode::F32_CONST:
+      case InstrCode::F64_CONST:
+        push_leaf(ValueKey{.m_code = code, .m_immediate = get_immediate(*instr), .m_epoch = 0U, .m_operands = {}});
+        break;
+      case InstrCode::LOCAL_GET:
+        m_stack.push_back(StackValue{.m_vn = get_local(instr->get_index()), .m_size = 1U});
+        break;
+      case InstrCode::LOCAL_SET:
+        m_locals.insert_or_assign(instr->get_index(), pop().m_vn);
+        break;
+      case InstrCode::LOCAL_TEE: {
+        // the tee and its operands stay when an enclosing expression is reused, so the value is a leaf like a
+        // local.get of the teed local. savings inside the operands are already counted.
+        ValueNumber const vn = pop().m_vn;
+        m_locals.insert_or_assign(instr->get_index(), vn);
+        m_stack.push_back(StackValue{.m_vn = vn, .m_size = 1U});
+        break;
+      }
+      case InstrCode::GLOBAL_GET:
+        push_leaf(ValueKey{
+            .m_code = code, .m_immediate = get_immediate(*instr), .m_epoch = m_global_epoch, .m_operands = {}});
+        break;
+      case InstrCode::GLOBAL_SET:
+        m_values.insert_or_assign(ValueKey{.m_code = InstrCode::GLOBAL_GET,
+                                           .m_immediate = instr->get_index(),
+                                           .m_epoch = m_global_epoch,
+                                           .m_operands = {}},
+                                  pop().m_vn);
+        break;
+      case InstrCode::MEMORY_SIZE:
+        push_leaf(ValueKey{.m_code = code, .m_immediate = 0U, .m_epoch = m_memory_epoch, .m_operands = {}});
+        break;
+      case InstrCode::MEMORY_GROW:
+        pop();
+        m_memory_epoch = m_next_epoch++;
+        push_opaque(1U);
+        break;
+      case InstrCode::CALL:
+        call(*m_module.m_functions.at(instr->get_index())->get_type());
+        break;
+      case InstrCode::CALL_INDIRECT:
+        pop();
+        call(*instr->get_function_type());
+        break;
+      default:
+        if (is_store(code)) {
+          pop();
+          pop();
+          m_memory_epoch = m_next_epoch++;
+        } else if (is_load(code)) {
+          push_computation(*instr, 1U, m_memory_epoch);
+        } else {
+          push_computation(*instr, instr->get_operand_count(), 0U);
+        }
+        break;
+      }
+    }
+  }
+};
+
+} // namespace
+
+static FunctionValueNumbering analyze_function(Module const &module, Cfg const &cfg, ExtendCfg const &extend_cfg) {
+  FunctionValueNumbering result{.m_function_index = cfg.m_function_index,
+                                .m_instr_num = module.m_functions[cfg.m_function_index]->get_instr().size()};
+  result.m_local = ValueNumberingImpl{module}.run_local(cfg);
+  result.m_superlocal = ValueNumberingImpl{module}.run_superlocal(cfg, extend_cfg);
+  return result;
+}
+
+void ValueNumbering::analyze_impl(Module &module) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto extend_cfg_builder = get_context()->m_analysis_manager->get_analyzer<ExtendBasicBlockBuilder>();
+  extend_cfg_builder->analyze(module);
+
+  std::vector<Cfg> const &cfgs = cfg_builder->get_cfgs();
+  std::vector<ExtendCfg> const &extend_cfgs = extend_cfg_builder->get_extend_cfgs();
+  m_functions.clear();
+  m_functions.resize(cfgs.size());
+  ThreadPool::for_each(cfgs.size(), [&](size_t cfg_index) {
+    m_functions[cfg_index] = analyze_function(module, cfgs[cfg_index], extend_cfgs.at(cfg_index));
+  });
+}
+
+void ValueNumbering::update_impl(Module &module, std::set<size_t> const &function_indexes) {
+  auto cfg_builder = get_context()->m_analysis_manager->get_analyzer<BasicBlockBuilder>();
+  cfg_builder->analyze(module);
+  auto extend_cfg_builder = get_context()->m_analysis_manager->get_analyzer<ExtendBasicBlockBuilder>();
+  extend_cfg_builder->analyze(module);
+
+  std::vector<ExtendCfg> const &extend_cfgs = extend_cfg_builder->get_extend_cfgs();
+  cfg_builder->for_each_cfg(function_indexes, [&](size_t cfg_index, Cfg const &cfg) {
+    m_functions[cfg_index] = analyze_function(module, cfg, extend_cfgs.at(cfg_index));
+  });
+}
+
+void ValueNumbering::dump_result() const {
+  FunctionValueNumbering total{.m_function_index = 0U, .m_instr_num = 0U};
+  for (FunctionValueNumbering const &result : m_functions) {
+    std::cout << "function[" << result.m_function_index << "] instr=" << result.m_instr_num
+              << " local: redundant=" << result.m_local.m_redundant_num
+              << " saved=" << result.m_local.m_saved_instr_num
+              << " superlocal: redundant=" << result.m_superlocal.m_redundant_num
+              << " saved=" << result.m_superlocal.m_saved_instr_num << "\n";
+    total.m_instr_num += result.m_instr_num;
+    total.m_local += result.m_local;
+    total.m_superlocal += result.m_superlocal;
+  }
+  std::cout << "total instr=" << total.m_instr_num << " local: redundant=" << total.m_local.m_redundant_num
+            << " saved=" << total.m_local.m_saved_instr_num
+            << " superlocal: redundant=" << total.m_superlocal.m_redundant_num
+            << " saved=" << total.m_superlocal.m_saved_instr_num << "\n";
+}
+
+std::shared_ptr<IAnalyzer> createValueNumberingAnalyzer(std::shared_ptr<AnalyzerContext> context) {
+  return std::shared_ptr<ValueNumbering>(new ValueNumbering(context));
+}
+
+} // namespace wa
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "analyzer.hpp"
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace wa {
+
+struct RedundancyStat {
+  size_t m_redundant_num = 0U;    // maximal redundant expressions
+  size_t m_saved_instr_num = 0U;  // instructions removed if each of them is replaced by one local.get
+
+  RedundancyStat &operator+=(RedundancyStat const &o) {
+    m_redundant_num += o.m_redundant_num;
+    m_saved_instr_num += o.m_saved_instr_num;
+    return *this;
+  }
+};
+
+struct FunctionValueNumbering {
+  size_t m_function_index;
+  size_t m_instr_num;
+  RedundancyStat m_local{};      // hash based value numbering inside each basic block
+  RedundancyStat m_superlocal{}; // value numbering along the trees of extended basic blocks
+};
+
+class ValueNumbering : public IAnalyzer {
+  std::vector<FunctionValueNumbering> m_functions{};
+
+public:
+  explicit ValueNumbering(std::shared_ptr<AnalyzerContext> const &context) : IAnalyzer(context) {}
+
+  std::vector<FunctionValueNumbering> const &get_results() const { return m_functions; }
+
+  void dump_result() const;
+
+private:
+  void analyze_impl(Module &module) override;
+  void update_impl(Module &module, std::set<size_t> const &function_indexes) override;
+};
+
+} // namespace wa
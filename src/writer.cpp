@@ -0,0 +1,371 @@
+#include "writer.hpp"
+#include "instruction.hpp"
+#include "module.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wa {
+
+namespace {
+
+constexpr std::array<uint8_t, 8U> header{0x00, 0x61, 0x73, 0x6D, 0x01, 0x00, 0x00, 0x00};
+
+enum SectionId : uint8_t {
+  TypeSection = 1,
+  ImportSection = 2,
+  FunctionSection = 3,
+  CodeSection = 10,
+};
+
+size_t get_uleb_size(uint64_t value) {
+  size_t size = 1U;
+  while (value >= 0x80U) {
+    value >>= 7U;
+    size++;
+  }
+  return size;
+}
+
+/// counts the bytes of an encoding without writing it
+class SizeCounter {
+  size_t m_size = 0U;
+
+public:
+  void put(uint8_t) { m_size++; }
+  void put(std::span<const uint8_t> bytes) { m_size += bytes.size(); }
+  size_t get_size() const { return m_size; }
+};
+
+/// collects the output and writes it to the stream in large chunks
+class BufferedWriter {
+  std::ostream &m_os;
+  std::vector<char> m_buffer = std::vector<char>(1U << 16U);
+  size_t m_used = 0U;
+
+public:
+  explicit BufferedWriter(std::ostream &os) : m_os(os) {}
+  BufferedWriter(BufferedWriter const &) = delete;
+  BufferedWriter &operator=(BufferedWriter const &) = delete;
+  ~BufferedWriter() { flush(); }
+
+  void put(uint8_t byte) {
+    if (m_used == m_buffer.size()) {
+      flush();
+    }
+    m_buffer[m_used++] = static_cast<char>(byte);
+  }
+  void put(std::span<const uint8_t> bytes) {
+    if (bytes.size() > m_buffer.size() - m_used) {
+      flush();
+    }
+    if (bytes.size() >= m_buffer.size()) {
+      m_os.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+      return;
+    }
+    std::ranges::copy(bytes, m_buffer.begin() + static_cast<std::ptrdiff_t>(m_used));
+    m_used += bytes.size();
+  }
+  void flush() {
+    m_os.write(m_buffer.data(), static_cast<std::streamsize>(m_used));
+    m_used = 0U;
+  }
+};
+
+template <class Sink> class Encoder {
+  Sink &m_sink;
+  std::unordered_map<FunctionType const *, uint32_t> const &m_type_indexes;
+
+public:
+  Encoder(Sink &sink, std::unordered_map<FunctionType const *, uint32_t> const &type_indexes)
+      : m_sink(sink), m_type_indexes(type_indexes) {}
+
+  void byte(uint8_t value) { m_sink.put(value); }
+  void bytes(std::span<const uint8_t> value) { m_sink.put(value); }
+
+  void uleb(uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7FU;
+      value >>= 7U;
+      if (value != 0U) {
+        byte |= 0x80U;
+      }
+      m_sink.put(byte);
+    } while (value != 0U);
+  }
+
+  void sleb(int64_t value) {
+    while (true) {
+      uint8_t const byte = static_cast<uint8_t>(value) & 0x7FU;
+      value >>= 6;
+      // the sign bit of the byte carries the rest of the value
+      if (value == 0 || value == -1) {
+        m_sink.put(byte);
+        return;
+      }
+      value >>= 1;
+      m_sink.put(byte | 0x80U);
+    }
+  }
+
+  void name(std::string const &value) {
+    uleb(value.size());
+    bytes(std::span{reinterpret_cast<uint8_t const *>(value.data()), value.size()});
+  }
+
+  uint32_t get_type_index(FunctionType const *type) const {
+    auto it = m_type_indexes.find(type);
+    if (it == m_type_indexes.end()) {
+      throw std::runtime_error("function type is not in the type section");
+    }
+    return it->second;
+  }
+
+  void type_section(Module const &module) {
+    uleb(module.m_function_types.size());
+    for (std::shared_ptr<FunctionType> const &type : module.m_function_types) {
+      byte(0x60);
+      uleb(type->get_arguments().size());
+      for (WasmType t : type->get_arguments()) {
+        byte(static_cast<uint8_t>(t));
+      }
+      uleb(type->get_results().size());
+      for (WasmType t : type->get_results()) {
+        byte(static_cast<uint8_t>(t));
+      }
+    }
+  }
+
+  void import_section(Module const &module) {
+    auto is_import = [](std::shared_ptr<Function> const &fn) { return fn->is_import(); };
+    auto imported_function = std::ranges::find_if(module.m_functions, is_import);
+    uleb(module.m_imports.size());
+    for (Import const &import : module.m_imports) {
+      name(import.m_module);
+      name(import.m_name);
+      byte(import.m_kind);
+      if (import.m_kind != 0) {
+        bytes(import.m_desc);
+        continue;
+      }
+      if (imported_function == module.m_functions.end()) {
+        throw std::runtime_error("function import without imported function");
+      }
+      uleb(get_type_index((*imported_function)->get_type()));
+      imported_function = std::find_if(std::next(imported_function), module.m_functions.end(), is_import);
+    }
+  }
+
+  void function_section(std::vector<Function *> const &functions) {
+    uleb(functions.size());
+    for (Function const *fn : functions) {
+      uleb(get_type_index(fn->get_type()));
+    }
+  }
+
+  void code_section(std::vector<Function *> const &functions, std::vector<size_t> const &body_sizes) {
+    uleb(functions.size());
+    for (size_t i = 0; i < functions.size(); i++) {
+      uleb(body_sizes[i]);
+      body(*functions[i]);
+    }
+  }
+
+  void body(Function &fn) {
+    // unchanged bodies keep their original encoding, e.g. split local entries and padded LEB128 immediates
+    if (!fn.get_encoded_body().empty()) {
+      bytes(fn.get_encoded_body());
+      return;
+    }
+    std::vector<WasmType> const &locals = fn.get_locals();
+    // consecutive locals of the same type are one entry
+    auto is_entry_start = [&locals](size_t i) { return i == 0U || locals[i] != locals[i - 1U]; };
+    size_t entry_num = 0U;
+    for (size_t i = 0; i < locals.size(); i++) {
+      entry_num += is_entry_start(i) ? 1U : 0U;
+    }
+    uleb(entry_num);
+    for (size_t start = 0U; start < locals.size();) {
+      size_t end = start + 1U;
+      while (end < locals.size() && !is_entry_start(end)) {
+        end++;
+      }
+      uleb(end - start);
+      byte(static_cast<uint8_t>(locals[start]));
+      start = end;
+    }
+    for (Instr const &instr : fn.get_instr()) {
+      encode_instr(instr);
+    }
+  }
+
+  void instr(Instr const &instr) { encode_instr(instr); }
+
+private:
+  void block_type(FunctionType const *type) {
+    auto it = m_type_indexes.find(type);
+    if (it != m_type_indexes.end()) {
+      sleb(it->second);
+    } else if (!type->get_arguments().empty() || type->get_results().size() > 1U) {
+      throw std::runtime_error("block type is not in the type section");
+    } else if (type->get_results().empty()) {
+      byte(0x40);
+    } else {
+      byte(static_cast<uint8_t>(type->get_results().front()));
+    }
+  }
+
+  void encode_instr(Instr const &instr) {
+    InstrCode const code = instr.get_code();
+    uint16_t const value = static_cast<uint16_t>(code);
+    if ((value >> 8U) == SATURATING_TRUNCATION_PREFIX) {
+      byte(SATURATING_TRUNCATION_PREFIX);
+      uleb(value & 0xFFU);
+    } else {
+      byte(static_cast<uint8_t>(value));
+    }
+    switch (code) {
+    case InstrCode::BLOCK:
+    case InstrCode::LOOP:
+    case InstrCode::IF:
+      block_type(instr.get_function_type().get());
+      break;
+    case InstrCode::BR:
+    case InstrCode::BR_IF:
+    case InstrCode::CALL:
+    case InstrCode::LOCAL_GET:
+    case InstrCode::LOCAL_SET:
+    case InstrCode::LOCAL_TEE:
+    case InstrCode::GLOBAL_GET:
+    case InstrCode::GLOBAL_SET:
+      uleb(instr.get_index());
+      break;
+    case InstrCode::BR_TABLE: {
+      // the last index is the default target
+      std::vector<Index> const &targets = instr.get_indexes();
+      uleb(targets.size() - 1U);
+      for (Index const &target : targets) {
+        uleb(target.m_v);
+      }
+      break;
+    }
+    case InstrCode::CALL_INDIRECT:
+      uleb(get_type_index(instr.get_function_type().get()));
+      byte(0x00); // table index
+      break;
+    case InstrCode::MEMORY_SIZE:
+    case InstrCode::MEMORY_GROW:
+      byte(0x00);
+      break;
+    case InstrCode::I32_CONST:
+      sleb(instr.get_value<int32_t>());
+      break;
+    case InstrCode::I64_CONST:
+      sleb(instr.get_value<int64_t>());
+      break;
+    case InstrCode::F32_CONST:
+      bytes(std::bit_cast<std::array<uint8_t, 4U>>(instr.get_value<float>()));
+      break;
+    case InstrCode::F64_CONST:
+      bytes(std::bit_cast<std::array<uint8_t, 8U>>(instr.get_value<double>()));
+      break;
+    default:
+      if (is_load(code) || is_store(code)) {
+        uleb(instr.get_mem_arg().m_align);
+        uleb(instr.get_mem_arg().m_offset);
+      }
+      break;
+    }
+  }
+};
+
+} // namespace
+
+Writer::Writer(Module const &module) : m_module(module) {
+  for (size_t i = 0; i < module.m_function_types.size(); i++) {
+    m_type_indexes.emplace(module.m_function_types[i].get(), static_cast<uint32_t>(i));
+  }
+}
+
+void Writer::write(std::ostream &os) const {
+  std::vector<Function *> functions{};
+  for (std::shared_ptr<Function> const &fn : m_module.m_functions) {
+    if (!fn->is_import()) {
+      functions.push_back(fn.get());
+    }
+  }
+
+  BufferedWriter writer{os};
+  Encoder<BufferedWriter> encoder{writer, m_type_indexes};
+  auto write_section = [&](uint8_t id, auto &&encode_content) {
+    SizeCounter counter{};
+    Encoder<SizeCounter> size_encoder{counter, m_type_indexes};
+    encode_content(size_encoder);
+    encoder.byte(id);
+    encoder.uleb(counter.get_size());
+    encode_content(encoder);
+  };
+
+  encoder.bytes(header);
+  for (Section const &section : m_module.m_sections) {
+    switch (section.m_id) {
+    case TypeSection:
+      write_section(section.m_id, [&](auto &e) { e.type_section(m_module); });
+      break;
+    case ImportSection:
+      write_section(section.m_id, [&](auto &e) { e.import_section(m_module); });
+      break;
+    case FunctionSection:
+      write_section(section.m_id, [&](auto &e) { e.function_section(functions); });
+      break;
+    case CodeSection: {
+      // the bodies are the bulk of the module, count each once and derive the section size from them
+      std::vector<size_t> body_sizes{};
+      size_t section_size = get_uleb_size(functions.size());
+      for (Function *fn : functions) {
+        SizeCounter counter{};
+        Encoder<SizeCounter>{counter, m_type_indexes}.body(*fn);
+        body_sizes.push_back(counter.get_size());
+        section_size += get_uleb_size(counter.get_size()) + counter.get_size();
+      }
+      encoder.byte(section.m_id);
+      encoder.uleb(section_size);
+      encoder.code_section(functions, body_sizes);
+      break;
+    }
+    default:
+      encoder.byte(section.m_id);
+      encoder.uleb(section.m_content.size());
+      encoder.bytes(section.m_content);
+      break;
+    }
+  }
+}
+
+size_t Writer::get_instr_size(Instr const &instr) const {
+  SizeCounter counter{};
+  Encoder<SizeCounter>{counter, m_type_indexes}.instr(instr);
+  return counter.get_size();
+}
+
+std::optional<size_t> Writer::find_difference(std::span<const uint8_t> original, std::span<const uint8_t> encoded) {
+  auto const [original_it, encoded_it] = std::ranges::mismatch(original, encoded);
+  if (original_it == original.end() && encoded_it == encoded.end()) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(original_it - original.begin());
+}
+
+} // namespace wa
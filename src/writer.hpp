@@ -0,0 +1,33 @@
+#pragma once
+
+#include "instruction.hpp"
+#include "module.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <unordered_map>
+
+namespace wa {
+
+/// encodes a module into the wasm binary format.
+/// type, import, function and code sections are encoded from the module, the other sections are copied as parsed.
+/// function bodies no transform replaced are copied as parsed as well, so an unmodified module is reproduced exactly.
+/// sizes are counted before a section is written, so the output is streamed without temporary copies.
+class Writer {
+  Module const &m_module;
+  std::unordered_map<FunctionType const *, uint32_t> m_type_indexes{};
+
+public:
+  explicit Writer(Module const &module);
+
+  void write(std::ostream &os) const;
+  /// encoded size of `instr` in bytes
+  size_t get_instr_size(Instr const &instr) const;
+
+  /// offset of the first byte where `encoded` differs from `original`
+  static std::optional<size_t> find_difference(std::span<const uint8_t> original, std::span<const uint8_t> encoded);
+};
+
+} // namespace wa